@@ -42,6 +42,7 @@
 #include <linux/of_platform.h>
 #include <linux/of_device.h>
 #include <linux/gpio.h>
+#include <linux/ktime.h>
 
 #include "ams_tcs3430.h"
 #include "tcs3430_regs.h"
@@ -159,7 +160,7 @@ static int tcs3430_i2c_read(struct tcs3430_chip *chip, u8 reg, u8 *val)
 	addr = reg_addr[reg];
 	ret = i2c_smbus_write_byte(client, addr);
 	if (ret < 0) {
-		mdelay(3);
+		usleep_range(3000, 3500);
 		ret = i2c_smbus_write_byte(client, addr);
 		if (ret < 0) {
 			dev_err(&client->dev,
@@ -171,7 +172,7 @@ static int tcs3430_i2c_read(struct tcs3430_chip *chip, u8 reg, u8 *val)
 
 	read = i2c_smbus_read_byte(client);
 	if (read < 0) {
-		mdelay(3);
+		usleep_range(3000, 3500);
 		read = i2c_smbus_read_byte(client);
 		if (read < 0) {
 			dev_err(&client->dev,
@@ -194,7 +195,7 @@ static int tcs3430_i2c_write(struct tcs3430_chip *chip, u8 reg, u8 val)
 	addr = reg_addr[reg];
 	ret = i2c_smbus_write_byte_data(client, addr, val);
 	if (ret < 0) {
-		mdelay(3);
+		usleep_range(3000, 3500);
 		ret = i2c_smbus_write_byte_data(client, addr, val);
 		if (ret < 0) {
 			dev_err(&client->dev,
@@ -328,7 +329,7 @@ static int tcs3430_pltf_power_on(struct tcs3430_chip *chip)
 	if (chip->pdata->platform_power) {
 	//	rc = chip->pdata->platform_power(&chip->client->dev,
 	//		POWER_ON);
-		mdelay(10);
+		usleep_range(10000, 11000);
 	}
 	chip->unpowered = rc != 0;
 	return rc;
@@ -353,7 +354,7 @@ static int tcs3430_irq_clr(struct tcs3430_chip *chip, u8 int2clr)
 	/*printk("%s %d %x", __func__, __LINE__, int2clr);*/
 	ret = tcs3430_i2c_write(chip, TCS3430_REG_STATUS, int2clr);
 	if (ret < 0) {
-		mdelay(3);
+		usleep_range(3000, 3500);
 	    ret2 = tcs3430_i2c_write(chip, TCS3430_REG_STATUS, int2clr);
 		if (ret2 < 0) {
 			dev_err(&chip->client->dev,
@@ -500,10 +501,11 @@ bypass:
 	return ret ? IRQ_HANDLED : IRQ_NONE;
 }
 
-static void tcs3430_set_defaults(struct tcs3430_chip *chip)
+static int tcs3430_set_defaults(struct tcs3430_chip *chip)
 {
 	struct device *dev = &chip->client->dev;
 	u8 gain_mask;
+	int rc;
 
 	if (chip->pdata) {
 		dev_info(dev, "%s: Loading platform data\n", __func__);
@@ -534,10 +536,12 @@ static void tcs3430_set_defaults(struct tcs3430_chip *chip)
 		chip->shadow[TCS3430_REG_CFG1]  = AGAIN_MASK_16;
 	}
 
-	tcs3430_flush_regs(chip);
+	rc = tcs3430_flush_regs(chip);
 
 /* ENABLE INTERRUPTS */
 	tcs3430_i2c_write(chip, TCS3430_REG_INTENAB, 0x10);  /* set AIEN */
+
+	return rc;
 }
 
 static int tcs3430_als_enable(struct tcs3430_chip *chip, int on)
@@ -553,7 +557,7 @@ static int tcs3430_als_enable(struct tcs3430_chip *chip, int on)
 		rc = tcs3430_update_enable_reg(chip);
 		if (rc)
 			return rc;
-		mdelay(3);
+		usleep_range(3000, 3500);
 	} else {
 		chip->shadow[TCS3430_REG_ENABLE] &=
 			~(TCS3430_EN_AEN);
@@ -991,6 +995,7 @@ static int tcs3430_probe(struct i2c_client *client,
 	u8 id, rev;
 	bool powered = false;
 	unsigned long default_irq_trigger = 0;
+	ktime_t start = ktime_get();
 
 	struct device *dev = &client->dev;
 	static struct tcs3430_chip *chip;
@@ -1054,8 +1059,7 @@ static int tcs3430_probe(struct i2c_client *client,
 		goto id_failed;
 	}
 	mutex_init(&chip->lock);
-	tcs3430_set_defaults(chip);
-	ret = tcs3430_flush_regs(chip);
+	ret = tcs3430_set_defaults(chip);
 	if (ret)
 		goto flush_regs_failed;
 
@@ -1133,7 +1137,8 @@ static int tcs3430_probe(struct i2c_client *client,
 	tcs3430_update_enable_reg(chip);
 	chip->amux_state = TCS3430_X_ONLY;
 	chip->amux = 0x00;
-	dev_info(dev, "Probe ok.\n");
+	dev_info(dev, "Probe ok in %lldus.\n",
+		ktime_us_delta(ktime_get(), start));
 
 	printk("%s Probe ok.\n", __func__);
 
@@ -1263,6 +1268,7 @@ static struct i2c_driver tcs3430_driver = {
 	.driver = {
 		.name = "tcs3430",
 		.pm = &tcs3430_pm_ops,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.id_table = tcs3430_idtable,
 	.probe = tcs3430_probe,
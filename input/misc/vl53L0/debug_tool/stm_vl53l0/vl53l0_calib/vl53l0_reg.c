@@ -20,27 +20,78 @@ struct stmvl53l0_register {
 	uint32_t reg_data;
 	int32_t status;
 };
+
+#define STMVL53L0_REG_BULK_MAX	64
+
+struct stmvl53l0_register_bulk {
+	uint32_t is_read; //1: read 0: write
+	uint32_t page;
+	uint32_t reg_index;
+	uint32_t reg_count;
+	uint32_t scatter;
+	uint8_t reg_list[STMVL53L0_REG_BULK_MAX];
+	uint8_t reg_data[STMVL53L0_REG_BULK_MAX];
+	int32_t status;
+};
 //******************************** IOCTL definitions
 #define VL53L0_IOCTL_REGISTER		_IOWR('p', 0x0c, struct stmvl53l0_register)
+#define VL53L0_IOCTL_REGISTER_BULK	_IOWR('p', 0x11, struct stmvl53l0_register_bulk)
 
 static void help(void)
 {
 	fprintf(stderr,
 		"Usage: vl53l0_reg REG_ADDR REG_BYTES [REG_DATA]\n"
+		"       vl53l0_reg -d [PAGE]\n"
 		" REG_ADDR is VL6180's register address using 0xxx format: \n"
 		" REG_BYTES is the register bytes(1, 2 or 4) \n"
 		" REG_DATA is optional for writting data to requested REG_ADDR\n"
+		" -d dumps the 256 registers of PAGE (default 0)\n"
 		);
 	exit(1);
 }
 
+static int dump_page(int fd, uint32_t page)
+{
+	struct stmvl53l0_register_bulk bulk;
+	uint8_t regs[256];
+	uint32_t index, i;
+
+	// one ioctl, so one page switch, per STMVL53L0_REG_BULK_MAX registers
+	for (index = 0; index < sizeof(regs); index += STMVL53L0_REG_BULK_MAX) {
+		memset(&bulk, 0, sizeof(bulk));
+		bulk.is_read = 1;
+		bulk.page = page;
+		bulk.reg_index = index;
+		bulk.reg_count = STMVL53L0_REG_BULK_MAX;
+		if (ioctl(fd, VL53L0_IOCTL_REGISTER_BULK, &bulk) < 0 ||
+			bulk.status) {
+			fprintf(stderr, "Error reading page %u at 0x%02x: %s, "
+				"status:%d\n", page, index, strerror(errno),
+				bulk.status);
+			return -1;
+		}
+		memcpy(&regs[index], bulk.reg_data, STMVL53L0_REG_BULK_MAX);
+	}
+
+	printf("page %u\n", page);
+	for (i = 0; i < sizeof(regs); i++) {
+		if (i % 16 == 0)
+			printf("%02x:", i);
+		printf(" %02x", regs[i]);
+		if (i % 16 == 15)
+			printf("\n");
+	}
+
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 	int fd;
 	struct stmvl53l0_register reg;
 	char *end;
 
-	if (argc < 3) {
+	if (argc < 3 && (argc < 2 || strcmp(argv[1], "-d"))) {
 		help();
 		exit(1);
 	}
@@ -51,6 +102,17 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
+	if (!strcmp(argv[1], "-d")) {
+		uint32_t page = 0;
+
+		if (argc > 2) {
+			page = strtoul(argv[2], &end, 0);
+			if (*end || page > 0xff)
+				help();
+		}
+		return dump_page(fd, page) ? 1 : 0;
+	}
+
 	reg.reg_index = strtoul(argv[1], &end, 16);
 	if (*end) {
 		help();
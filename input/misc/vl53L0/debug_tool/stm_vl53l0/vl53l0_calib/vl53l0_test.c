@@ -27,6 +27,8 @@
 #define VL53L0_IOCTL_SETOFFSET		_IOW('p', 0x07, int8_t)
 #define VL53L0_IOCTL_GETDATAS		_IOR('p', 0x0b, VL53L0_RangingMeasurementData_t)
 #define VL53L0_IOCTL_PARAMETER		_IOWR('p', 0x0d, struct stmvl53l0_parameter)
+#define VL53L0_IOCTL_PARAMETER_VEC	_IOWR('p', 0x12, struct stmvl53l0_parameter_vec)
+#define VL53L0_IOCTL_GETDATAS_BATCH	_IOWR('p', 0x13, struct stmvl53l0_getdatas_batch)
 
 #define VL53L0_IOCTL_ACTIVATE_USE_CASE  		_IOW('p', 0x08, uint8_t)
 #define VL53L0_IOCTL_ACTIVATE_CUSTOM_USE_CASE			_IOW('p', 0x09, struct stmvl53l0_custom_use_case)
@@ -92,6 +94,32 @@ struct stmvl53l0_parameter {
 	int32_t status;
 };
 
+#define STMVL53L0_PARAMETER_VEC_MAX	16
+
+struct stmvl53l0_parameter_vec {
+	uint32_t count;
+	struct stmvl53l0_parameter param[STMVL53L0_PARAMETER_VEC_MAX];
+	int32_t status;
+};
+
+#define STMVL53L0_SAMPLE_RING_SLOTS	64
+
+struct stmvl53l0_sample {
+	uint32_t seq;
+	uint32_t tv_sec;
+	uint32_t tv_usec;
+	VL53L0_RangingMeasurementData_t rangeData;
+};
+
+struct stmvl53l0_getdatas_batch {
+	uint32_t sinceSeq;
+	uint32_t minCount;
+	uint32_t timeoutMs;
+	uint32_t count; // in: samples wanted, out: samples returned
+	uint32_t lost;
+	struct stmvl53l0_sample sample[STMVL53L0_SAMPLE_RING_SLOTS];
+};
+
 struct stmvl53l0_custom_use_case {
 	FixPoint1616_t 	signalRateLimit;
 	FixPoint1616_t 	sigmaLimit;
@@ -136,6 +164,9 @@ int main(int argc, char *argv[])
 	unsigned long data;
 	VL53L0_RangingMeasurementData_t range_datas;
 	struct stmvl53l0_parameter parameter;
+	struct stmvl53l0_parameter_vec parameterVec;
+	struct stmvl53l0_getdatas_batch batch;
+	uint32_t since_seq = 0, lost = 0;
 	int flags = 0;
 	int mode = MODE_RANGE;
 	unsigned int targetDistance=0;
@@ -353,78 +384,29 @@ int main(int argc, char *argv[])
 			gpio_functionnality_threshold = VL53L0_GPIOFUNCTIONALITY_NEW_MEASURE_READY;
 		}
 
-		if (configure_int_thresholds) {
-
-			parameter.is_read = 0;
-	
-
-			parameter.name = DEVICEMODE_PAR;
-			parameter.value = VL53L0_DEVICEMODE_CONTINUOUS_TIMED_RANGING;
-			//parameter.value = VL53L0_DEVICEMODE_CONTINUOUS_RANGING;
-			if (ioctl(fd, VL53L0_IOCTL_PARAMETER, &parameter) < 0) {
-				fprintf(stderr, "Error: Could not perform VL53L0_IOCTL_PARAMETER(CONTINOUS_TIMED_RANGING) : %s\n", 
-															strerror(errno));
-				close(fd);
-				return -1;
-			}
-	
-			parameter.name = GPIOFUNC_PAR;
-			parameter.value = gpio_functionnality_threshold;
-			if (ioctl(fd, VL53L0_IOCTL_PARAMETER, &parameter) < 0) {
-				fprintf(stderr, "Error: Could not perform VL53L0_IOCTL_PARAMETER : %s, low_threshold = %u\n", 
-															strerror(errno),
-															low_threshold);
-				close(fd);
-				return -1;
-			}
-		
-			if (configure_int_thresholds != 3)
-			{
-				parameter.name = LOWTHRESH_PAR;
-				parameter.value = low_threshold;
-				if (ioctl(fd, VL53L0_IOCTL_PARAMETER, &parameter) < 0) {
-					fprintf(stderr, "Error: Could not perform VL53L0_IOCTL_PARAMETER : %s, low_threshold = %u\n", 
-																strerror(errno),
-																low_threshold);
-					close(fd);
-					return -1;
-				}
-			}
-			
-			if (configure_int_thresholds != 2)
-			{
-				parameter.name = HIGHTHRESH_PAR;
-				parameter.value = high_threshold;
-				if (ioctl(fd, VL53L0_IOCTL_PARAMETER, &parameter) < 0) {
-					fprintf(stderr, "Error: Could not perform VL53L0_IOCTL_PARAMETER : %s, high_threshold = %u\n", 
-																strerror(errno),
-																high_threshold);
-					close(fd);
-					return -1;
-				}
-			}
-	
+		// device mode, interrupt and thresholds in one go
+		memset(&parameterVec, 0, sizeof(parameterVec));
+		parameterVec.param[parameterVec.count].name = DEVICEMODE_PAR;
+		parameterVec.param[parameterVec.count++].value = configure_int_thresholds ?
+			VL53L0_DEVICEMODE_CONTINUOUS_TIMED_RANGING :
+			VL53L0_DEVICEMODE_CONTINUOUS_RANGING;
+		parameterVec.param[parameterVec.count].name = GPIOFUNC_PAR;
+		parameterVec.param[parameterVec.count++].value = gpio_functionnality_threshold;
+		if (configure_int_thresholds && configure_int_thresholds != 3) {
+			parameterVec.param[parameterVec.count].name = LOWTHRESH_PAR;
+			parameterVec.param[parameterVec.count++].value = low_threshold;
 		}
-		else {
-			parameter.name = DEVICEMODE_PAR;
-			parameter.value = VL53L0_DEVICEMODE_CONTINUOUS_RANGING;
-
-			if (ioctl(fd, VL53L0_IOCTL_PARAMETER, &parameter) < 0) {
-				fprintf(stderr, "Error: Could not perform VL53L0_IOCTL_PARAMETER(CONTINUOUS_RANGING) : %s\n", 
-															strerror(errno));
-				close(fd);
-				return -1;
-			}
-			parameter.name = GPIOFUNC_PAR;
-			parameter.value = gpio_functionnality_threshold;
-			if (ioctl(fd, VL53L0_IOCTL_PARAMETER, &parameter) < 0) {
-				fprintf(stderr, "Error: Could not perform VL53L0_IOCTL_PARAMETER : %s, low_threshold = %u\n", 
-															strerror(errno),
-															low_threshold);
-				close(fd);
-				return -1;
-			}
-		
+		if (configure_int_thresholds && configure_int_thresholds != 2) {
+			parameterVec.param[parameterVec.count].name = HIGHTHRESH_PAR;
+			parameterVec.param[parameterVec.count++].value = high_threshold;
+		}
+		if (ioctl(fd, VL53L0_IOCTL_PARAMETER_VEC, &parameterVec) < 0 ||
+			parameterVec.status) {
+			fprintf(stderr, "Error: Could not perform VL53L0_IOCTL_PARAMETER_VEC : %s, status = %d, "
+				"low_threshold = %u, high_threshold = %u\n", strerror(errno),
+				parameterVec.status, low_threshold, high_threshold);
+			close(fd);
+			return -1;
 		}
 		
 #ifdef ACTIVATE_OFFSET_AND_XTALKCOMP //Define this set calibration values
@@ -465,22 +447,34 @@ int main(int argc, char *argv[])
 			return -1;
 		}
 	}
-	// get data testing
+	// get data testing, every sample once: wait for at least one new
+	// sample and take all of those since the last one seen
 	while (1)
 	{
-		usleep(30 *1000); /*100ms*/
-		// to get all range data
-		ioctl(fd, VL53L0_IOCTL_GETDATAS,&range_datas);
-
-		fprintf(stderr,"  VL53L0 Range Data:%4d, error status:0x%x, signalRate_mcps:%7d, Amb Rate_mcps:%7d\r",
-				range_datas.RangeMilliMeter, range_datas.RangeStatus, range_datas.SignalRateRtnMegaCps, range_datas.AmbientRateRtnMegaCps);
-		loop_count++;
+		batch.sinceSeq = since_seq;
+		batch.minCount = 1;
+		batch.timeoutMs = 1000;
+		batch.count = STMVL53L0_SAMPLE_RING_SLOTS;
+		if (ioctl(fd, VL53L0_IOCTL_GETDATAS_BATCH, &batch) < 0) {
+			if (errno != EINTR)
+				fprintf(stderr, "Error: Could not perform VL53L0_IOCTL_GETDATAS_BATCH : %s\n", strerror(errno));
+			batch.count = 0;
+		}
+		lost += batch.lost;
+		for (i = 0; i < batch.count; i++) {
+			range_datas = batch.sample[i].rangeData;
+			since_seq = batch.sample[i].seq;
+			fprintf(stderr,"  VL53L0 Range Data:%4d, error status:0x%x, signalRate_mcps:%7d, Amb Rate_mcps:%7d, seq:%u\r",
+					range_datas.RangeMilliMeter, range_datas.RangeStatus, range_datas.SignalRateRtnMegaCps, range_datas.AmbientRateRtnMegaCps,
+					since_seq);
+			loop_count++;
+		}
 
 		if(loop_break)
 			break;
 	}
 
-	fprintf(stderr, "\n");
+	fprintf(stderr, "\n%d samples, %u lost\n", loop_count, lost);
 
 	fprintf(stderr, "Stop driver\n");
 
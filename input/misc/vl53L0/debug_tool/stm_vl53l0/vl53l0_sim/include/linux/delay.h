@@ -0,0 +1,15 @@
+/*
+ * Host build of the PAL: delays advance the simulated clock instead of
+ * sleeping, so polling loops cost simulated time only.
+ */
+#ifndef VL53L0_SIM_LINUX_DELAY_H
+#define VL53L0_SIM_LINUX_DELAY_H
+
+void vl53l0_sim_delay_us(unsigned long us);
+
+#define udelay(us)		vl53l0_sim_delay_us(us)
+#define mdelay(ms)		vl53l0_sim_delay_us((ms) * 1000UL)
+#define msleep(ms)		vl53l0_sim_delay_us((ms) * 1000UL)
+#define usleep_range(min, max)	vl53l0_sim_delay_us(min)
+
+#endif
@@ -0,0 +1 @@
+/* Host build of the PAL: nothing needed from <linux/i2c.h> */
@@ -0,0 +1 @@
+/* Host build of the PAL: nothing needed from <linux/module.h> */
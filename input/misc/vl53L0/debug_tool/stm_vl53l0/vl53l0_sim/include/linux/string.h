@@ -0,0 +1,26 @@
+/*
+ * Host build of the PAL: userspace stand-in for <linux/string.h>
+ */
+#ifndef VL53L0_SIM_LINUX_STRING_H
+#define VL53L0_SIM_LINUX_STRING_H
+
+#include <stdio.h>
+#include <string.h>
+
+/* glibc only gained strlcpy in 2.38 */
+static inline size_t vl53l0_sim_strlcpy(char *dst, const char *src,
+					size_t size)
+{
+	size_t len = strlen(src);
+
+	if (size) {
+		size_t n = len >= size ? size - 1 : len;
+
+		memcpy(dst, src, n);
+		dst[n] = '\0';
+	}
+	return len;
+}
+#define strlcpy vl53l0_sim_strlcpy
+
+#endif
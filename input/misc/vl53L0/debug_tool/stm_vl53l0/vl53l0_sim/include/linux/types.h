@@ -0,0 +1,12 @@
+/*
+ * Host build of the PAL: userspace stand-in for <linux/types.h>
+ */
+#ifndef VL53L0_SIM_LINUX_TYPES_H
+#define VL53L0_SIM_LINUX_TYPES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#endif
@@ -0,0 +1 @@
+/* Host build of the PAL: no CCI client, see vl53l0_sim.c */
@@ -0,0 +1 @@
+/* Host build of the PAL: no I2C client, see vl53l0_sim.c */
@@ -0,0 +1,23 @@
+/*
+ * Host build of the PAL: the device handle seen by the PAL, with the
+ * simulated device in place of the I2C/CCI client
+ */
+#ifndef VL53L0_SIM_STMVL53L0_H
+#define VL53L0_SIM_STMVL53L0_H
+
+struct vl53l0_sim;
+
+struct stmvl53l0_data {
+	/* !<embed ST VL53L0 Dev data as "dev_data" */
+	VL53L0_DevData_t Data;
+	/*!< i2c device address user specific field*/
+	uint8_t   I2cDevAddr;
+	/*!< Type of comms : VL53L0_COMMS_I2C or VL53L0_COMMS_SPI */
+	uint8_t   comms_type;
+	/*!< Comms speed [kHz] : typically 400kHz for I2C */
+	uint16_t  comms_speed_khz;
+
+	struct vl53l0_sim *sim;
+};
+
+#endif
@@ -0,0 +1,375 @@
+/*
+ *  vl53l0_bench.c - run the PAL against the simulated VL53L0 and report
+ *		     the bus cost of each API call
+ *
+ *  Copyright (C) 2016 STMicroelectronics Imaging Division
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+/*
+ * Usage: vl53l0_bench [-n samples] [-b budget_us] [-t mm|near:far]
+ *		       [-r reflectance] [-a ambient_kcps] [-s noise_mm]
+ *		       [-k i2c_khz] [-o]
+ *
+ * Follows the driver's bring-up (DataInit, StaticInit, reference
+ * calibration and SPAD management), optionally an offset calibration
+ * (-o, target at 100mm), then times single shot and continuous ranging.
+ * "sim us" is device time, bus transfers plus the PAL's delays; "cpu us"
+ * is the host time spent in the PAL and the model.
+ *
+ * Last, the PAL calls the driver's work handler makes for a continuous
+ * sample are timed called directly, as PAPI() binds them by default,
+ * and through a function pointer table, as with USE_PAL_FUNC_TABLE.
+ */
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vl53l0_api.h"
+#include "vl53l0_sim.h"
+
+struct bench_snap {
+	struct vl53l0_sim_counters cnt;
+	uint64_t now_ns;
+	uint64_t cpu_ns;
+};
+
+static struct vl53l0_sim sim;
+static struct stmvl53l0_data dev;
+
+static uint64_t bench_cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void bench_snap(struct bench_snap *s)
+{
+	s->cnt = sim.cnt;
+	s->now_ns = sim.now_ns;
+	s->cpu_ns = bench_cpu_ns();
+}
+
+static void bench_header(void)
+{
+	printf("%-36s %6s %8s %8s %10s %10s %9s\n", "call", "status",
+		"xfers", "bytes", "bus us", "sim us", "cpu us");
+}
+
+static void bench_report(const char *name, int status,
+	const struct bench_snap *a, unsigned int n)
+{
+	struct bench_snap b;
+
+	bench_snap(&b);
+	if (!n)
+		n = 1;
+	if (strlen(name) > 36) {
+		printf("%s\n", name);
+		name = "";
+	}
+	printf("%-36s %6d %8.1f %8.1f %10.1f %10.1f %9.2f\n", name, status,
+		(double)(b.cnt.xfers - a->cnt.xfers) / n,
+		(double)(b.cnt.bytes - a->cnt.bytes) / n,
+		(double)(b.cnt.bus_ns - a->cnt.bus_ns) / n / 1000,
+		(double)(b.now_ns - a->now_ns) / n / 1000,
+		(double)(b.cpu_ns - a->cpu_ns) / n / 1000);
+}
+
+#define SIM_CALL(call) \
+	do { \
+		struct bench_snap __s; \
+		int __status; \
+		bench_snap(&__s); \
+		__status = call; \
+		bench_report(#call, __status, &__s, 1); \
+		if (__status != VL53L0_ERROR_NONE) \
+			return __status; \
+	} while (0)
+
+struct bench_stats {
+	unsigned int n, valid;
+	int64_t sum, sum_sq;
+	int min, max;
+};
+
+static void bench_stats_add(struct bench_stats *st,
+	const VL53L0_RangingMeasurementData_t *r, uint32_t truth)
+{
+	int err = (int)r->RangeMilliMeter - (int)truth;
+
+	st->n++;
+	if (r->RangeStatus != 0)
+		return;
+	if (!st->valid || err < st->min)
+		st->min = err;
+	if (!st->valid || err > st->max)
+		st->max = err;
+	st->valid++;
+	st->sum += err;
+	st->sum_sq += (int64_t)err * err;
+}
+
+static void bench_stats_print(const char *name, const struct bench_stats *st)
+{
+	double mean = 0, var = 0;
+
+	if (st->valid) {
+		mean = (double)st->sum / st->valid;
+		var = (double)st->sum_sq / st->valid - mean * mean;
+	}
+	printf("%s: %u samples, %u valid, error mean %.2fmm var %.2fmm2 "
+		"min %d max %d\n", name, st->n, st->valid, mean, var,
+		st->min, st->max);
+}
+
+static int bench_single(unsigned int samples)
+{
+	VL53L0_RangingMeasurementData_t r;
+	struct bench_stats st = { 0 };
+	struct bench_snap s;
+	int status = VL53L0_ERROR_NONE;
+	unsigned int i;
+
+	SIM_CALL(VL53L0_SetDeviceMode(&dev,
+		VL53L0_DEVICEMODE_SINGLE_RANGING));
+
+	bench_snap(&s);
+	for (i = 0; i < samples && status == VL53L0_ERROR_NONE; i++) {
+		status = VL53L0_PerformSingleRangingMeasurement(&dev, &r);
+		bench_stats_add(&st, &r, sim.distance_mm);
+	}
+	bench_report("PerformSingleRangingMeasurement/sample", status, &s, i);
+	bench_stats_print("single", &st);
+
+	return status;
+}
+
+static int bench_continuous(unsigned int samples)
+{
+	VL53L0_RangingMeasurementData_t r;
+	struct bench_stats st = { 0 };
+	struct bench_snap s, poll;
+	uint64_t polls = 0;
+	int status = VL53L0_ERROR_NONE;
+	uint8_t ready;
+	unsigned int i;
+
+	SIM_CALL(VL53L0_SetDeviceMode(&dev,
+		VL53L0_DEVICEMODE_CONTINUOUS_RANGING));
+	SIM_CALL(VL53L0_StartMeasurement(&dev));
+
+	bench_snap(&s);
+	for (i = 0; i < samples && status == VL53L0_ERROR_NONE; i++) {
+		/* 1ms polling, as the driver's poll thread does */
+		do {
+			status = VL53L0_GetMeasurementDataReady(&dev, &ready);
+			polls++;
+			if (!ready)
+				vl53l0_sim_delay_us(1000);
+		} while (status == VL53L0_ERROR_NONE && !ready);
+		if (status != VL53L0_ERROR_NONE)
+			break;
+
+		bench_snap(&poll);
+		status = VL53L0_GetRangingMeasurementData(&dev, &r);
+		if (status == VL53L0_ERROR_NONE)
+			status = VL53L0_ClearInterruptMask(&dev, 0);
+		if (i == 0)
+			bench_report("GetRangingMeasurementData+Clear", status,
+				&poll, 1);
+		bench_stats_add(&st, &r, sim.distance_mm);
+	}
+	bench_report("continuous/sample", status, &s, i);
+	printf("continuous: %.2f data ready polls per sample\n",
+		i ? (double)polls / i : 0.0);
+	bench_stats_print("continuous", &st);
+
+	SIM_CALL(VL53L0_StopMeasurement(&dev));
+
+	return status;
+}
+
+/* the per-sample subset of the driver's stmvl53l0_api_fn_t */
+struct bench_api_fn {
+	VL53L0_Error (*GetInterruptMaskStatus)(VL53L0_DEV Dev,
+		uint32_t *pInterruptMaskStatus);
+	VL53L0_Error (*GetRangingMeasurementData)(VL53L0_DEV Dev,
+		VL53L0_RangingMeasurementData_t *pRangingMeasurementData);
+	VL53L0_Error (*GetLimitCheckCurrent)(VL53L0_DEV Dev,
+		uint16_t LimitCheckId, FixPoint1616_t *pLimitCheckCurrent);
+	VL53L0_Error (*ClearInterruptMask)(VL53L0_DEV Dev,
+		uint32_t InterruptMask);
+};
+
+/* not static nor const, so that the calls are not devirtualized */
+struct bench_api_fn bench_api_tbl = {
+	.GetInterruptMaskStatus = VL53L0_GetInterruptMaskStatus,
+	.GetRangingMeasurementData = VL53L0_GetRangingMeasurementData,
+	.GetLimitCheckCurrent = VL53L0_GetLimitCheckCurrent,
+	.ClearInterruptMask = VL53L0_ClearInterruptMask,
+};
+
+/* stmvl53l0_work_handler(), sample read to interrupt clear */
+#define BENCH_WORK_SAMPLE(call) \
+	do { \
+		uint32_t __mask; \
+		FixPoint1616_t __sigma; \
+		VL53L0_RangingMeasurementData_t __r; \
+		call(GetInterruptMaskStatus)(&dev, &__mask); \
+		call(GetRangingMeasurementData)(&dev, &__r); \
+		/* governor, then the input report */ \
+		call(GetLimitCheckCurrent)(&dev, \
+			VL53L0_CHECKENABLE_SIGMA_FINAL_RANGE, &__sigma); \
+		call(GetLimitCheckCurrent)(&dev, \
+			VL53L0_CHECKENABLE_SIGMA_FINAL_RANGE, &__sigma); \
+		call(ClearInterruptMask)(&dev, 0); \
+	} while (0)
+
+#define BENCH_DIRECT(fn)	VL53L0_##fn
+#define BENCH_TABLE(fn)		(bench_api_tbl.fn)
+
+static void bench_dispatch(unsigned int samples)
+{
+	uint64_t direct = 0, table = 0, t;
+	unsigned int pass, i;
+
+	/* best of 5 alternated passes, the model cost is the same for both */
+	for (pass = 0; pass < 5; pass++) {
+		t = bench_cpu_ns();
+		for (i = 0; i < samples; i++)
+			BENCH_WORK_SAMPLE(BENCH_DIRECT);
+		t = bench_cpu_ns() - t;
+		if (pass == 0 || t < direct)
+			direct = t;
+
+		t = bench_cpu_ns();
+		for (i = 0; i < samples; i++)
+			BENCH_WORK_SAMPLE(BENCH_TABLE);
+		t = bench_cpu_ns() - t;
+		if (pass == 0 || t < table)
+			table = t;
+	}
+	printf("work handler PAL calls, cpu ns/sample: direct %.1f, "
+		"table %.1f (%+.1f)\n", (double)direct / samples,
+		(double)table / samples,
+		((double)table - (double)direct) / samples);
+}
+
+static void bench_usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-n samples] [-b budget_us] "
+		"[-t mm|near:far] [-r reflectance] [-a ambient_kcps] "
+		"[-s noise_mm] [-k i2c_khz] [-o]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	struct vl53l0_sim_target target = {
+		.near_mm = 300,
+		.far_mm = 300,
+		.reflectance = 88,
+		.ambient_kcps = 200,
+		.noise_mm = 2,
+	};
+	VL53L0_DeviceInfo_t info;
+	unsigned int samples = 100;
+	uint32_t budget = 0;
+	uint32_t spad_count;
+	uint8_t vhv, phase, aperture;
+	int32_t offset_um;
+	int offset_cal = 0;
+	uint16_t khz = 400;
+	char *end;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:b:t:r:a:s:k:oh")) != -1) {
+		switch (opt) {
+		case 'n':
+			samples = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			budget = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			target.near_mm = strtoul(optarg, &end, 0);
+			target.far_mm = target.near_mm;
+			if (*end == ':')
+				target.far_mm = strtoul(end + 1, NULL, 0);
+			break;
+		case 'r':
+			target.reflectance = strtoul(optarg, NULL, 0);
+			break;
+		case 'a':
+			target.ambient_kcps = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			target.noise_mm = strtoul(optarg, NULL, 0);
+			break;
+		case 'k':
+			khz = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			offset_cal = 1;
+			break;
+		default:
+			bench_usage(argv[0]);
+			return 1;
+		}
+	}
+	if (target.far_mm != target.near_mm)
+		target.ramp_samples = samples;
+
+	vl53l0_sim_init(&sim, &target);
+	dev.sim = &sim;
+	dev.I2cDevAddr = 0x52;
+	dev.comms_type = 1;
+	dev.comms_speed_khz = khz;
+
+	bench_header();
+	SIM_CALL(VL53L0_DataInit(&dev));
+	SIM_CALL(VL53L0_GetDeviceInfo(&dev, &info));
+	SIM_CALL(VL53L0_StaticInit(&dev));
+	SIM_CALL(VL53L0_PerformRefCalibration(&dev, &vhv, &phase));
+	SIM_CALL(VL53L0_PerformRefSpadManagement(&dev, &spad_count,
+		&aperture));
+	if (budget)
+		SIM_CALL(VL53L0_SetMeasurementTimingBudgetMicroSeconds(&dev,
+			budget));
+	SIM_CALL(VL53L0_SetGpioConfig(&dev, 0, 0,
+		VL53L0_GPIOFUNCTIONALITY_NEW_MEASURE_READY,
+		VL53L0_INTERRUPTPOLARITY_LOW));
+	if (offset_cal) {
+		struct vl53l0_sim_target t = sim.target;
+
+		sim.target.near_mm = 100;
+		sim.target.ramp_samples = 0;
+		SIM_CALL(VL53L0_PerformOffsetCalibration(&dev, 100 << 16,
+			&offset_um));
+		sim.target = t;
+		printf("offset calibration: %dum\n", offset_um);
+	}
+	printf("device %s, ref SPADs %u %s, budget %uus\n", info.ProductId,
+		spad_count, aperture ? "aperture" : "non-aperture",
+		vl53l0_sim_budget_us(&sim));
+
+	if (bench_single(samples) != VL53L0_ERROR_NONE)
+		return 1;
+	if (bench_continuous(samples) != VL53L0_ERROR_NONE)
+		return 1;
+	bench_dispatch(samples);
+
+	return 0;
+}
@@ -0,0 +1,318 @@
+/*
+ *  vl53l0_budget.c - I2C transaction budget check of the driver flows,
+ *		      run against the simulated VL53L0
+ *
+ *  Copyright (C) 2016 STMicroelectronics Imaging Division
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+/*
+ * Usage: vl53l0_budget [-f budget_file] [-u] [-c trace_file]
+ *
+ * Replays the PAL call sequences of stmvl53l0_module.c and counts the
+ * I2C transfers and bytes of each flow. The sequences are the copies
+ * in vl53l0_drv.c, not the driver code itself: a driver change is only
+ * seen here once vl53l0_drv.c follows it, and the paths listed in
+ * vl53l0_drv.h are not covered at all. The counts are compared with
+ * the checked-in budget file; the run fails if a flow uses more.
+ * -u rewrites the budget file with the measured figures, for changes
+ * that lower the traffic or knowingly raise it.
+ * -c also writes the transfers to trace_file, in the format of the
+ * driver's i2c_capture debugfs file, as a reference for vl53l0_replay.
+ */
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vl53l0_drv.h"
+#include "vl53l0_sim.h"
+
+#define BUDGET_FLOWS_MAX	24
+
+struct budget_flow {
+	const char *name;
+	uint64_t xfers;
+	uint64_t bytes;
+};
+
+static struct budget_flow flows[BUDGET_FLOWS_MAX];
+static unsigned int nb_flows;
+
+static struct vl53l0_sim sim;
+static struct stmvl53l0_data dev;
+
+void drv_wait_interrupt(void)
+{
+	vl53l0_sim_delay_us(vl53l0_sim_period_us(&sim) + 1000);
+}
+
+static int budget_run(const char *name, VL53L0_Error (*flow)(void))
+{
+	struct vl53l0_sim_counters start = sim.cnt;
+	struct budget_flow *f;
+
+	if (flow() != VL53L0_ERROR_NONE)
+		return -1;
+	if (nb_flows == BUDGET_FLOWS_MAX)
+		return -1;
+	f = &flows[nb_flows++];
+	f->name = name;
+	f->xfers = sim.cnt.xfers - start.xfers;
+	f->bytes = sim.cnt.bytes - start.bytes;
+
+	return 0;
+}
+
+static const struct drv_use_case *cur_use_case;
+
+static VL53L0_Error drv_use_case_switch(void)
+{
+	return drv_config_use_case(cur_use_case);
+}
+
+static VL53L0_Error drv_start_single(void)
+{
+	VL53L0_Error status;
+
+	status = drv_start(VL53L0_DEVICEMODE_SINGLE_RANGING);
+	if (status != VL53L0_ERROR_NONE)
+		return status;
+	return drv_sample();
+}
+
+static VL53L0_Error drv_start_timed(void)
+{
+	return drv_start(VL53L0_DEVICEMODE_CONTINUOUS_TIMED_RANGING);
+}
+
+static VL53L0_Error drv_start_continuous(void)
+{
+	return drv_start(VL53L0_DEVICEMODE_CONTINUOUS_RANGING);
+}
+
+/* a started flow, measured from the start to its second sample */
+static int budget_run_started(const char *start_name,
+	VL53L0_Error (*start)(void), const char *sample_name)
+{
+	if (budget_run(start_name, start))
+		return -1;
+	/* the first sample after a start may still be the single shot one */
+	if (drv_sample() != VL53L0_ERROR_NONE)
+		return -1;
+	if (budget_run(sample_name, drv_sample))
+		return -1;
+	return drv_stop() != VL53L0_ERROR_NONE ? -1 : 0;
+}
+
+static VL53L0_Error drv_offset_calibration_50mm(void)
+{
+	return drv_offset_calibration(50);
+}
+
+static VL53L0_Error drv_xtalk_calibration_100mm(void)
+{
+	return drv_xtalk_calibration(100);
+}
+
+static int budget_flows(void)
+{
+	unsigned int i;
+
+	sim.target.near_mm = 300;
+	if (budget_run("power_up_first_sample", drv_start_single))
+		return -1;
+	if (budget_run("single_sample", drv_sample))
+		return -1;
+	if (budget_run("show_current_configuration", drv_cfg_mirror_read))
+		return -1;
+
+	for (i = 0; i < DRV_USE_CASES; i++) {
+		cur_use_case = &drv_use_cases[i];
+		if (budget_run(cur_use_case->name, drv_use_case_switch))
+			return -1;
+	}
+
+	if (drv_stop() != VL53L0_ERROR_NONE)
+		return -1;
+	if (budget_run_started("continuous_start", drv_start_continuous,
+		"continuous_sample"))
+		return -1;
+	if (budget_run_started("timed_start", drv_start_timed,
+		"timed_sample"))
+		return -1;
+
+	/* stmvl53l0_set_proximity(100, 200, 100) */
+	drv_cfg.proximityFarMm = 200;
+	drv_cfg.lowThreshold = 100 << 16;
+	drv_cfg.highThreshold = 200 << 16;
+	drv_cfg.interMeasurems = 100;
+	if (budget_run_started("proximity_start", drv_start_timed,
+		"proximity_sample"))
+		return -1;
+	drv_cfg.proximityFarMm = 0;
+	drv_cfg.lowThreshold = 60;
+	drv_cfg.highThreshold = 200;
+	drv_cfg.interMeasurems = 30;
+
+	/* a 1 mA cap turns continuous ranging into timed ranging */
+	drv_cfg.capUa = 1000;
+	if (budget_run_started("power_cap_start", drv_start_continuous,
+		"power_cap_sample"))
+		return -1;
+	drv_cfg.capUa = 0;
+
+	if (budget_run("ref_calibration", drv_ref_calibration))
+		return -1;
+	sim.target.near_mm = 50;
+	if (budget_run("offset_calibration",
+		drv_offset_calibration_50mm))
+		return -1;
+	sim.target.near_mm = 100;
+	if (budget_run("xtalk_calibration",
+		drv_xtalk_calibration_100mm))
+		return -1;
+
+	return 0;
+}
+
+static int budget_check(const char *path)
+{
+	char line[128], name[64];
+	unsigned long long xfers, bytes;
+	unsigned int i, checked = 0;
+	int failed = 0;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		perror(path);
+		return 1;
+	}
+
+	printf("%-28s %12s %12s\n", "flow", "xfers", "bytes");
+	while (fgets(line, sizeof(line), fp)) {
+		if (line[0] == '#' || sscanf(line, "%63s %llu %llu", name,
+				&xfers, &bytes) != 3)
+			continue;
+		for (i = 0; i < nb_flows; i++)
+			if (!strcmp(flows[i].name, name))
+				break;
+		if (i == nb_flows) {
+			printf("%-28s not run\n", name);
+			failed = 1;
+			continue;
+		}
+		checked++;
+		printf("%-28s %5llu/%-6llu %5llu/%-6llu %s\n", name,
+			(unsigned long long)flows[i].xfers, xfers,
+			(unsigned long long)flows[i].bytes, bytes,
+			flows[i].xfers > xfers || flows[i].bytes > bytes ?
+				"OVER BUDGET" :
+			flows[i].xfers < xfers || flows[i].bytes < bytes ?
+				"under budget, update with -u" : "ok");
+		if (flows[i].xfers > xfers || flows[i].bytes > bytes)
+			failed = 1;
+	}
+	fclose(fp);
+
+	if (checked != nb_flows) {
+		printf("%u flows have no budget, add them with -u\n",
+			nb_flows - checked);
+		failed = 1;
+	}
+
+	return failed;
+}
+
+static int budget_update(const char *path)
+{
+	unsigned int i;
+	FILE *fp;
+
+	fp = fopen(path, "w");
+	if (!fp) {
+		perror(path);
+		return 1;
+	}
+	fprintf(fp, "# I2C transaction budget of the stmvl53l0 driver flows\n");
+	fprintf(fp, "# generated by vl53l0_budget -u, checked by make check\n");
+	fprintf(fp, "# replays the driver sequences copied in vl53l0_drv.c, "
+		"see vl53l0_drv.h for what they do not cover\n");
+	fprintf(fp, "# flow xfers bytes\n");
+	for (i = 0; i < nb_flows; i++)
+		fprintf(fp, "%s %llu %llu\n", flows[i].name,
+			(unsigned long long)flows[i].xfers,
+			(unsigned long long)flows[i].bytes);
+	fclose(fp);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct vl53l0_sim_target target = {
+		.near_mm = 300,
+		.far_mm = 300,
+		.reflectance = 88,
+		.ambient_kcps = 200,
+		.noise_mm = 2,
+	};
+	const char *path = "vl53l0_budget.txt";
+	const char *trace = NULL;
+	int update = 0;
+	int ret;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "f:uc:h")) != -1) {
+		switch (opt) {
+		case 'f':
+			path = optarg;
+			break;
+		case 'u':
+			update = 1;
+			break;
+		case 'c':
+			trace = optarg;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-f budget_file] [-u] "
+				"[-c trace_file]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	vl53l0_sim_init(&sim, &target);
+	dev.sim = &sim;
+	dev.I2cDevAddr = 0x52;
+	dev.comms_type = 1;
+	dev.comms_speed_khz = 400;
+	drv_dev = &dev;
+	if (trace) {
+		sim.capture = fopen(trace, "w");
+		if (!sim.capture) {
+			perror(trace);
+			return 1;
+		}
+		fprintf(sim.capture, "# stmvl53l0 i2c capture: "
+			"ts_ns dir reg err len data\n");
+	}
+
+	ret = budget_flows();
+	if (sim.capture)
+		fclose(sim.capture);
+	if (ret) {
+		fprintf(stderr, "flow failed\n");
+		return 1;
+	}
+
+	return update ? budget_update(path) : budget_check(path);
+}
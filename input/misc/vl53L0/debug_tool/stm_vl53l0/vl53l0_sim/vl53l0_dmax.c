@@ -0,0 +1,190 @@
+/*
+ *  vl53l0_dmax.c - check VL53L0_calc_dmax() against the original LUT
+ *		    interpolation
+ *
+ *  Copyright (C) 2016 STMicroelectronics Imaging Division
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+/*
+ * Usage: vl53l0_dmax [-t tables] [-m max_mcps]
+ *
+ * The PAL evaluates DMax from LUT segments cached in the device data.
+ * This compares it with the original per-sample linear scan and
+ * division, kept below as the reference:
+ *  - the default table of DataInit, at every ambient rate from 0 to
+ *    max_mcps (20) at full Fix16:16 resolution;
+ *  - random tables (200), a quarter of them non-monotonic, at a coarse
+ *    stride plus the rates next to each break point.
+ * The reference divides by zero on a segment narrower than one Fix16:8
+ * step; such rates are skipped and counted. Any other difference fails
+ * the run.
+ */
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vl53l0_api.h"
+#include "vl53l0_api_core.h"
+#include "vl53l0_sim.h"
+
+#define DMAX_STRIDE	61
+
+static struct vl53l0_sim sim;
+static struct stmvl53l0_data dev;
+
+static unsigned long checked, skipped, failed;
+
+/*
+ * VL53L0_calc_dmax() before the segments were cached. Returns -1 where
+ * it would have divided by zero.
+ */
+static int dmax_reference(const VL53L0_DMaxLUT_t *lut,
+	FixPoint1616_t ambRateMeas, uint32_t *pdmax_mm)
+{
+	int32_t index0 = 0, index1 = 0, index;
+	FixPoint1616_t amb0, amb1, dmax0, dmax1;
+	FixPoint1616_t dmax_mm;
+	FixPoint1616_t linearSlope;
+
+	if (ambRateMeas <= lut->ambRate_mcps[0]) {
+		dmax_mm = lut->dmax_mm[0];
+	} else if (ambRateMeas >= lut->ambRate_mcps[VL53L0_DMAX_LUT_SIZE - 1]) {
+		dmax_mm = lut->dmax_mm[VL53L0_DMAX_LUT_SIZE - 1];
+	} else {
+		/* get_dmax_lut_points() */
+		for (index = 0; index < VL53L0_DMAX_LUT_SIZE; index++) {
+			if (ambRateMeas <= lut->ambRate_mcps[index]) {
+				index1 = index;
+				break;
+			}
+		}
+		if (index == VL53L0_DMAX_LUT_SIZE)
+			index0 = index1 = VL53L0_DMAX_LUT_SIZE - 1;
+		else if (index1 == 0)
+			index0 = 0;
+		else
+			index0 = index1 - 1;
+
+		if (index0 == index1) {
+			dmax_mm = lut->dmax_mm[index0];
+		} else {
+			amb0 = lut->ambRate_mcps[index0];
+			amb1 = lut->ambRate_mcps[index1];
+			dmax0 = lut->dmax_mm[index0];
+			dmax1 = lut->dmax_mm[index1];
+			if ((amb1 - amb0) != 0) {
+				if (((amb1 - amb0) >> 8) == 0)
+					return -1;
+				linearSlope = (dmax0 - dmax1) /
+					((amb1 - amb0) >> 8);
+				dmax_mm = (((amb1 - ambRateMeas) >> 8) *
+					linearSlope) + dmax1;
+			} else {
+				dmax_mm = dmax0;
+			}
+		}
+	}
+	*pdmax_mm = (uint32_t)(dmax_mm >> 16);
+
+	return 0;
+}
+
+static void dmax_check(FixPoint1616_t amb)
+{
+	const VL53L0_DMaxLUT_t *lut = &dev.Data.CurrentParameters.dmax_lut;
+	uint32_t expected, dmax;
+
+	if (dmax_reference(lut, amb, &expected)) {
+		skipped++;
+		return;
+	}
+	checked++;
+	VL53L0_calc_dmax(&dev, amb, &dmax);
+	if (dmax != expected && failed++ < 10)
+		fprintf(stderr, "ambient 0x%08x: dmax %u, expected %u\n",
+			amb, dmax, expected);
+}
+
+static void dmax_random_table(VL53L0_DMaxLUT_t *lut, int monotonic)
+{
+	uint32_t amb = 0, dmax = 1200;
+	int i;
+
+	for (i = 0; i < VL53L0_DMAX_LUT_SIZE; i++) {
+		if (monotonic) {
+			amb += rand() % 0x40000;
+			dmax -= rand() % (dmax / 4 + 1);
+		} else {
+			amb = rand() % 0x140000;
+			dmax = rand() % 2000;
+		}
+		lut->ambRate_mcps[i] = amb;
+		lut->dmax_mm[i] = dmax << 16;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	VL53L0_DMaxLUT_t *lut = &dev.Data.CurrentParameters.dmax_lut;
+	struct vl53l0_sim_target target = { 0 };
+	VL53L0_DEV Dev = &dev;
+	FixPoint1616_t amb, max_amb = 20 << 16;
+	unsigned int tables = 200, t;
+	int opt, i, d;
+
+	while ((opt = getopt(argc, argv, "t:m:h")) != -1) {
+		switch (opt) {
+		case 't':
+			tables = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			max_amb = strtoul(optarg, NULL, 0) << 16;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-t tables] [-m max_mcps]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	vl53l0_sim_init(&sim, &target);
+	dev.sim = &sim;
+	dev.I2cDevAddr = 0x52;
+	dev.comms_type = 1;
+	dev.comms_speed_khz = 400;
+	if (VL53L0_DataInit(Dev) != VL53L0_ERROR_NONE) {
+		fprintf(stderr, "DataInit failed\n");
+		return 1;
+	}
+
+	for (amb = 0; amb <= max_amb; amb++)
+		dmax_check(amb);
+	printf("default table: %lu rates checked, %lu failed\n", checked,
+		failed);
+
+	checked = 0;
+	srand(1);
+	for (t = 0; t < tables; t++) {
+		dmax_random_table(lut, t % 4 != 0);
+		PALDevDataSet(Dev, DmaxLutValid, 0);
+		for (amb = 0; amb <= max_amb; amb += DMAX_STRIDE)
+			dmax_check(amb);
+		for (i = 0; i < VL53L0_DMAX_LUT_SIZE; i++)
+			for (d = -2; d <= 2; d++)
+				dmax_check(lut->ambRate_mcps[i] + d);
+	}
+	printf("%u random tables: %lu rates checked, %lu skipped, "
+		"%lu failed\n", tables, checked, skipped, failed);
+
+	return failed ? 1 : 0;
+}
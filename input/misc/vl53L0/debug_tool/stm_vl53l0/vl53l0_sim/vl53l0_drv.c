@@ -0,0 +1,336 @@
+/*
+ *  vl53l0_drv.c - PAL call sequences of the stmvl53l0 driver, for
+ *		  the host tools
+ *
+ *  Copyright (C) 2016 STMicroelectronics Imaging Division
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+#include <stdio.h>
+
+#include "vl53l0_drv.h"
+
+VL53L0_DEV drv_dev;
+
+#define DRV_USE_CASE(name, id, prefix) \
+	{ name, id, prefix##_TIMING_BUDGET, prefix##_SIGNAL_RATE_LIMIT, \
+		prefix##_SIGMA_LIMIT, prefix##_PRE_RANGE_PULSE_PERIOD, \
+		prefix##_FINAL_RANGE_PULSE_PERIOD }
+
+const struct drv_use_case drv_use_cases[DRV_USE_CASES] = {
+	DRV_USE_CASE("use_case_high_accuracy", USE_CASE_HIGH_ACCURACY,
+		HIGH_ACCURACY),
+	DRV_USE_CASE("use_case_high_speed", USE_CASE_HIGH_SPEED,
+		HIGH_SPEED),
+	DRV_USE_CASE("use_case_ultra_high_speed", USE_CASE_ULTRA_HIGH_SPEED,
+		ULTRA_HIGH_SPEED),
+	DRV_USE_CASE("use_case_long_distance", USE_CASE_LONG_DISTANCE,
+		LONG_DISTANCE),
+	/* stmvl53l0_setup() defaults of the custom use case */
+	DRV_USE_CASE("use_case_custom", USE_CASE_CUSTOM, LONG_DISTANCE),
+};
+
+struct drv_config drv_cfg = {
+	.useCase = USE_CASE_LONG_DISTANCE,
+	.delayMs = 30,
+	.interMeasurems = 30,
+	.lowThreshold = 60,
+	.highThreshold = 200,
+};
+
+const struct drv_use_case *drv_use_case_get(uint8_t useCase)
+{
+	unsigned int i;
+
+	for (i = 0; i < DRV_USE_CASES; i++)
+		if (drv_use_cases[i].useCase == useCase)
+			return &drv_use_cases[i];
+	return NULL;
+}
+
+/* driver state the sequences depend on */
+static uint8_t drv_reset = 1;
+static uint8_t drv_uhs_active;
+static VL53L0_SchedulerSequenceSteps_t drv_uhs_saved_steps;
+static FixPoint1616_t drv_uhs_saved_msrc;
+static VL53L0_DeviceModes drv_device_mode = VL53L0_DEVICEMODE_SINGLE_RANGING;
+static VL53L0_GpioFunctionality drv_gpio_function =
+	VL53L0_GPIOFUNCTIONALITY_NEW_MEASURE_READY;
+static uint8_t drv_cfg_stale;	/* cfgMirror.stale */
+
+#define CHECK(call) \
+	do { \
+		VL53L0_Error __status = call; \
+		if (__status != VL53L0_ERROR_NONE) { \
+			fprintf(stderr, "%s: %s failed, status %d\n", \
+				__func__, #call, __status); \
+			return __status; \
+		} \
+	} while (0)
+
+VL53L0_Error drv_init_client(void)
+{
+	VL53L0_DeviceInfo_t info;
+	uint32_t refSpadCount;
+	uint8_t isApertureSpads, vhv, phase;
+
+	drv_cfg_stale = 1;
+	if (drv_reset) {
+		CHECK(VL53L0_DataInit(drv_dev));
+		drv_uhs_active = 0;
+	}
+	CHECK(VL53L0_GetDeviceInfo(drv_dev, &info));
+	CHECK(VL53L0_StaticInit(drv_dev));
+	if (drv_reset) {
+		CHECK(VL53L0_PerformRefCalibration(drv_dev, &vhv, &phase));
+		CHECK(VL53L0_PerformRefSpadManagement(drv_dev, &refSpadCount,
+			&isApertureSpads));
+		drv_reset = 0;
+	}
+	CHECK(VL53L0_SetDeviceMode(drv_dev, VL53L0_DEVICEMODE_SINGLE_RANGING));
+	CHECK(VL53L0_SetWrapAroundCheckEnable(drv_dev, 1));
+
+	return VL53L0_ERROR_NONE;
+}
+
+/* stmvl53l0_cfg_mirror_read(), on a stale mirror or in verify mode */
+VL53L0_Error drv_cfg_mirror_read(void)
+{
+	FixPoint1616_t value;
+	uint32_t u32;
+	int32_t s32;
+	uint8_t u8, u8b;
+	uint16_t check;
+
+	for (check = 0; check <= VL53L0_CHECKENABLE_RANGE_IGNORE_THRESHOLD;
+		check++) {
+		CHECK(VL53L0_GetLimitCheckValue(drv_dev, check, &value));
+		CHECK(VL53L0_GetLimitCheckEnable(drv_dev, check, &u8));
+	}
+	CHECK(VL53L0_GetRefCalibration(drv_dev, &u8, &u8b));
+	CHECK(VL53L0_GetReferenceSpads(drv_dev, &u32, &u8));
+	CHECK(VL53L0_GetMeasurementTimingBudgetMicroSeconds(drv_dev, &u32));
+	CHECK(VL53L0_GetVcselPulsePeriod(drv_dev, VL53L0_VCSEL_PERIOD_PRE_RANGE,
+		&u8));
+	CHECK(VL53L0_GetVcselPulsePeriod(drv_dev,
+		VL53L0_VCSEL_PERIOD_FINAL_RANGE, &u8));
+	CHECK(VL53L0_GetOffsetCalibrationDataMicroMeter(drv_dev, &s32));
+	CHECK(VL53L0_GetXTalkCompensationEnable(drv_dev, &u8));
+	CHECK(VL53L0_GetXTalkCompensationRateMegaCps(drv_dev, &value));
+
+	return VL53L0_ERROR_NONE;
+}
+
+static VL53L0_Error drv_prune_sequence(void)
+{
+	if (drv_uhs_active)
+		return VL53L0_ERROR_NONE;
+	CHECK(VL53L0_GetSequenceStepEnables(drv_dev, &drv_uhs_saved_steps));
+	CHECK(VL53L0_GetSequenceStepTimeout(drv_dev, VL53L0_SEQUENCESTEP_MSRC,
+		&drv_uhs_saved_msrc));
+	CHECK(VL53L0_SetSequenceStepEnable(drv_dev, VL53L0_SEQUENCESTEP_TCC, 0));
+	CHECK(VL53L0_SetSequenceStepEnable(drv_dev, VL53L0_SEQUENCESTEP_MSRC, 0));
+	CHECK(VL53L0_SetSequenceStepEnable(drv_dev,
+		VL53L0_SEQUENCESTEP_PRE_RANGE, 0));
+	CHECK(VL53L0_SetSequenceStepTimeout(drv_dev, VL53L0_SEQUENCESTEP_MSRC,
+		ULTRA_HIGH_SPEED_MSRC_TIMEOUT));
+	drv_uhs_active = 1;
+
+	return VL53L0_ERROR_NONE;
+}
+
+static VL53L0_Error drv_restore_sequence(void)
+{
+	if (!drv_uhs_active)
+		return VL53L0_ERROR_NONE;
+	CHECK(VL53L0_SetSequenceStepTimeout(drv_dev, VL53L0_SEQUENCESTEP_MSRC,
+		drv_uhs_saved_msrc));
+	CHECK(VL53L0_SetSequenceStepEnable(drv_dev, VL53L0_SEQUENCESTEP_TCC,
+		drv_uhs_saved_steps.TccOn));
+	CHECK(VL53L0_SetSequenceStepEnable(drv_dev, VL53L0_SEQUENCESTEP_MSRC,
+		drv_uhs_saved_steps.MsrcOn));
+	CHECK(VL53L0_SetSequenceStepEnable(drv_dev, VL53L0_SEQUENCESTEP_PRE_RANGE,
+		drv_uhs_saved_steps.PreRangeOn));
+	drv_uhs_active = 0;
+
+	return VL53L0_ERROR_NONE;
+}
+
+/* stmvl53l0_config_use_case() */
+VL53L0_Error drv_config_use_case(const struct drv_use_case *uc)
+{
+	uint32_t budget;
+	uint8_t period;
+
+	CHECK(VL53L0_SetLimitCheckEnable(drv_dev,
+		VL53L0_CHECKENABLE_SIGMA_FINAL_RANGE, 1));
+	CHECK(VL53L0_SetLimitCheckEnable(drv_dev,
+		VL53L0_CHECKENABLE_SIGNAL_RATE_FINAL_RANGE, 1));
+	CHECK(VL53L0_SetLimitCheckValue(drv_dev,
+		VL53L0_CHECKENABLE_SIGNAL_RATE_FINAL_RANGE,
+		uc->signalRateLimit));
+	CHECK(VL53L0_SetLimitCheckValue(drv_dev,
+		VL53L0_CHECKENABLE_SIGMA_FINAL_RANGE, uc->sigmaLimit));
+	if (uc->useCase == USE_CASE_ULTRA_HIGH_SPEED)
+		CHECK(drv_prune_sequence());
+	CHECK(VL53L0_SetMeasurementTimingBudgetMicroSeconds(drv_dev,
+		uc->timingBudget));
+	if (uc->useCase != USE_CASE_ULTRA_HIGH_SPEED)
+		CHECK(drv_restore_sequence());
+	CHECK(VL53L0_SetVcselPulsePeriod(drv_dev, VL53L0_VCSEL_PERIOD_PRE_RANGE,
+		uc->preRangePulsePeriod));
+	CHECK(VL53L0_SetVcselPulsePeriod(drv_dev, VL53L0_VCSEL_PERIOD_FINAL_RANGE,
+		uc->finalRangePulsePeriod));
+	drv_cfg.useCase = uc->useCase;
+
+	if (drv_cfg_stale) {
+		drv_cfg_stale = 0;
+		return drv_cfg_mirror_read();
+	}
+	/* recorded, the budget and periods from the PAL timing mirror */
+	CHECK(VL53L0_GetMeasurementTimingBudgetMicroSeconds(drv_dev, &budget));
+	CHECK(VL53L0_GetVcselPulsePeriod(drv_dev, VL53L0_VCSEL_PERIOD_PRE_RANGE,
+		&period));
+	CHECK(VL53L0_GetVcselPulsePeriod(drv_dev,
+		VL53L0_VCSEL_PERIOD_FINAL_RANGE, &period));
+
+	return VL53L0_ERROR_NONE;
+}
+
+/* stmvl53l0_energy_cap_apply(), the period the power cap imposes */
+static void drv_cap_apply(VL53L0_DeviceModes *mode, uint32_t *interMs)
+{
+	const struct drv_use_case *uc = drv_use_case_get(drv_cfg.useCase);
+	uint64_t periodUs;
+	uint32_t capMs, periodMs;
+
+	if (drv_cfg.capUa == 0)
+		return;
+	periodUs = (uint64_t)uc->timingBudget *
+		(STMVL53L0_RANGING_UA - STMVL53L0_IDLE_UA) /
+		(drv_cfg.capUa - STMVL53L0_IDLE_UA);
+	capMs = (periodUs + 999) / 1000;
+	periodMs = (uc->timingBudget + 999) / 1000;
+	if (*mode == VL53L0_DEVICEMODE_CONTINUOUS_TIMED_RANGING &&
+		*interMs > periodMs)
+		periodMs = *interMs;
+	/* the driver polls, single ranging restarts once per poll */
+	if (*mode == VL53L0_DEVICEMODE_SINGLE_RANGING &&
+		drv_cfg.delayMs > periodMs)
+		periodMs = drv_cfg.delayMs;
+	if (capMs <= periodMs)
+		return;
+	*mode = VL53L0_DEVICEMODE_CONTINUOUS_TIMED_RANGING;
+	*interMs = capMs;
+}
+
+/* stmvl53l0_start(NORMAL_MODE) with drv_cfg */
+VL53L0_Error drv_start(VL53L0_DeviceModes mode)
+{
+	uint32_t interMs = drv_cfg.interMeasurems;
+
+	CHECK(drv_init_client());
+	drv_gpio_function = VL53L0_GPIOFUNCTIONALITY_NEW_MEASURE_READY;
+	if (drv_cfg.proximityFarMm != 0)
+		drv_gpio_function =
+			VL53L0_GPIOFUNCTIONALITY_THRESHOLD_CROSSED_OUT;
+	CHECK(VL53L0_SetGpioConfig(drv_dev, 0, 0, drv_gpio_function,
+		VL53L0_INTERRUPTPOLARITY_LOW));
+	CHECK(VL53L0_SetInterruptThresholds(drv_dev, 0, drv_cfg.lowThreshold,
+		drv_cfg.highThreshold));
+	drv_cap_apply(&mode, &interMs);
+	if (mode == VL53L0_DEVICEMODE_CONTINUOUS_TIMED_RANGING)
+		CHECK(VL53L0_SetInterMeasurementPeriodMilliSeconds(drv_dev,
+			interMs));
+	CHECK(VL53L0_SetDeviceMode(drv_dev, mode));
+	CHECK(VL53L0_ClearInterruptMask(drv_dev, 0));
+	CHECK(drv_config_use_case(drv_use_case_get(drv_cfg.useCase)));
+	CHECK(VL53L0_StartMeasurement(drv_dev));
+	drv_device_mode = mode;
+
+	return VL53L0_ERROR_NONE;
+}
+
+/* stmvl53l0_stop() */
+VL53L0_Error drv_stop(void)
+{
+	uint32_t stop;
+
+	if (drv_device_mode != VL53L0_DEVICEMODE_SINGLE_RANGING)
+		CHECK(VL53L0_StopMeasurement(drv_dev));
+	CHECK(VL53L0_ClearInterruptMask(drv_dev, 0));
+	do {
+		CHECK(VL53L0_GetStopCompletedStatus(drv_dev, &stop));
+	} while (stop);
+
+	return VL53L0_ERROR_NONE;
+}
+
+/* interrupt, then stmvl53l0_work_handler() */
+VL53L0_Error drv_sample(void)
+{
+	VL53L0_RangingMeasurementData_t range;
+	uint32_t status;
+
+	drv_wait_interrupt();
+
+	CHECK(VL53L0_GetInterruptMaskStatus(drv_dev, &status));
+	if (status != drv_gpio_function) {
+		fprintf(stderr, "%s: no sample, interrupt status %u\n",
+			__func__, status);
+		return VL53L0_ERROR_UNDEFINED;
+	}
+	CHECK(VL53L0_GetRangingMeasurementData(drv_dev, &range));
+	CHECK(VL53L0_ClearInterruptMask(drv_dev, 0));
+	if (drv_device_mode == VL53L0_DEVICEMODE_SINGLE_RANGING)
+		CHECK(VL53L0_StartMeasurement(drv_dev));
+
+	return VL53L0_ERROR_NONE;
+}
+
+VL53L0_Error drv_ref_calibration(void)
+{
+	uint32_t refSpadCount;
+	uint8_t isApertureSpads, vhv, phase;
+
+	CHECK(VL53L0_PerformRefCalibration(drv_dev, &vhv, &phase));
+	CHECK(VL53L0_PerformRefSpadManagement(drv_dev, &refSpadCount,
+		&isApertureSpads));
+
+	return VL53L0_ERROR_NONE;
+}
+
+/* stmvl53l0_start(OFFSETCALIB_MODE), after init_client */
+VL53L0_Error drv_offset_calibration(uint32_t distanceMm)
+{
+	int32_t offset;
+
+	CHECK(VL53L0_SetXTalkCompensationEnable(drv_dev, 1));
+	CHECK(VL53L0_PerformOffsetCalibration(drv_dev, distanceMm << 16,
+		&offset));
+	drv_cfg_stale = 1;
+
+	return VL53L0_ERROR_NONE;
+}
+
+/* stmvl53l0_start(XTALKCALIB_MODE), after init_client */
+VL53L0_Error drv_xtalk_calibration(uint32_t distanceMm)
+{
+	FixPoint1616_t xtalk;
+
+	CHECK(VL53L0_SetXTalkCompensationEnable(drv_dev, 1));
+	CHECK(VL53L0_PerformXTalkCalibration(drv_dev, distanceMm << 16,
+		&xtalk));
+	drv_cfg_stale = 1;
+
+	return VL53L0_ERROR_NONE;
+}
+
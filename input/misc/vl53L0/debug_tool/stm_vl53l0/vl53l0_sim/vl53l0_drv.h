@@ -0,0 +1,79 @@
+/*
+ *  vl53l0_drv.h - PAL call sequences of the stmvl53l0 driver, for
+ *		  the host tools
+ *
+ *  Copyright (C) 2016 STMicroelectronics Imaging Division
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+/*
+ * Each drv_*() function issues the PAL calls of the stmvl53l0_module.c
+ * function named in its comment, in the same order, against drv_dev.
+ * Keep them in step with the driver when its call order changes; the
+ * use case values come from the driver's stmvl53l0-config.h.
+ *
+ * Not covered: the register bulk/parameter ioctls, histograms, the
+ * timing budget governor and auto budget (they only change the values
+ * a use case switch writes) and the CCI batching of the writes.
+ */
+#ifndef VL53L0_DRV_H
+#define VL53L0_DRV_H
+
+#include "vl53l0_api.h"
+#include "stmvl53l0-config.h"
+
+#define DRV_USE_CASES			5
+
+struct drv_use_case {
+	const char *name;
+	uint8_t useCase;
+	uint32_t timingBudget;
+	FixPoint1616_t signalRateLimit;
+	FixPoint1616_t sigmaLimit;
+	uint8_t preRangePulsePeriod;
+	uint8_t finalRangePulsePeriod;
+};
+
+extern const struct drv_use_case drv_use_cases[DRV_USE_CASES];
+
+/*
+ * The struct stmvl53l0_data fields stmvl53l0_do_start() depends on,
+ * with the defaults of stmvl53l0_setup()
+ */
+struct drv_config {
+	uint8_t useCase;
+	uint32_t delayMs;		/* poll period */
+	uint32_t interMeasurems;
+	FixPoint1616_t lowThreshold;
+	FixPoint1616_t highThreshold;
+	uint32_t proximityFarMm;	/* 0: no proximity window */
+	uint32_t capUa;			/* power cap, 0: none */
+};
+
+extern struct drv_config drv_cfg;
+
+extern VL53L0_DEV drv_dev;
+
+/* provided by the tool: wait for the data ready interrupt */
+void drv_wait_interrupt(void);
+
+const struct drv_use_case *drv_use_case_get(uint8_t useCase);
+VL53L0_Error drv_init_client(void);
+VL53L0_Error drv_cfg_mirror_read(void);
+VL53L0_Error drv_config_use_case(const struct drv_use_case *uc);
+VL53L0_Error drv_start(VL53L0_DeviceModes mode);
+VL53L0_Error drv_stop(void);
+VL53L0_Error drv_sample(void);
+VL53L0_Error drv_ref_calibration(void);
+VL53L0_Error drv_offset_calibration(uint32_t distanceMm);
+VL53L0_Error drv_xtalk_calibration(uint32_t distanceMm);
+
+#endif /* VL53L0_DRV_H */
@@ -0,0 +1,322 @@
+/*
+ *  vl53l0_replay.c - feed an I2C capture of the stmvl53l0 driver back
+ *		      into the PAL
+ *
+ *  Copyright (C) 2016 STMicroelectronics Imaging Division
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+/*
+ * Usage: vl53l0_replay [-w window] trace_file flow...
+ *
+ * trace_file is the driver's i2c_capture debugfs file, or the -c output
+ * of vl53l0_budget. The flows are run in order through the same PAL
+ * call sequences as vl53l0_budget, with the device replaced by the
+ * trace:
+ *  - a write consumes the next write record of the same register and
+ *    length; a different payload counts as diverged;
+ *  - a read consumes the next read record of the same register and
+ *    length and returns its data and error, so bus errors recorded in
+ *    the field are injected at the same point;
+ *  - records passed over to find a match, at most window ahead (64),
+ *    count as skipped. An unmatched write is accepted, an unmatched
+ *    read fails the transfer, as the trace has no data for it.
+ * Each flow reports the transfers it used and the field time between
+ * its first and last record; a PAL change that adds or drops bus
+ * traffic shows up as skipped or unmatched transfers.
+ *
+ * flows: power_up		start single ranging and take the first sample
+ *	  single[:n]		n single shot samples (1)
+ *	  continuous[:n]	stop, start continuous ranging, n samples (1)
+ *	  stop			stop ranging
+ *	  use_case:n		switch to use case n (USE_CASE_* value)
+ *	  config		read the configuration, as the sysfs show does
+ *	  ref_cal		reference calibration
+ *	  offset_cal[:mm]	offset calibration at mm (50)
+ *	  xtalk_cal[:mm]	crosstalk calibration at mm (100)
+ */
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vl53l0_drv.h"
+
+#define REPLAY_DATA_MAX		64
+
+struct replay_record {
+	uint64_t timestamp;
+	int err;
+	char dir;
+	uint8_t reg;
+	uint8_t len;
+	uint8_t data[REPLAY_DATA_MAX];
+};
+
+struct replay_stats {
+	unsigned int xfers;	/* transfers issued by the PAL */
+	unsigned int matched;	/* records consumed */
+	unsigned int skipped;	/* records passed over */
+	unsigned int diverged;	/* writes matched with another payload */
+	unsigned int unmatched;	/* transfers with no record */
+	unsigned int errors;	/* recorded errors returned to the PAL */
+	uint64_t first_ns;
+	uint64_t last_ns;
+};
+
+static struct replay_record *records;
+static unsigned int nb_records;
+static unsigned int pos;
+static unsigned int window = 64;
+static struct replay_stats stats;
+
+static struct stmvl53l0_data dev;
+
+void drv_wait_interrupt(void)
+{
+}
+
+void vl53l0_sim_delay_us(unsigned long us)
+{
+}
+
+static int replay_hex(const char *s, uint8_t *data, unsigned int len)
+{
+	unsigned int i, v;
+
+	for (i = 0; i < len; i++) {
+		if (sscanf(s + 2 * i, "%2x", &v) != 1)
+			return -1;
+		data[i] = v;
+	}
+	return 0;
+}
+
+static int replay_load(const char *path)
+{
+	struct replay_record *rec;
+	char line[256], hex[2 * REPLAY_DATA_MAX + 1];
+	unsigned long long ts;
+	unsigned int reg, len, size = 0;
+	int err, n;
+	char dir;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		perror(path);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		if (line[0] == '#')
+			continue;
+		hex[0] = '\0';
+		n = sscanf(line, "%llu %c %x %d %u %128s", &ts, &dir, &reg,
+			&err, &len, hex);
+		/* a queued CCI write is recorded again as 'w' once sent */
+		if (n >= 2 && dir == 'q')
+			continue;
+		if (n < 5 || (dir != 'w' && dir != 'r') || reg > 0xff ||
+				len > REPLAY_DATA_MAX || strlen(hex) != 2 * len) {
+			fprintf(stderr, "%s: bad record: %s", path, line);
+			continue;
+		}
+		if (nb_records == size) {
+			size = size ? 2 * size : 1024;
+			rec = realloc(records, size * sizeof(*rec));
+			if (!rec) {
+				fclose(fp);
+				return -1;
+			}
+			records = rec;
+		}
+		rec = &records[nb_records];
+		if (replay_hex(hex, rec->data, len)) {
+			fprintf(stderr, "%s: bad record: %s", path, line);
+			continue;
+		}
+		rec->timestamp = ts;
+		rec->err = err;
+		rec->dir = dir;
+		rec->reg = reg;
+		rec->len = len;
+		nb_records++;
+	}
+	fclose(fp);
+
+	return 0;
+}
+
+static struct replay_record *replay_next(char dir, uint8_t reg, uint8_t len)
+{
+	struct replay_record *rec;
+	unsigned int i;
+
+	stats.xfers++;
+	for (i = pos; i < nb_records && i <= pos + window; i++) {
+		rec = &records[i];
+		if (rec->dir != dir || rec->reg != reg || rec->len != len)
+			continue;
+		stats.skipped += i - pos;
+		stats.matched++;
+		if (stats.matched == 1)
+			stats.first_ns = rec->timestamp;
+		stats.last_ns = rec->timestamp;
+		if (rec->err)
+			stats.errors++;
+		pos = i + 1;
+		return rec;
+	}
+	stats.unmatched++;
+
+	return NULL;
+}
+
+int VL53L0_I2CWrite(VL53L0_DEV dev, uint8_t *buff, uint8_t len)
+{
+	struct replay_record *rec;
+
+	if (!len)
+		return 1;
+	rec = replay_next('w', buff[0], len - 1);
+	if (!rec)
+		return 0;
+	if (memcmp(rec->data, &buff[1], len - 1))
+		stats.diverged++;
+
+	return rec->err;
+}
+
+int VL53L0_I2CRead(VL53L0_DEV dev, uint8_t *buff, uint8_t len)
+{
+	struct replay_record *rec;
+
+	rec = replay_next('r', buff[0], len);
+	if (!rec)
+		return 1;
+	memcpy(buff, rec->data, len);
+
+	return rec->err;
+}
+
+/* nothing is queued on the host bus */
+int VL53L0_I2CFlush(VL53L0_DEV dev)
+{
+	return 0;
+}
+
+static VL53L0_Error replay_samples(unsigned int n)
+{
+	VL53L0_Error status = VL53L0_ERROR_NONE;
+
+	while (n-- && status == VL53L0_ERROR_NONE)
+		status = drv_sample();
+	return status;
+}
+
+static VL53L0_Error replay_flow(const char *flow)
+{
+	const struct drv_use_case *uc;
+	VL53L0_Error status;
+	const char *arg;
+	unsigned int n;
+
+	arg = strchr(flow, ':');
+	n = arg ? strtoul(arg + 1, NULL, 0) : 0;
+
+	if (!strcmp(flow, "power_up")) {
+		status = drv_start(VL53L0_DEVICEMODE_SINGLE_RANGING);
+		if (status == VL53L0_ERROR_NONE)
+			status = drv_sample();
+		return status;
+	}
+	if (!strncmp(flow, "single", 6))
+		return replay_samples(n ? n : 1);
+	if (!strncmp(flow, "continuous", 10)) {
+		status = drv_stop();
+		if (status == VL53L0_ERROR_NONE)
+			status = drv_start(VL53L0_DEVICEMODE_CONTINUOUS_RANGING);
+		if (status == VL53L0_ERROR_NONE)
+			status = replay_samples(n ? n : 1);
+		return status;
+	}
+	if (!strcmp(flow, "stop"))
+		return drv_stop();
+	if (!strncmp(flow, "use_case:", 9)) {
+		uc = drv_use_case_get(n);
+		if (!uc) {
+			fprintf(stderr, "unknown use case %u\n", n);
+			return VL53L0_ERROR_INVALID_PARAMS;
+		}
+		return drv_config_use_case(uc);
+	}
+	if (!strcmp(flow, "config"))
+		return drv_cfg_mirror_read();
+	if (!strcmp(flow, "ref_cal"))
+		return drv_ref_calibration();
+	if (!strncmp(flow, "offset_cal", 10))
+		return drv_offset_calibration(n ? n : 50);
+	if (!strncmp(flow, "xtalk_cal", 9))
+		return drv_xtalk_calibration(n ? n : 100);
+
+	fprintf(stderr, "unknown flow %s\n", flow);
+	return VL53L0_ERROR_INVALID_PARAMS;
+}
+
+int main(int argc, char *argv[])
+{
+	VL53L0_Error status;
+	int failed = 0;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "w:h")) != -1) {
+		switch (opt) {
+		case 'w':
+			window = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind + 2 > argc)
+		goto usage;
+	if (replay_load(argv[optind]))
+		return 1;
+
+	dev.I2cDevAddr = 0x52;
+	dev.comms_type = 1;
+	dev.comms_speed_khz = 400;
+	drv_dev = &dev;
+
+	printf("%u records\n", nb_records);
+	printf("%-20s %6s %6s %7s %7s %8s %9s %6s %10s\n", "flow", "status",
+		"xfers", "matched", "skipped", "diverged", "unmatched",
+		"errors", "field us");
+	for (i = optind + 1; i < argc; i++) {
+		memset(&stats, 0, sizeof(stats));
+		status = replay_flow(argv[i]);
+		printf("%-20s %6d %6u %7u %7u %8u %9u %6u %10.1f\n", argv[i],
+			status, stats.xfers, stats.matched, stats.skipped,
+			stats.diverged, stats.unmatched, stats.errors,
+			(double)(stats.last_ns - stats.first_ns) / 1000);
+		if (status != VL53L0_ERROR_NONE || stats.skipped ||
+				stats.diverged || stats.unmatched)
+			failed = 1;
+	}
+	printf("%u records left\n", nb_records - pos);
+
+	return failed;
+
+usage:
+	fprintf(stderr, "usage: %s [-w window] trace_file flow...\n",
+		argv[0]);
+	return 1;
+}
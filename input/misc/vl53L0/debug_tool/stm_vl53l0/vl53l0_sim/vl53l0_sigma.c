@@ -0,0 +1,539 @@
+/*
+ *  vl53l0_sigma.c - time the sigma estimate of the PAL against the
+ *		     original per-sample computation
+ *
+ *  Copyright (C) 2016 STMicroelectronics Imaging Division
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+/*
+ * Usage: vl53l0_sigma [-n samples] [-p passes]
+ *
+ * VL53L0_calc_sigma_estimate() takes its configuration dependent terms
+ * (timeouts, VCSEL duration, reference sigma, xtalk rate) from a cache
+ * filled by VL53L0_calc_sigma_estimate_config(). The original function,
+ * which recomputed them for every sample, is kept below as the
+ * reference.
+ *
+ * After the driver's bring-up against the simulated device, both are
+ * run on the same random measurements for each timing budget, with and
+ * without xtalk compensation. The estimates must be identical, the run
+ * fails otherwise. The time per sample is the best of passes (5) runs
+ * over the samples (10000); the cycles are TSC cycles on x86, where the
+ * TSC is available.
+ */
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SIGMA_HAVE_TSC	1
+#endif
+
+#include "vl53l0_api.h"
+#include "vl53l0_api_core.h"
+#include "vl53l0_sim.h"
+
+#define LOG_FUNCTION_START(fmt, ...) \
+	_LOG_FUNCTION_START(TRACE_MODULE_API, fmt, ##__VA_ARGS__)
+#define LOG_FUNCTION_END(status, ...) \
+	_LOG_FUNCTION_END(TRACE_MODULE_API, status, ##__VA_ARGS__)
+
+static struct vl53l0_sim sim;
+static struct stmvl53l0_data dev;
+
+/* VL53L0_calc_sigma_estimate() before the configuration terms were cached */
+static VL53L0_Error sigma_reference(VL53L0_DEV Dev,
+	VL53L0_RangingMeasurementData_t *pRangingMeasurementData,
+	FixPoint1616_t *pSigmaEstimate)
+{
+	/* Expressed in 100ths of a ns, i.e. centi-ns */
+	const uint32_t cPulseEffectiveWidth_centi_ns   = 800;
+	/* Expressed in 100ths of a ns, i.e. centi-ns */
+	const uint32_t cAmbientEffectiveWidth_centi_ns = 600;
+	const FixPoint1616_t cDfltFinalRangeIntegrationTimeMilliSecs =
+						0x00190000; /* 25ms */
+	const uint32_t cVcselPulseWidth_ps	= 4700; /* pico secs */
+	const FixPoint1616_t cSigmaEstMax	= 0x028F87AE;
+	const FixPoint1616_t cSigmaEstRtnMax	= 0xF000;
+	const FixPoint1616_t cAmbToSignalRatioMax = 0xF0000000/
+		cAmbientEffectiveWidth_centi_ns;
+	/* Time Of Flight per mm (6.6 pico secs) */
+	const FixPoint1616_t cTOF_per_mm_ps		= 0x0006999A;
+	const uint32_t c16BitRoundingParam		= 0x00008000;
+	const FixPoint1616_t cMaxXTalk_kcps		= 0x00320000;
+	const uint32_t cPllPeriod_ps			= 1655;
+
+	uint32_t vcselTotalEventsRtn;
+	uint32_t finalRangeTimeoutMicroSecs;
+	uint32_t preRangeTimeoutMicroSecs;
+	uint32_t finalRangeIntegrationTimeMilliSecs;
+	FixPoint1616_t sigmaEstimateP1;
+	FixPoint1616_t sigmaEstimateP2;
+	FixPoint1616_t sigmaEstimateP3;
+	FixPoint1616_t deltaT_ps;
+	FixPoint1616_t pwMult;
+	FixPoint1616_t sigmaEstRtn;
+	FixPoint1616_t sigmaEstimate;
+	FixPoint1616_t xTalkCorrection;
+	FixPoint1616_t ambientRate_kcps;
+	FixPoint1616_t peakSignalRate_kcps;
+	FixPoint1616_t xTalkCompRate_mcps;
+	uint32_t xTalkCompRate_kcps;
+	VL53L0_Error Status = VL53L0_ERROR_NONE;
+	FixPoint1616_t diff1_mcps;
+	FixPoint1616_t diff2_mcps;
+	FixPoint1616_t sqr1;
+	FixPoint1616_t sqr2;
+	FixPoint1616_t sqrSum;
+	FixPoint1616_t sqrtResult_centi_ns;
+	FixPoint1616_t sqrtResult;
+	FixPoint1616_t totalSignalRate_mcps;
+	FixPoint1616_t sigmaEstRef;
+	uint32_t vcselWidth;
+	uint32_t finalRangeMacroPCLKS;
+	uint32_t preRangeMacroPCLKS;
+	uint32_t peakVcselDuration_us;
+	uint8_t finalRangeVcselPCLKS;
+	uint8_t preRangeVcselPCLKS;
+	/*! \addtogroup calc_sigma_estimate
+	 * @{
+	 *
+	 * Estimates the range sigma
+	 */
+
+	LOG_FUNCTION_START("");
+
+	VL53L0_GETPARAMETERFIELD(Dev, XTalkCompensationRateMegaCps,
+			xTalkCompRate_mcps);
+
+	/*
+	 * We work in kcps rather than mcps as this helps keep within the
+	 * confines of the 32 Fix1616 type.
+	 */
+
+	ambientRate_kcps =
+		(pRangingMeasurementData->AmbientRateRtnMegaCps * 1000) >> 16;
+
+	Status = VL53L0_get_total_signal_rate(
+		Dev, pRangingMeasurementData, &totalSignalRate_mcps);
+	Status = VL53L0_get_total_xtalk_rate(
+		Dev, pRangingMeasurementData, &xTalkCompRate_mcps);
+
+
+	/* Signal rate measurement provided by device is the
+	 * peak signal rate, not average.
+	 */
+	peakSignalRate_kcps = (totalSignalRate_mcps * 1000);
+	peakSignalRate_kcps = (peakSignalRate_kcps + 0x8000) >> 16;
+
+	xTalkCompRate_kcps = xTalkCompRate_mcps * 1000;
+
+	if (xTalkCompRate_kcps > cMaxXTalk_kcps)
+		xTalkCompRate_kcps = cMaxXTalk_kcps;
+
+	if (Status == VL53L0_ERROR_NONE) {
+
+		/* Calculate final range macro periods */
+		finalRangeTimeoutMicroSecs = VL53L0_GETDEVICESPECIFICPARAMETER(
+			Dev, FinalRangeTimeoutMicroSecs);
+
+		finalRangeVcselPCLKS = VL53L0_GETDEVICESPECIFICPARAMETER(
+			Dev, FinalRangeVcselPulsePeriod);
+
+		finalRangeMacroPCLKS = VL53L0_calc_timeout_mclks(
+			Dev, finalRangeTimeoutMicroSecs, finalRangeVcselPCLKS);
+
+		/* Calculate pre-range macro periods */
+		preRangeTimeoutMicroSecs = VL53L0_GETDEVICESPECIFICPARAMETER(
+			Dev, PreRangeTimeoutMicroSecs);
+
+		preRangeVcselPCLKS = VL53L0_GETDEVICESPECIFICPARAMETER(
+			Dev, PreRangeVcselPulsePeriod);
+
+		preRangeMacroPCLKS = VL53L0_calc_timeout_mclks(
+			Dev, preRangeTimeoutMicroSecs, preRangeVcselPCLKS);
+
+		vcselWidth = 3;
+		if (finalRangeVcselPCLKS == 8)
+			vcselWidth = 2;
+
+
+		peakVcselDuration_us = vcselWidth * 2048 *
+			(preRangeMacroPCLKS + finalRangeMacroPCLKS);
+		peakVcselDuration_us = (peakVcselDuration_us + 500)/1000;
+		peakVcselDuration_us *= cPllPeriod_ps;
+		peakVcselDuration_us = (peakVcselDuration_us + 500)/1000;
+
+		/* Fix1616 >> 8 = Fix2408 */
+		totalSignalRate_mcps = (totalSignalRate_mcps + 0x80) >> 8;
+
+		/* Fix2408 * uint32 = Fix2408 */
+		vcselTotalEventsRtn = totalSignalRate_mcps *
+			peakVcselDuration_us;
+
+		/* Fix2408 >> 8 = uint32 */
+		vcselTotalEventsRtn = (vcselTotalEventsRtn + 0x80) >> 8;
+
+		/* Fix2408 << 8 = Fix1616 = */
+		totalSignalRate_mcps <<= 8;
+	}
+
+	if (Status != VL53L0_ERROR_NONE) {
+		LOG_FUNCTION_END(Status);
+		return Status;
+	}
+
+	if (peakSignalRate_kcps == 0) {
+		*pSigmaEstimate = cSigmaEstMax;
+		PALDevDataSet(Dev, SigmaEstimate, cSigmaEstMax);
+	} else {
+		if (vcselTotalEventsRtn < 1)
+			vcselTotalEventsRtn = 1;
+
+		sigmaEstimateP1 = cPulseEffectiveWidth_centi_ns;
+
+		/* ((FixPoint1616 << 16)* uint32)/uint32 = FixPoint1616 */
+		sigmaEstimateP2 = (ambientRate_kcps << 16)/peakSignalRate_kcps;
+		if (sigmaEstimateP2 > cAmbToSignalRatioMax) {
+			/* Clip to prevent overflow. Will ensure safe
+			 * max result.
+			 */
+			sigmaEstimateP2 = cAmbToSignalRatioMax;
+		}
+		sigmaEstimateP2 *= cAmbientEffectiveWidth_centi_ns;
+
+		sigmaEstimateP3 = 2 * VL53L0_isqrt(vcselTotalEventsRtn * 12);
+
+		/* uint32 * FixPoint1616 = FixPoint1616 */
+		deltaT_ps = pRangingMeasurementData->RangeMilliMeter *
+					cTOF_per_mm_ps;
+
+		/*
+		 * vcselRate - xtalkCompRate
+		 * (uint32 << 16) - FixPoint1616 = FixPoint1616.
+		 * Divide result by 1000 to convert to mcps.
+		 * 500 is added to ensure rounding when integer division
+		 * truncates.
+		 */
+		diff1_mcps = (((peakSignalRate_kcps << 16) -
+			2 * xTalkCompRate_kcps) + 500)/1000;
+
+		/* vcselRate + xtalkCompRate */
+		diff2_mcps = ((peakSignalRate_kcps << 16) + 500)/1000;
+
+		/* Shift by 8 bits to increase resolution prior to the
+		 * division
+		 */
+		diff1_mcps <<= 8;
+
+		/* FixPoint0824/FixPoint1616 = FixPoint2408 */
+		xTalkCorrection	 = abs(diff1_mcps/diff2_mcps);
+
+		/* FixPoint2408 << 8 = FixPoint1616 */
+		xTalkCorrection <<= 8;
+
+		if (pRangingMeasurementData->RangeStatus != 0) {
+			pwMult = 1 << 16;
+		} else {
+			/* FixPoint1616/uint32 = FixPoint1616 */
+			/* smaller than 1.0f */
+			pwMult = deltaT_ps/cVcselPulseWidth_ps;
+
+			/*
+			 * FixPoint1616 * FixPoint1616 = FixPoint3232, however
+			 * both values are small enough such that32 bits will
+			 * not be exceeded.
+			 */
+			pwMult *= ((1 << 16) - xTalkCorrection);
+
+			/* (FixPoint3232 >> 16) = FixPoint1616 */
+			pwMult =  (pwMult + c16BitRoundingParam) >> 16;
+
+			/* FixPoint1616 + FixPoint1616 = FixPoint1616 */
+			pwMult += (1 << 16);
+
+			/*
+			 * At this point the value will be 1.xx, therefore if we
+			 * square the value this will exceed 32 bits. To address
+			 * this perform a single shift to the right before the
+			 * multiplication.
+			 */
+			pwMult >>= 1;
+			/* FixPoint1715 * FixPoint1715 = FixPoint3430 */
+			pwMult = pwMult * pwMult;
+
+			/* (FixPoint3430 >> 14) = Fix1616 */
+			pwMult >>= 14;
+		}
+
+		/* FixPoint1616 * uint32 = FixPoint1616 */
+		sqr1 = pwMult * sigmaEstimateP1;
+
+		/* (FixPoint1616 >> 16) = FixPoint3200 */
+		sqr1 = (sqr1 + 0x8000) >> 16;
+
+		/* FixPoint3200 * FixPoint3200 = FixPoint6400 */
+		sqr1 *= sqr1;
+
+		sqr2 = sigmaEstimateP2;
+
+		/* (FixPoint1616 >> 16) = FixPoint3200 */
+		sqr2 = (sqr2 + 0x8000) >> 16;
+
+		/* FixPoint3200 * FixPoint3200 = FixPoint6400 */
+		sqr2 *= sqr2;
+
+		/* FixPoint64000 + FixPoint6400 = FixPoint6400 */
+		sqrSum = sqr1 + sqr2;
+
+		/* SQRT(FixPoin6400) = FixPoint3200 */
+		sqrtResult_centi_ns = VL53L0_isqrt(sqrSum);
+
+		/* (FixPoint3200 << 16) = FixPoint1616 */
+		sqrtResult_centi_ns <<= 16;
+
+		/*
+		 * Note that the Speed Of Light is expressed in um per 1E-10
+		 * seconds (2997) Therefore to get mm/ns we have to divide by
+		 * 10000
+		 */
+		sigmaEstRtn = (((sqrtResult_centi_ns+50)/100) /
+				sigmaEstimateP3);
+		sigmaEstRtn		 *= VL53L0_SPEED_OF_LIGHT_IN_AIR;
+
+		/* Add 5000 before dividing by 10000 to ensure rounding. */
+		sigmaEstRtn		 += 5000;
+		sigmaEstRtn		 /= 10000;
+
+		if (sigmaEstRtn > cSigmaEstRtnMax) {
+			/* Clip to prevent overflow. Will ensure safe
+			 * max result.
+			 */
+			sigmaEstRtn = cSigmaEstRtnMax;
+		}
+		finalRangeIntegrationTimeMilliSecs =
+		    (finalRangeTimeoutMicroSecs + preRangeTimeoutMicroSecs +
+		     500) / 1000;
+
+		/* sigmaEstRef = 1mm * 25ms/final range integration time
+		 * (inc pre-range)
+		 * sqrt(FixPoint1616/int) = FixPoint2408)
+		 */
+		sigmaEstRef =
+			VL53L0_isqrt((cDfltFinalRangeIntegrationTimeMilliSecs +
+				finalRangeIntegrationTimeMilliSecs/2)/
+				finalRangeIntegrationTimeMilliSecs);
+
+		/* FixPoint2408 << 8 = FixPoint1616 */
+		sigmaEstRef <<= 8;
+		sigmaEstRef = (sigmaEstRef + 500)/1000;
+
+		/* FixPoint1616 * FixPoint1616 = FixPoint3232 */
+		sqr1 = sigmaEstRtn * sigmaEstRtn;
+		/* FixPoint1616 * FixPoint1616 = FixPoint3232 */
+		sqr2 = sigmaEstRef * sigmaEstRef;
+
+		/* sqrt(FixPoint3232) = FixPoint1616 */
+		sqrtResult = VL53L0_isqrt((sqr1 + sqr2));
+		/*
+		 * Note that the Shift by 4 bits increases resolution prior to
+		 * the sqrt, therefore the result must be shifted by 2 bits to
+		 * the right to revert back to the FixPoint1616 format.
+		 */
+
+		sigmaEstimate	 = 1000 * sqrtResult;
+
+		if ((peakSignalRate_kcps < 1) || (vcselTotalEventsRtn < 1) ||
+				(sigmaEstimate > cSigmaEstMax)) {
+			sigmaEstimate = cSigmaEstMax;
+		}
+
+		*pSigmaEstimate = (uint32_t)(sigmaEstimate);
+		PALDevDataSet(Dev, SigmaEstimate, *pSigmaEstimate);
+	}
+
+	LOG_FUNCTION_END(Status);
+	return Status;
+}
+
+typedef VL53L0_Error (*sigma_fn)(VL53L0_DEV Dev,
+	VL53L0_RangingMeasurementData_t *pRangingMeasurementData,
+	FixPoint1616_t *pSigmaEstimate);
+
+struct sigma_time {
+	double ns;
+	double cycles;
+};
+
+static uint64_t sigma_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t sigma_cycles(void)
+{
+#ifdef SIGMA_HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static void sigma_measurements(VL53L0_RangingMeasurementData_t *r,
+	unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		memset(&r[i], 0, sizeof(r[i]));
+		r[i].RangeMilliMeter = rand() % 2000;
+		r[i].RangeStatus = (rand() % 8) ? 0 : 1 + rand() % 4;
+		/* 0 to 40 Mcps signal, 0 to 10 Mcps ambient */
+		r[i].SignalRateRtnMegaCps = rand() % (40 << 16);
+		if (rand() % 32 == 0)
+			r[i].SignalRateRtnMegaCps = 0;
+		r[i].AmbientRateRtnMegaCps = rand() % (10 << 16);
+		/* Fix8.8 SPAD count */
+		r[i].EffectiveSpadRtnCount = (1 + rand() % 40) << 8;
+	}
+}
+
+/* time one path, returns the sum of the estimates */
+static uint64_t sigma_time(sigma_fn fn, VL53L0_RangingMeasurementData_t *r,
+	FixPoint1616_t *sigma, unsigned int n, unsigned int passes,
+	struct sigma_time *t)
+{
+	uint64_t ns, cycles, sum = 0;
+	unsigned int i, p;
+
+	t->ns = 0;
+	t->cycles = 0;
+	for (p = 0; p < passes; p++) {
+		ns = sigma_ns();
+		cycles = sigma_cycles();
+		for (i = 0; i < n; i++)
+			fn(&dev, &r[i], &sigma[i]);
+		cycles = sigma_cycles() - cycles;
+		ns = sigma_ns() - ns;
+		if (p == 0 || (double)ns / n < t->ns) {
+			t->ns = (double)ns / n;
+			t->cycles = (double)cycles / n;
+		}
+	}
+	for (i = 0; i < n; i++)
+		sum += sigma[i];
+
+	return sum;
+}
+
+int main(int argc, char *argv[])
+{
+	static const uint32_t budgets[] = { 20000, 33000, 200000 };
+	struct vl53l0_sim_target target = { 0 };
+	VL53L0_RangingMeasurementData_t *r;
+	FixPoint1616_t *ref, *cached;
+	struct sigma_time tref, tcached;
+	unsigned int samples = 10000, passes = 5;
+	unsigned int i, b, mismatch = 0;
+	uint32_t spad_count;
+	uint8_t vhv, phase, aperture;
+	int xtalk, opt;
+
+	while ((opt = getopt(argc, argv, "n:p:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			samples = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			passes = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n samples] [-p passes]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (!samples || !passes)
+		return 1;
+
+	r = calloc(samples, sizeof(*r));
+	ref = calloc(samples, sizeof(*ref));
+	cached = calloc(samples, sizeof(*cached));
+	if (!r || !ref || !cached)
+		return 1;
+
+	target.near_mm = target.far_mm = 300;
+	target.reflectance = 88;
+	target.ambient_kcps = 200;
+	vl53l0_sim_init(&sim, &target);
+	dev.sim = &sim;
+	dev.I2cDevAddr = 0x52;
+	dev.comms_type = 1;
+	dev.comms_speed_khz = 400;
+	if (VL53L0_DataInit(&dev) != VL53L0_ERROR_NONE ||
+		VL53L0_StaticInit(&dev) != VL53L0_ERROR_NONE ||
+		VL53L0_PerformRefCalibration(&dev, &vhv, &phase) !=
+			VL53L0_ERROR_NONE ||
+		VL53L0_PerformRefSpadManagement(&dev, &spad_count,
+			&aperture) != VL53L0_ERROR_NONE) {
+		fprintf(stderr, "bring-up failed\n");
+		return 1;
+	}
+
+	srand(1);
+	sigma_measurements(r, samples);
+
+	printf("%-8s %-5s %12s %12s %12s %12s %7s\n", "budget", "xtalk",
+		"orig ns", "cached ns", "orig cyc", "cached cyc", "exact");
+	for (b = 0; b < sizeof(budgets) / sizeof(budgets[0]); b++) {
+		for (xtalk = 0; xtalk <= 1; xtalk++) {
+			if (VL53L0_SetMeasurementTimingBudgetMicroSeconds(&dev,
+				budgets[b]) != VL53L0_ERROR_NONE ||
+				VL53L0_SetXTalkCompensationRateMegaCps(&dev,
+					xtalk ? 0x100 : 0) != VL53L0_ERROR_NONE ||
+				VL53L0_SetXTalkCompensationEnable(&dev,
+					xtalk) != VL53L0_ERROR_NONE) {
+				fprintf(stderr, "configuration failed\n");
+				return 1;
+			}
+
+			sigma_time(sigma_reference, r, ref, samples, passes,
+				&tref);
+			sigma_time(VL53L0_calc_sigma_estimate, r, cached,
+				samples, passes, &tcached);
+			for (i = 0; i < samples; i++)
+				if (ref[i] != cached[i])
+					break;
+			if (i < samples) {
+				mismatch++;
+				fprintf(stderr, "budget %u xtalk %d sample %u: "
+					"sigma 0x%08x, expected 0x%08x\n",
+					budgets[b], xtalk, i, cached[i],
+					ref[i]);
+			}
+			printf("%-8u %-5d %12.1f %12.1f %12.0f %12.0f %7s\n",
+				budgets[b], xtalk, tref.ns, tcached.ns,
+				tref.cycles, tcached.cycles,
+				i < samples ? "no" : "yes");
+		}
+	}
+#ifndef SIGMA_HAVE_TSC
+	printf("no TSC on this host, cycles not available\n");
+#endif
+
+	return mismatch ? 1 : 0;
+}
@@ -0,0 +1,493 @@
+/*
+ *  vl53l0_sim.c - register-level VL53L0 device model for host builds of
+ *		   the PAL
+ *
+ *  Copyright (C) 2016 STMicroelectronics Imaging Division
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+#include <math.h>
+#include <string.h>
+
+#include "vl53l0_platform.h"
+#include "vl53l0_i2c_platform.h"
+#include "vl53l0_device.h"
+#include "vl53l0_sim.h"
+
+/* NVM is read through page 7: 0x94 address, 0x83 strobe, 0x90 data */
+#define NVM_PAGE		7
+#define NVM_REG_ADDR		0x94
+#define NVM_REG_STROBE		0x83
+#define NVM_REG_DATA		0x90
+
+#define SEQ_TCC			0x10
+#define SEQ_DSS			0x08
+#define SEQ_MSRC		0x04
+#define SEQ_PRE_RANGE		0x40
+#define SEQ_FINAL_RANGE		0x80
+
+/* return signal of a 100% reflectance target at 400mm, MCPS */
+#define SIM_SIGNAL_400MM	8.0
+#define SIM_SIGNAL_400MM_FIX97	0x0400
+/* reference SPAD return rate, 9.7 MCPS per enabled SPAD */
+#define SIM_REF_SPAD_RATE	0x0180
+/* below this return rate, or beyond this distance, no target is found */
+#define SIM_SIGNAL_MIN		0.1
+#define SIM_RANGE_MAX		2000
+#define SIM_RANGE_NONE		8190
+
+#define DEVICE_STATUS_VALID	11
+#define DEVICE_STATUS_NO_TARGET	4
+
+static const char sim_product_id[] = "VL53L0CBV0DH/1$5";
+
+/* the PAL delays have no device argument */
+static struct vl53l0_sim *sim_current;
+
+static uint16_t sim_rd16(struct vl53l0_sim *sim, uint8_t page, uint8_t index)
+{
+	return (uint16_t)((sim->reg[page][index] << 8) |
+		sim->reg[page][(uint8_t)(index + 1)]);
+}
+
+static uint32_t sim_rd32(struct vl53l0_sim *sim, uint8_t page, uint8_t index)
+{
+	return ((uint32_t)sim_rd16(sim, page, index) << 16) |
+		sim_rd16(sim, page, (uint8_t)(index + 2));
+}
+
+static void sim_wr16(struct vl53l0_sim *sim, uint8_t page, uint8_t index,
+	uint16_t data)
+{
+	sim->reg[page][index] = (uint8_t)(data >> 8);
+	sim->reg[page][(uint8_t)(index + 1)] = (uint8_t)data;
+}
+
+static uint32_t sim_rand(struct vl53l0_sim *sim)
+{
+	/* xorshift32, reproducible across runs */
+	sim->rng ^= sim->rng << 13;
+	sim->rng ^= sim->rng >> 17;
+	sim->rng ^= sim->rng << 5;
+	return sim->rng;
+}
+
+/* roughly normal, zero mean, unit variance */
+static double sim_gauss(struct vl53l0_sim *sim)
+{
+	double sum = 0;
+	int i;
+
+	for (i = 0; i < 12; i++)
+		sum += (double)sim_rand(sim) / 4294967296.0;
+	return sum - 6.0;
+}
+
+/*
+ * Timing budget, decoded from the registers the same way
+ * VL53L0_get_measurement_timing_budget_micro_seconds() does
+ */
+static uint32_t sim_macro_period_ns(uint8_t vcsel_reg)
+{
+	uint32_t pclks = ((uint32_t)vcsel_reg + 1) << 1;
+
+	return (2304 * pclks * 1655 + 500) / 1000;
+}
+
+static uint32_t sim_decode_timeout(uint16_t encoded)
+{
+	return ((uint32_t)(encoded & 0x00FF) << (encoded >> 8)) + 1;
+}
+
+static uint32_t sim_mclks_to_us(uint32_t mclks, uint8_t vcsel_reg)
+{
+	uint64_t ns = (uint64_t)mclks * sim_macro_period_ns(vcsel_reg);
+
+	return (uint32_t)((ns + 500) / 1000);
+}
+
+uint32_t vl53l0_sim_budget_us(struct vl53l0_sim *sim)
+{
+	uint8_t seq = sim->reg[0][VL53L0_REG_SYSTEM_SEQUENCE_CONFIG];
+	uint8_t pre_vcsel =
+		sim->reg[0][VL53L0_REG_PRE_RANGE_CONFIG_VCSEL_PERIOD];
+	uint8_t final_vcsel =
+		sim->reg[0][VL53L0_REG_FINAL_RANGE_CONFIG_VCSEL_PERIOD];
+	uint32_t msrc_us, pre_mclks, pre_us, final_mclks, final_us;
+	uint32_t budget = 1910 + 960;
+
+	msrc_us = sim_mclks_to_us(
+		sim->reg[0][VL53L0_REG_MSRC_CONFIG_TIMEOUT_MACROP] + 1,
+		pre_vcsel);
+	pre_mclks = sim_decode_timeout(sim_rd16(sim, 0,
+		VL53L0_REG_PRE_RANGE_CONFIG_TIMEOUT_MACROP_HI));
+	pre_us = sim_mclks_to_us(pre_mclks, pre_vcsel);
+	final_mclks = sim_decode_timeout(sim_rd16(sim, 0,
+		VL53L0_REG_FINAL_RANGE_CONFIG_TIMEOUT_MACROP_HI));
+	if (seq & SEQ_PRE_RANGE)
+		final_mclks -= pre_mclks;
+	final_us = sim_mclks_to_us(final_mclks, final_vcsel);
+
+	if (seq & SEQ_TCC)
+		budget += msrc_us + 590;
+	if (seq & SEQ_DSS)
+		budget += 2 * (msrc_us + 690);
+	else if (seq & SEQ_MSRC)
+		budget += msrc_us + 660;
+	if (seq & SEQ_PRE_RANGE)
+		budget += pre_us + 660;
+	if (seq & SEQ_FINAL_RANGE)
+		budget += final_us + 550;
+
+	return budget;
+}
+
+static uint64_t sim_period_ns(struct vl53l0_sim *sim)
+{
+	uint64_t budget_ns = (uint64_t)vl53l0_sim_budget_us(sim) * 1000;
+	uint64_t period_ns;
+	uint32_t osc;
+
+	if (!(sim->mode & VL53L0_REG_SYSRANGE_MODE_TIMED))
+		return budget_ns;
+
+	osc = sim_rd16(sim, 0, VL53L0_REG_OSC_CALIBRATE_VAL);
+	period_ns = sim_rd32(sim, 0, VL53L0_REG_SYSTEM_INTERMEASUREMENT_PERIOD);
+	if (osc)
+		period_ns /= osc;
+	period_ns *= 1000000;
+
+	return period_ns > budget_ns ? period_ns : budget_ns;
+}
+
+uint32_t vl53l0_sim_period_us(struct vl53l0_sim *sim)
+{
+	return (uint32_t)(sim_period_ns(sim) / 1000);
+}
+
+static uint32_t sim_distance(struct vl53l0_sim *sim)
+{
+	const struct vl53l0_sim_target *t = &sim->target;
+	uint64_t k = sim->cnt.samples;
+	int64_t span = (int64_t)t->far_mm - t->near_mm;
+
+	if (!t->ramp_samples)
+		return t->near_mm;
+	if (k > t->ramp_samples)
+		k = t->ramp_samples;
+	return (uint32_t)(t->near_mm + span * (int64_t)k / t->ramp_samples);
+}
+
+static uint16_t sim_fix97(double mcps)
+{
+	double v = mcps * 128.0;
+
+	return v > 0xFFFF ? 0xFFFF : (uint16_t)v;
+}
+
+static void sim_interrupt(struct vl53l0_sim *sim, uint16_t range_mm)
+{
+	uint8_t config = sim->reg[0][VL53L0_REG_SYSTEM_INTERRUPT_CONFIG_GPIO]
+		& 0x07;
+	uint32_t low = 2 * (uint32_t)sim_rd16(sim, 0,
+		VL53L0_REG_SYSTEM_THRESH_LOW);
+	uint32_t high = 2 * (uint32_t)sim_rd16(sim, 0,
+		VL53L0_REG_SYSTEM_THRESH_HIGH);
+	int hit = 0;
+
+	switch (config) {
+	case VL53L0_REG_SYSTEM_INTERRUPT_GPIO_LEVEL_LOW:
+		hit = range_mm < low;
+		break;
+	case VL53L0_REG_SYSTEM_INTERRUPT_GPIO_LEVEL_HIGH:
+		hit = range_mm > high;
+		break;
+	case VL53L0_REG_SYSTEM_INTERRUPT_GPIO_OUT_OF_WINDOW:
+		hit = range_mm < low || range_mm > high;
+		break;
+	case VL53L0_REG_SYSTEM_INTERRUPT_GPIO_NEW_SAMPLE_READY:
+		hit = 1;
+		break;
+	}
+	if (hit)
+		sim->reg[0][VL53L0_REG_RESULT_INTERRUPT_STATUS] = config;
+}
+
+/* a measurement completes: fill the result block and raise the interrupt */
+static void sim_complete(struct vl53l0_sim *sim)
+{
+	const struct vl53l0_sim_target *t = &sim->target;
+	uint32_t distance = sim_distance(sim);
+	uint32_t budget = vl53l0_sim_budget_us(sim);
+	uint8_t *res = &sim->reg[0][VL53L0_REG_RESULT_RANGE_STATUS];
+	uint8_t *ref = &sim->reg[0][VL53L0_REG_GLOBAL_CONFIG_SPAD_ENABLES_REF_0];
+	double signal, ambient, noise;
+	uint8_t device_status = DEVICE_STATUS_VALID;
+	uint32_t ref_spads = 0;
+	int32_t range;
+	int i;
+
+	signal = SIM_SIGNAL_400MM * t->reflectance / 100.0;
+	if (distance)
+		signal *= (400.0 * 400.0) / ((double)distance * distance);
+	ambient = t->ambient_kcps / 1000.0;
+
+	noise = t->noise_mm;
+	if (signal > 0)
+		noise *= sqrt(SIM_SIGNAL_400MM / signal);
+	if (budget)
+		noise *= sqrt(33000.0 / budget);
+	range = (int32_t)distance + (int32_t)lrint(noise * sim_gauss(sim));
+	if (range < 0)
+		range = 0;
+
+	if (signal < SIM_SIGNAL_MIN || distance > SIM_RANGE_MAX) {
+		device_status = DEVICE_STATUS_NO_TARGET;
+		range = SIM_RANGE_NONE;
+	}
+	if (sim->reg[0][VL53L0_REG_SYSTEM_RANGE_CONFIG] & 0x01)
+		range <<= 2;
+
+	memset(res, 0, 12);
+	res[0] = (uint8_t)((device_status << 3) | 0x01);
+	sim_wr16(sim, 0, VL53L0_REG_RESULT_RANGE_STATUS + 2, 0x1000);
+	sim_wr16(sim, 0, VL53L0_REG_RESULT_RANGE_STATUS + 6, sim_fix97(signal));
+	sim_wr16(sim, 0, VL53L0_REG_RESULT_RANGE_STATUS + 8,
+		sim_fix97(ambient));
+	sim_wr16(sim, 0, VL53L0_REG_RESULT_RANGE_STATUS + 10,
+		(uint16_t)(range > 0xFFFF ? 0xFFFF : range));
+
+	for (i = 0; i < 6; i++)
+		ref_spads += __builtin_popcount(ref[i]);
+	sim_wr16(sim, 1, VL53L0_REG_RESULT_PEAK_SIGNAL_RATE_REF,
+		(uint16_t)(ref_spads * SIM_REF_SPAD_RATE));
+
+	sim_interrupt(sim, (uint16_t)range);
+	sim->distance_mm = distance;
+	sim->cnt.samples++;
+}
+
+/* run the device up to the current simulated time */
+static void sim_update(struct vl53l0_sim *sim)
+{
+	while (sim->ranging && sim->now_ns >= sim->ready_ns) {
+		sim_complete(sim);
+		if (sim->mode & (VL53L0_REG_SYSRANGE_MODE_BACKTOBACK |
+				VL53L0_REG_SYSRANGE_MODE_TIMED))
+			sim->ready_ns += sim_period_ns(sim);
+		else
+			sim->ranging = 0;
+	}
+}
+
+static void sim_bus(struct vl53l0_sim *sim, uint8_t bytes, uint16_t khz)
+{
+	/* device address + data, 9 bits each, plus start and stop */
+	uint64_t bits = 9 * (1 + (uint64_t)bytes) + 2;
+	uint64_t ns = bits * 1000000 / (khz ? khz : 400);
+
+	sim->cnt.xfers++;
+	sim->cnt.bytes += 1 + bytes;
+	sim->cnt.bus_ns += ns;
+	sim->now_ns += ns;
+	sim_update(sim);
+}
+
+static void sim_write_reg(struct vl53l0_sim *sim, uint8_t index, uint8_t data)
+{
+	uint32_t nvm;
+	uint8_t *p;
+
+	if (index == 0xFF) {
+		sim->page = data & (VL53L0_SIM_PAGES - 1);
+		return;
+	}
+
+	p = sim->reg[sim->page];
+	if (sim->page == 0 && index == VL53L0_REG_SYSRANGE_START) {
+		/*
+		 * single shot sets the start bit, which reads back as clear
+		 * once the device took it; back-to-back and timed modes start
+		 * on their own mode bit; 0 stops
+		 */
+		p[index] = data & ~VL53L0_REG_SYSRANGE_MODE_START_STOP;
+		sim->mode = data & (VL53L0_REG_SYSRANGE_MODE_BACKTOBACK |
+			VL53L0_REG_SYSRANGE_MODE_TIMED);
+		if ((data & VL53L0_REG_SYSRANGE_MODE_START_STOP) || sim->mode) {
+			sim->ranging = 1;
+			sim->ready_ns = sim->now_ns +
+				(uint64_t)vl53l0_sim_budget_us(sim) * 1000;
+		} else {
+			sim->ranging = 0;
+		}
+		return;
+	}
+	if (sim->page == 0 && index == VL53L0_REG_SYSTEM_INTERRUPT_CLEAR) {
+		p[index] = data;
+		if (data & 0x01) {
+			p[VL53L0_REG_RESULT_INTERRUPT_STATUS] = 0;
+			p[VL53L0_REG_RESULT_RANGE_STATUS] &= ~0x01;
+		}
+		return;
+	}
+	if (sim->page == NVM_PAGE && index == NVM_REG_STROBE && !data) {
+		nvm = sim->nvm[p[NVM_REG_ADDR] & (VL53L0_SIM_NVM_SIZE - 1)];
+		p[NVM_REG_DATA] = (uint8_t)(nvm >> 24);
+		p[NVM_REG_DATA + 1] = (uint8_t)(nvm >> 16);
+		p[NVM_REG_DATA + 2] = (uint8_t)(nvm >> 8);
+		p[NVM_REG_DATA + 3] = (uint8_t)nvm;
+		p[index] = 0x01;
+		return;
+	}
+	p[index] = data;
+}
+
+static uint8_t sim_read_reg(struct vl53l0_sim *sim, uint8_t index)
+{
+	if (index == 0xFF)
+		return sim->page;
+	return sim->reg[sim->page][index];
+}
+
+static void sim_capture(struct vl53l0_sim *sim, char dir, uint8_t reg,
+	const uint8_t *data, uint8_t len)
+{
+	uint8_t i;
+
+	fprintf(sim->capture, "%llu %c %02x 0 %u ",
+		(unsigned long long)sim->now_ns, dir, reg, len);
+	for (i = 0; i < len; i++)
+		fprintf(sim->capture, "%02x", data[i]);
+	fputc('\n', sim->capture);
+}
+
+int VL53L0_I2CWrite(VL53L0_DEV dev, uint8_t *buff, uint8_t len)
+{
+	struct vl53l0_sim *sim = dev->sim;
+	uint8_t i;
+
+	if (!len)
+		return 1;
+
+	sim_bus(sim, len, dev->comms_speed_khz);
+	sim->index = buff[0];
+	for (i = 1; i < len; i++)
+		sim_write_reg(sim, sim->index++, buff[i]);
+	if (sim->capture)
+		sim_capture(sim, 'w', buff[0], &buff[1], len - 1);
+
+	return 0;
+}
+
+int VL53L0_I2CRead(VL53L0_DEV dev, uint8_t *buff, uint8_t len)
+{
+	struct vl53l0_sim *sim = dev->sim;
+	uint8_t reg = sim->index;
+	uint8_t i;
+
+	sim_bus(sim, len, dev->comms_speed_khz);
+	for (i = 0; i < len; i++)
+		buff[i] = sim_read_reg(sim, sim->index++);
+	if (sim->capture)
+		sim_capture(sim, 'r', reg, buff, len);
+
+	return 0;
+}
+
+/* nothing is queued on the host bus */
+int VL53L0_I2CFlush(VL53L0_DEV dev)
+{
+	return 0;
+}
+
+void vl53l0_sim_delay_us(unsigned long us)
+{
+	struct vl53l0_sim *sim = sim_current;
+
+	if (!sim)
+		return;
+	sim->now_ns += (uint64_t)us * 1000;
+	sim->cnt.wait_ns += (uint64_t)us * 1000;
+	sim_update(sim);
+}
+
+static uint16_t sim_encode_timeout(uint32_t mclks)
+{
+	uint32_t ls = mclks - 1;
+	uint16_t ms = 0;
+
+	while (ls > 0xFF) {
+		ls >>= 1;
+		ms++;
+	}
+	return (uint16_t)((ms << 8) | ls);
+}
+
+/* product id: 7-bit characters packed MSB first across 0x77..0x7A */
+static void sim_nvm_product_id(struct vl53l0_sim *sim)
+{
+	uint32_t pos = 0;
+	size_t i;
+	int b;
+
+	for (i = 0; i < 18; i++) {
+		char c = i < sizeof(sim_product_id) - 1 ? sim_product_id[i] : 0;
+
+		for (b = 6; b >= 0; b--, pos++) {
+			if (c & (1 << b))
+				sim->nvm[0x77 + pos / 32] |=
+					1U << (31 - pos % 32);
+		}
+	}
+}
+
+void vl53l0_sim_init(struct vl53l0_sim *sim,
+	const struct vl53l0_sim_target *target)
+{
+	memset(sim, 0, sizeof(*sim));
+	sim->target = *target;
+	sim->rng = 0x2545F491;
+
+	/* identification, page 0 */
+	sim->reg[0][VL53L0_REG_IDENTIFICATION_MODEL_ID] = 0xEE;
+	sim->reg[0][VL53L0_REG_IDENTIFICATION_REVISION_ID] = 0x10;
+
+	/* reset timing: about 33ms with every sequence step on */
+	sim->reg[0][VL53L0_REG_SYSTEM_SEQUENCE_CONFIG] = 0xFF;
+	sim->reg[0][VL53L0_REG_PRE_RANGE_CONFIG_VCSEL_PERIOD] = 6;
+	sim->reg[0][VL53L0_REG_FINAL_RANGE_CONFIG_VCSEL_PERIOD] = 4;
+	sim->reg[0][VL53L0_REG_MSRC_CONFIG_TIMEOUT_MACROP] = 12;
+	sim_wr16(sim, 0, VL53L0_REG_PRE_RANGE_CONFIG_TIMEOUT_MACROP_HI,
+		sim_encode_timeout(30));
+	sim_wr16(sim, 0, VL53L0_REG_FINAL_RANGE_CONFIG_TIMEOUT_MACROP_HI,
+		sim_encode_timeout(30 + 627));
+	sim->reg[0][VL53L0_REG_SYSTEM_INTERRUPT_CONFIG_GPIO] =
+		VL53L0_REG_SYSTEM_INTERRUPT_GPIO_NEW_SAMPLE_READY;
+
+	/* stop variable, read by DataInit */
+	sim->reg[1][0x91] = 0x3C;
+
+	/* NVM: 5 aperture ref SPADs, all good, module 1, rev 1.0 */
+	sim->nvm[0x6b] = (1 << 15) | (5 << 8);
+	sim->nvm[0x24] = 0xFFFFFFFF;
+	sim->nvm[0x25] = 0xFF0F0000;
+	sim->nvm[0x02] = 0x01000000;
+	sim->nvm[0x7B] = 0x10A5C3E1;
+	sim->nvm[0x7C] = 0x0F1E2D3C;
+	sim_nvm_product_id(sim);
+	/* 400mm calibration: 8 MCPS in 9.7, 400mm in 11.4 */
+	sim->nvm[0x73] = (SIM_SIGNAL_400MM_FIX97 >> 8) & 0xFF;
+	sim->nvm[0x74] = (uint32_t)(SIM_SIGNAL_400MM_FIX97 & 0xFF) << 24;
+	sim->nvm[0x75] = ((400 << 4) >> 8) & 0xFF;
+	sim->nvm[0x76] = (uint32_t)((400 << 4) & 0xFF) << 24;
+
+	sim_current = sim;
+}
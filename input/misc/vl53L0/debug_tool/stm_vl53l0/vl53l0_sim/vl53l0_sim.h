@@ -0,0 +1,80 @@
+/*
+ *  vl53l0_sim.h - register-level VL53L0 device model for host builds of
+ *		   the PAL
+ *
+ *  Copyright (C) 2016 STMicroelectronics Imaging Division
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+/*
+ * The model sits behind VL53L0_I2CWrite()/VL53L0_I2CRead() and keeps:
+ *  - the 0xFF paged register file, with the page 7 NVM read strobe;
+ *  - ranging started through SYSRANGE_START, completing after the
+ *    timing budget decoded from the sequence/VCSEL/timeout registers;
+ *  - a synthetic target (fixed or ramping distance, reflectance,
+ *    ambient, noise) turned into the RESULT_RANGE_STATUS block;
+ *  - a simulated clock that only advances with bus traffic and with the
+ *    PAL's delays, so results do not depend on the build box load.
+ * With capture set, every transfer is also logged there in the format of
+ * the driver's i2c_capture debugfs file.
+ */
+#ifndef VL53L0_SIM_H
+#define VL53L0_SIM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define VL53L0_SIM_PAGES	8
+#define VL53L0_SIM_NVM_SIZE	0x80
+
+struct vl53l0_sim_counters {
+	uint64_t xfers;		/* I2C transfers */
+	uint64_t bytes;		/* bytes on the bus, device address included */
+	uint64_t bus_ns;	/* bus time at comms_speed_khz */
+	uint64_t wait_ns;	/* time spent in PAL delays */
+	uint64_t samples;	/* measurements completed */
+};
+
+struct vl53l0_sim_target {
+	uint32_t near_mm;	/* distance of the first sample */
+	uint32_t far_mm;	/* distance reached after ramp_samples */
+	uint32_t ramp_samples;	/* 0: stay at near_mm */
+	uint32_t reflectance;	/* percent, 100: white target */
+	uint32_t ambient_kcps;	/* ambient rate */
+	uint32_t noise_mm;	/* range noise at 400mm, 100% reflectance */
+};
+
+struct vl53l0_sim {
+	uint8_t reg[VL53L0_SIM_PAGES][256];
+	uint8_t page;
+	uint8_t index;		/* register pointer, auto-incremented */
+	uint32_t nvm[VL53L0_SIM_NVM_SIZE];
+
+	struct vl53l0_sim_target target;
+	uint32_t rng;
+
+	uint64_t now_ns;
+	int ranging;		/* measurement in progress */
+	uint8_t mode;		/* SYSRANGE_START mode bits */
+	uint64_t ready_ns;	/* completion time of the current measurement */
+	uint32_t distance_mm;	/* true distance of the last result */
+
+	struct vl53l0_sim_counters cnt;
+	FILE *capture;		/* transfer log, or NULL */
+};
+
+void vl53l0_sim_init(struct vl53l0_sim *sim,
+	const struct vl53l0_sim_target *target);
+uint32_t vl53l0_sim_budget_us(struct vl53l0_sim *sim);
+/* sample period, the inter-measurement period in timed mode */
+uint32_t vl53l0_sim_period_us(struct vl53l0_sim *sim);
+
+#endif /* VL53L0_SIM_H */
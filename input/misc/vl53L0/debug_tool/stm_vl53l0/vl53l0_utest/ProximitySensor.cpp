@@ -86,6 +86,20 @@ int ProximitySensor::enable(int32_t, int en) {
     int flags = en ? 1 : 0;
     if (flags != mEnabled) {
         int fd;
+        if (flags) {
+            // only wake up when the target crosses the window
+            strcpy(&input_sysfs_path[input_sysfs_path_len], "/set_proximity");
+            fd = open(input_sysfs_path, O_RDWR);
+            if (fd >= 0) {
+                char window[40];
+                sprintf(window, "%d %d %d", PROXIMITY_NEAR_MM,
+                        PROXIMITY_FAR_MM, PROXIMITY_PERIOD_MS);
+                write(fd, window, strlen(window)+1);
+                close(fd);
+            } else {
+                LOGE("ProximitySensor::enable: Failed to set the proximity window");
+            }
+        }
         strcpy(&input_sysfs_path[input_sysfs_path_len], "/enable_ps_sensor");
         fd = open(input_sysfs_path, O_RDWR);
 ALOGE("ProximitySensor::enable filename:%s\n",input_sysfs_path);
@@ -37,6 +37,10 @@ __BEGIN_DECLS
 #define PROXIMITY_FIFO_RESERVED_COUNT	0
 #define PROXIMITY_FIFO_MAX_COUNT		0
 #define SENSOR_TYPE_TIME_OF_FLIGHT      (40)
+/* near/far event window used while enabled, see set_proximity */
+#define PROXIMITY_NEAR_MM				50
+#define PROXIMITY_FAR_MM				80
+#define PROXIMITY_PERIOD_MS				100
 __END_DECLS
 
 #endif  // ANDROID_SENSORS_H
@@ -77,10 +77,16 @@ VL53L0_Error VL53L0_get_measurement_timing_budget_micro_seconds(VL53L0_DEV Dev,
 VL53L0_Error VL53L0_load_tuning_settings(VL53L0_DEV Dev,
 		uint8_t *pTuningSettingBuffer);
 
+VL53L0_Error VL53L0_load_timing_mirror(VL53L0_DEV Dev);
+
+VL53L0_Error VL53L0_calc_sigma_estimate_config(VL53L0_DEV Dev);
+
 VL53L0_Error VL53L0_calc_sigma_estimate(VL53L0_DEV Dev,
 		VL53L0_RangingMeasurementData_t *pRangingMeasurementData,
 		FixPoint1616_t *pSigmaEstimate);
 
+VL53L0_Error VL53L0_calc_dmax_lut_segments(VL53L0_DEV Dev);
+
 VL53L0_Error VL53L0_calc_dmax(
 	VL53L0_DEV Dev, FixPoint1616_t ambRateMeas, uint32_t *pdmax_mm);
 
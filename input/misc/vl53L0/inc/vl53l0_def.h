@@ -509,6 +509,34 @@ typedef struct {
 	/*!< Indicate if we use	 Tuning Settings table */
 	uint16_t LinearityCorrectiveGain;
 	/*!< Linearity Corrective Gain value in x1000 */
+	uint8_t SigmaEstConfigValid;
+	/*!< Cached sigma estimate configuration terms are up to date */
+	uint32_t SigmaEstPeakVcselDuration_us;
+	/*!< Cached peak VCSEL duration (pre-range + final range) in us */
+	FixPoint1616_t SigmaEstRefSqr;
+	/*!< Cached reference sigma squared (FixPoint3232) */
+	FixPoint1616_t SigmaEstXTalkPerSpadMegaCps;
+	/*!< Cached per spad xtalk rate, 0 when compensation is disabled */
+	uint8_t DmaxLutValid;
+	/*!< Cached DMax interpolation segments are up to date */
+	FixPoint1616_t DmaxLutBreak[VL53L0_DMAX_LUT_SIZE];
+	/*!< Running maximum of the DMax LUT ambient rates (search keys) */
+	FixPoint1616_t DmaxLutSlope[VL53L0_DMAX_LUT_SIZE];
+	/*!< Fix16:8 slope of the DMax LUT segment ending at each point */
+	uint8_t TimingMirrorValid;
+	/*!< Sequence config, VCSEL periods and encoded timeouts below
+	 * match the device registers
+	 */
+	uint8_t PreRangeVcselPeriodPClks;
+	/*!< Mirror of the pre-range VCSEL period (PCLKs) */
+	uint8_t FinalRangeVcselPeriodPClks;
+	/*!< Mirror of the final range VCSEL period (PCLKs) */
+	uint8_t MsrcEncodedTimeout;
+	/*!< Mirror of the encoded MSRC/TCC/DSS timeout register */
+	uint16_t PreRangeEncodedTimeout;
+	/*!< Mirror of the encoded pre-range timeout register */
+	uint16_t FinalRangeEncodedTimeout;
+	/*!< Mirror of the encoded final range timeout register */
 } VL53L0_DevData_t;
 
 
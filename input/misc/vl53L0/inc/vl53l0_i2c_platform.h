@@ -398,5 +398,37 @@ int32_t VL53L0_get_timer_value(int32_t *ptimer_count);
 int VL53L0_I2CWrite(VL53L0_DEV dev, uint8_t *buff, uint8_t len);
 int VL53L0_I2CRead(VL53L0_DEV dev, uint8_t *buff, uint8_t len);
 
+/**
+* @brief Queue the following single byte writes, on a CCI bus
+*
+* Until VL53L0_I2CBatchEnd(), VL53L0_I2CWrite() of one data byte only
+* queues the write. The queue is sent in one CCI transaction when it
+* is full, before any read or other write, on VL53L0_I2CFlush() and on
+* VL53L0_I2CBatchEnd(). A failed batch is returned by the call that
+* sent it, but traced, captured and counted against the queued writes.
+* Nothing is queued on an I2C bus.
+*
+* @param dev : device handle
+*/
+void VL53L0_I2CBatchBegin(VL53L0_DEV dev);
+
+/**
+* @brief Send the queued writes and stop queuing
+*
+* @param dev : device handle
+*
+* @return 0 on success, else the CCI error
+*/
+int VL53L0_I2CBatchEnd(VL53L0_DEV dev);
+
+/**
+* @brief Send the queued writes, so the device sees them before a delay
+*
+* @param dev : device handle
+*
+* @return 0 on success, else the CCI error
+*/
+int VL53L0_I2CFlush(VL53L0_DEV dev);
+
 #endif /* _VL53L0_I2C_PLATFORM_H_ */
 
@@ -99,17 +99,20 @@ void trace_print_module_function(uint32_t module, uint32_t level,
 		printk(KERN_INFO"End %s @%d %d\t"fmt"\n" , \
 		__func__, LOG_GET_TIME(), (int)status, ##__VA_ARGS__)
 */
+/*
+ * PAL entry/exit goes to the stmvl53l0 trace events rather than printk,
+ * these macros sit on every register access path.
+ */
+#include "stmvl53l0_trace.h"
+
 #define _LOG_FUNCTION_START(module, fmt, ...) \
-		pr_err("beg %s start @%d\t" fmt "\n", \
-		__func__, LOG_GET_TIME(), ##__VA_ARGS__)
+		trace_stmvl53l0_pal_enter(__func__)
 
 #define _LOG_FUNCTION_END(module, status, ...)\
-		pr_err("end %s start @%d Status %d\n", \
-		 __func__, LOG_GET_TIME(), (int)status)
+		trace_stmvl53l0_pal_exit(__func__, (int)status)
 
 #define _LOG_FUNCTION_END_FMT(module, status, fmt, ...)\
-		pr_err("End %s @%d %d\t"fmt"\n", \
-		__func__, LOG_GET_TIME(), (int)status, ##__VA_ARGS__)
+		trace_stmvl53l0_pal_exit(__func__, (int)status)
 
 
 #else /* VL53L0_LOG_ENABLE no logging */
@@ -51,6 +51,7 @@
 
 /* Group PAL General Functions */
 
+#ifndef USE_MINIMAL_API
 VL53L0_Error VL53L0_GetVersion(VL53L0_Version_t *pVersion)
 {
 	VL53L0_Error Status = VL53L0_ERROR_NONE;
@@ -100,6 +101,7 @@ VL53L0_Error VL53L0_GetProductRevision(VL53L0_DEV Dev,
 	return Status;
 
 }
+#endif /* USE_MINIMAL_API */
 
 VL53L0_Error VL53L0_GetDeviceInfo(VL53L0_DEV Dev,
 	VL53L0_DeviceInfo_t *pVL53L0_DeviceInfo)
@@ -114,6 +116,7 @@ VL53L0_Error VL53L0_GetDeviceInfo(VL53L0_DEV Dev,
 	return Status;
 }
 
+#ifndef USE_MINIMAL_API
 VL53L0_Error VL53L0_GetDeviceErrorStatus(VL53L0_DEV Dev,
 	VL53L0_DeviceError *pDeviceErrorStatus)
 {
@@ -256,6 +259,7 @@ VL53L0_Error VL53L0_GetPowerMode(VL53L0_DEV Dev, VL53L0_PowerModes *pPowerMode)
 	LOG_FUNCTION_END(Status);
 	return Status;
 }
+#endif /* USE_MINIMAL_API */
 
 VL53L0_Error VL53L0_SetOffsetCalibrationDataMicroMeter(VL53L0_DEV Dev,
 	int32_t OffsetCalibrationDataMicroMeter)
@@ -285,6 +289,7 @@ VL53L0_Error VL53L0_GetOffsetCalibrationDataMicroMeter(VL53L0_DEV Dev,
 	return Status;
 }
 
+#ifndef USE_MINIMAL_API
 VL53L0_Error VL53L0_SetLinearityCorrectiveGain(VL53L0_DEV Dev,
 	int16_t LinearityCorrectiveGain)
 {
@@ -346,6 +351,7 @@ VL53L0_Error VL53L0_GetUpperLimitMilliMeter(VL53L0_DEV Dev,
 	LOG_FUNCTION_END(Status);
 	return Status;
 }
+#endif /* USE_MINIMAL_API */
 
 VL53L0_Error VL53L0_GetTotalSignalRate(VL53L0_DEV Dev,
 	FixPoint1616_t *pTotalSignalRate)
@@ -367,6 +373,7 @@ VL53L0_Error VL53L0_GetTotalSignalRate(VL53L0_DEV Dev,
 /* End Group PAL General Functions */
 
 /* Group PAL Init Functions */
+#ifndef USE_MINIMAL_API
 VL53L0_Error VL53L0_SetDeviceAddress(VL53L0_DEV Dev, uint8_t DeviceAddress)
 {
 	VL53L0_Error Status = VL53L0_ERROR_NONE;
@@ -379,6 +386,7 @@ VL53L0_Error VL53L0_SetDeviceAddress(VL53L0_DEV Dev, uint8_t DeviceAddress)
 	LOG_FUNCTION_END(Status);
 	return Status;
 }
+#endif /* USE_MINIMAL_API */
 
 VL53L0_Error VL53L0_DataInit(VL53L0_DEV Dev)
 {
@@ -405,6 +413,9 @@ VL53L0_Error VL53L0_DataInit(VL53L0_DEV Dev)
 
 	VL53L0_SETDEVICESPECIFICPARAMETER(Dev, ReadDataFromDeviceDone, 0);
 
+	/* Device may have been reset, reload the register mirrors */
+	PALDevDataSet(Dev, TimingMirrorValid, 0);
+
 #ifdef USE_IQC_STATION
 	if (Status == VL53L0_ERROR_NONE)
 		Status = VL53L0_apply_offset_adjustment(Dev);
@@ -420,6 +431,7 @@ VL53L0_Error VL53L0_DataInit(VL53L0_DEV Dev)
 
 	/* Set Default XTalkCompensationRateMegaCps to 0  */
 	VL53L0_SETPARAMETERFIELD(Dev, XTalkCompensationRateMegaCps, 0);
+	PALDevDataSet(Dev, SigmaEstConfigValid, 0);
 
 	/* Get default parameters */
 	Status = VL53L0_GetDeviceParameters(Dev, &CurrentParameters);
@@ -459,6 +471,7 @@ VL53L0_Error VL53L0_DataInit(VL53L0_DEV Dev)
 	CurrentParameters.dmax_lut.dmax_mm[6]      = (FixPoint1616_t)0x01900000;
 
 		PALDevDataSet(Dev, CurrentParameters, CurrentParameters);
+		PALDevDataSet(Dev, DmaxLutValid, 0);
 	}
 
 	/* Sigma estimator variable */
@@ -550,6 +563,7 @@ VL53L0_Error VL53L0_DataInit(VL53L0_DEV Dev)
 	return Status;
 }
 
+#ifndef USE_MINIMAL_API
 VL53L0_Error VL53L0_SetTuningSettingBuffer(VL53L0_DEV Dev,
 	uint8_t *pTuningSettingBuffer, uint8_t UseInternalTuningSettings)
 {
@@ -591,6 +605,7 @@ VL53L0_Error VL53L0_GetTuningSettingBuffer(VL53L0_DEV Dev,
 	LOG_FUNCTION_END(Status);
 	return Status;
 }
+#endif /* USE_MINIMAL_API */
 
 VL53L0_Error VL53L0_StaticInit(VL53L0_DEV Dev)
 {
@@ -678,8 +693,10 @@ VL53L0_Error VL53L0_StaticInit(VL53L0_DEV Dev)
 
 	}
 
-	if (Status == VL53L0_ERROR_NONE)
+	if (Status == VL53L0_ERROR_NONE) {
 		PALDevDataSet(Dev, CurrentParameters, CurrentParameters);
+		PALDevDataSet(Dev, DmaxLutValid, 0);
+	}
 
 
 	/* read the sequence config and save it */
@@ -768,10 +785,14 @@ VL53L0_Error VL53L0_StaticInit(VL53L0_DEV Dev)
 			seqTimeoutMicroSecs);
 	}
 
+	/* Timing and VCSEL config changed, recompute the sigma terms */
+	PALDevDataSet(Dev, SigmaEstConfigValid, 0);
+
 	LOG_FUNCTION_END(Status);
 	return Status;
 }
 
+#ifndef USE_MINIMAL_API
 VL53L0_Error VL53L0_WaitDeviceBooted(VL53L0_DEV Dev)
 {
 	VL53L0_Error Status = VL53L0_ERROR_NOT_IMPLEMENTED;
@@ -823,13 +844,18 @@ VL53L0_Error VL53L0_ResetDevice(VL53L0_DEV Dev)
 	if (Status == VL53L0_ERROR_NONE)
 		PALDevDataSet(Dev, PalState, VL53L0_STATE_POWERDOWN);
 
+	/* Registers are back to their defaults */
+	PALDevDataSet(Dev, TimingMirrorValid, 0);
+
 
 	LOG_FUNCTION_END(Status);
 	return Status;
 }
+#endif /* USE_MINIMAL_API */
 /* End Group PAL Init Functions */
 
 /* Group PAL Parameters Functions */
+#ifndef USE_MINIMAL_API
 VL53L0_Error VL53L0_SetDeviceParameters(VL53L0_DEV Dev,
 	const VL53L0_DeviceParameters_t *pDeviceParameters)
 {
@@ -886,6 +912,7 @@ VL53L0_Error VL53L0_SetDeviceParameters(VL53L0_DEV Dev,
 	LOG_FUNCTION_END(Status);
 	return Status;
 }
+#endif /* USE_MINIMAL_API */
 
 VL53L0_Error VL53L0_GetDeviceParameters(VL53L0_DEV Dev,
 	VL53L0_DeviceParameters_t *pDeviceParameters)
@@ -1125,8 +1152,10 @@ VL53L0_Error VL53L0_SetSequenceStepEnable(VL53L0_DEV Dev,
 
 	LOG_FUNCTION_START("");
 
-	Status = VL53L0_RdByte(Dev, VL53L0_REG_SYSTEM_SEQUENCE_CONFIG,
-		&SequenceConfig);
+	if (PALDevDataGet(Dev, TimingMirrorValid) == 0)
+		Status = VL53L0_load_timing_mirror(Dev);
+
+	SequenceConfig = PALDevDataGet(Dev, SequenceConfig);
 
 	SequenceConfigNew = SequenceConfig;
 
@@ -1245,8 +1274,10 @@ VL53L0_Error VL53L0_GetSequenceStepEnable(VL53L0_DEV Dev,
 
 	LOG_FUNCTION_START("");
 
-	Status = VL53L0_RdByte(Dev, VL53L0_REG_SYSTEM_SEQUENCE_CONFIG,
-		&SequenceConfig);
+	if (PALDevDataGet(Dev, TimingMirrorValid) == 0)
+		Status = VL53L0_load_timing_mirror(Dev);
+
+	SequenceConfig = PALDevDataGet(Dev, SequenceConfig);
 
 	if (Status == VL53L0_ERROR_NONE) {
 		Status = sequence_step_enabled(Dev, SequenceStepId,
@@ -1265,8 +1296,10 @@ VL53L0_Error VL53L0_GetSequenceStepEnables(VL53L0_DEV Dev,
 
 	LOG_FUNCTION_START("");
 
-	Status = VL53L0_RdByte(Dev, VL53L0_REG_SYSTEM_SEQUENCE_CONFIG,
-		&SequenceConfig);
+	if (PALDevDataGet(Dev, TimingMirrorValid) == 0)
+		Status = VL53L0_load_timing_mirror(Dev);
+
+	SequenceConfig = PALDevDataGet(Dev, SequenceConfig);
 
 	if (Status == VL53L0_ERROR_NONE) {
 		Status = sequence_step_enabled(Dev,
@@ -1298,6 +1331,7 @@ VL53L0_Error VL53L0_GetSequenceStepEnables(VL53L0_DEV Dev,
 	return Status;
 }
 
+#ifndef USE_MINIMAL_API
 VL53L0_Error VL53L0_GetNumberOfSequenceSteps(VL53L0_DEV Dev,
 	uint8_t *pNumberOfSequenceSteps)
 {
@@ -1326,6 +1360,7 @@ VL53L0_Error VL53L0_GetSequenceStepsInfo(VL53L0_SequenceStepId SequenceStepId,
 
 	return Status;
 }
+#endif /* USE_MINIMAL_API */
 
 VL53L0_Error VL53L0_SetSequenceStepTimeout(VL53L0_DEV Dev,
 	VL53L0_SequenceStepId SequenceStepId, FixPoint1616_t TimeOutMilliSecs)
@@ -1501,6 +1536,7 @@ VL53L0_Error VL53L0_SetXTalkCompensationEnable(VL53L0_DEV Dev,
 			VL53L0_SETPARAMETERFIELD(Dev, XTalkCompensationEnable,
 				1);
 		}
+		PALDevDataSet(Dev, SigmaEstConfigValid, 0);
 	}
 
 	LOG_FUNCTION_END(Status);
@@ -1538,6 +1574,7 @@ VL53L0_Error VL53L0_SetXTalkCompensationRateMegaCps(VL53L0_DEV Dev,
 	if (Temp8 == 0) { /* disabled write only internal value */
 		VL53L0_SETPARAMETERFIELD(Dev, XTalkCompensationRateMegaCps,
 			XTalkCompensationRateMegaCps);
+		PALDevDataSet(Dev, SigmaEstConfigValid, 0);
 	} else {
 		/* the following register has a format 3.13 */
 		if (LinearityCorrectiveGain == 1000) {
@@ -1554,6 +1591,7 @@ VL53L0_Error VL53L0_SetXTalkCompensationRateMegaCps(VL53L0_DEV Dev,
 			VL53L0_SETPARAMETERFIELD(Dev,
 				XTalkCompensationRateMegaCps,
 				XTalkCompensationRateMegaCps);
+			PALDevDataSet(Dev, SigmaEstConfigValid, 0);
 		}
 	}
 
@@ -1588,6 +1626,7 @@ VL53L0_Error VL53L0_GetXTalkCompensationRateMegaCps(VL53L0_DEV Dev,
 			VL53L0_SETPARAMETERFIELD(Dev, XTalkCompensationEnable,
 				1);
 		}
+		PALDevDataSet(Dev, SigmaEstConfigValid, 0);
 	}
 
 	LOG_FUNCTION_END(Status);
@@ -1624,6 +1663,7 @@ VL53L0_Error VL53L0_GetRefCalibration(VL53L0_DEV Dev, uint8_t *pVhvSettings,
  * CHECK LIMIT FUNCTIONS
  */
 
+#ifndef USE_MINIMAL_API
 VL53L0_Error VL53L0_GetNumberOfLimitCheck(uint16_t *pNumberOfLimitCheck)
 {
 	VL53L0_Error Status = VL53L0_ERROR_NONE;
@@ -1649,6 +1689,7 @@ VL53L0_Error VL53L0_GetLimitCheckInfo(VL53L0_DEV Dev, uint16_t LimitCheckId,
 	LOG_FUNCTION_END(Status);
 	return Status;
 }
+#endif /* USE_MINIMAL_API */
 
 VL53L0_Error VL53L0_GetLimitCheckStatus(VL53L0_DEV Dev, uint16_t LimitCheckId,
 	uint8_t *pLimitCheckStatus)
@@ -2427,6 +2468,7 @@ VL53L0_Error VL53L0_GetMeasurementDataReady(VL53L0_DEV Dev,
 	return Status;
 }
 
+#ifndef USE_MINIMAL_API
 VL53L0_Error VL53L0_WaitDeviceReadyForNewMeasurement(VL53L0_DEV Dev,
 	uint32_t MaxLoop)
 {
@@ -2439,6 +2481,7 @@ VL53L0_Error VL53L0_WaitDeviceReadyForNewMeasurement(VL53L0_DEV Dev,
 	LOG_FUNCTION_END(Status);
 	return Status;
 }
+#endif /* USE_MINIMAL_API */
 
 
 VL53L0_Error VL53L0_GetRangingMeasurementData(VL53L0_DEV Dev,
@@ -2618,6 +2661,7 @@ VL53L0_Error VL53L0_GetMeasurementRefSignal(VL53L0_DEV Dev,
 	return Status;
 }
 
+#ifndef USE_MINIMAL_API
 VL53L0_Error VL53L0_GetHistogramMeasurementData(VL53L0_DEV Dev,
 	VL53L0_HistogramMeasurementData_t *pHistogramMeasurementData)
 {
@@ -2628,6 +2672,7 @@ VL53L0_Error VL53L0_GetHistogramMeasurementData(VL53L0_DEV Dev,
 	LOG_FUNCTION_END(Status);
 	return Status;
 }
+#endif /* USE_MINIMAL_API */
 
 VL53L0_Error VL53L0_PerformSingleRangingMeasurement(VL53L0_DEV Dev,
 	VL53L0_RangingMeasurementData_t *pRangingMeasurementData)
@@ -2658,6 +2703,7 @@ VL53L0_Error VL53L0_PerformSingleRangingMeasurement(VL53L0_DEV Dev,
 	return Status;
 }
 
+#ifndef USE_MINIMAL_API
 VL53L0_Error VL53L0_SetNumberOfROIZones(VL53L0_DEV Dev,
 	uint8_t NumberOfROIZones)
 {
@@ -2698,6 +2744,7 @@ VL53L0_Error VL53L0_GetMaxNumberOfROIZones(VL53L0_DEV Dev,
 	LOG_FUNCTION_END(Status);
 	return Status;
 }
+#endif /* USE_MINIMAL_API */
 
 /* End Group PAL Measurement Functions */
 
@@ -3001,6 +3048,7 @@ VL53L0_Error VL53L0_GetInterruptMaskStatus(VL53L0_DEV Dev,
 	return Status;
 }
 
+#ifndef USE_MINIMAL_API
 VL53L0_Error VL53L0_EnableInterruptMask(VL53L0_DEV Dev, uint32_t InterruptMask)
 {
 	VL53L0_Error Status = VL53L0_ERROR_NOT_IMPLEMENTED;
@@ -3012,11 +3060,13 @@ VL53L0_Error VL53L0_EnableInterruptMask(VL53L0_DEV Dev, uint32_t InterruptMask)
 	LOG_FUNCTION_END(Status);
 	return Status;
 }
+#endif /* USE_MINIMAL_API */
 
 /* End Group PAL Interrupt Functions */
 
 /* Group SPAD functions */
 
+#ifndef USE_MINIMAL_API
 VL53L0_Error VL53L0_SetSpadAmbientDamperThreshold(VL53L0_DEV Dev,
 	uint16_t SpadAmbientDamperThreshold)
 {
@@ -3046,6 +3096,7 @@ VL53L0_Error VL53L0_GetSpadAmbientDamperThreshold(VL53L0_DEV Dev,
 	LOG_FUNCTION_END(Status);
 	return Status;
 }
+#endif /* USE_MINIMAL_API */
 
 VL53L0_Error VL53L0_SetSpadAmbientDamperFactor(VL53L0_DEV Dev,
 	uint16_t SpadAmbientDamperFactor)
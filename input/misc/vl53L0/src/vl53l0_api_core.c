@@ -579,6 +579,69 @@ uint32_t VL53L0_calc_timeout_us(VL53L0_DEV Dev,
 }
 
 
+VL53L0_Error VL53L0_load_timing_mirror(VL53L0_DEV Dev)
+{
+	VL53L0_Error Status = VL53L0_ERROR_NONE;
+	uint8_t SequenceConfig = 0;
+	uint8_t PreRangeVcselPeriodReg = 0;
+	uint8_t FinalRangeVcselPeriodReg = 0;
+	uint8_t MsrcEncodedTimeOut = 0;
+	uint16_t PreRangeEncodedTimeOut = 0;
+	uint16_t FinalRangeEncodedTimeOut = 0;
+
+	LOG_FUNCTION_START("");
+
+	/*
+	 * Read the registers the timing budget depends on once. They are
+	 * then kept up to date by the PAL functions writing them, so that
+	 * reading the timing back does not touch the device any more.
+	 */
+	Status = VL53L0_RdByte(Dev, VL53L0_REG_SYSTEM_SEQUENCE_CONFIG,
+		&SequenceConfig);
+
+	if (Status == VL53L0_ERROR_NONE)
+		Status = VL53L0_RdByte(Dev,
+			VL53L0_REG_PRE_RANGE_CONFIG_VCSEL_PERIOD,
+			&PreRangeVcselPeriodReg);
+
+	if (Status == VL53L0_ERROR_NONE)
+		Status = VL53L0_RdByte(Dev,
+			VL53L0_REG_FINAL_RANGE_CONFIG_VCSEL_PERIOD,
+			&FinalRangeVcselPeriodReg);
+
+	if (Status == VL53L0_ERROR_NONE)
+		Status = VL53L0_RdByte(Dev,
+			VL53L0_REG_MSRC_CONFIG_TIMEOUT_MACROP,
+			&MsrcEncodedTimeOut);
+
+	if (Status == VL53L0_ERROR_NONE)
+		Status = VL53L0_RdWord(Dev,
+			VL53L0_REG_PRE_RANGE_CONFIG_TIMEOUT_MACROP_HI,
+			&PreRangeEncodedTimeOut);
+
+	if (Status == VL53L0_ERROR_NONE)
+		Status = VL53L0_RdWord(Dev,
+			VL53L0_REG_FINAL_RANGE_CONFIG_TIMEOUT_MACROP_HI,
+			&FinalRangeEncodedTimeOut);
+
+	if (Status == VL53L0_ERROR_NONE) {
+		PALDevDataSet(Dev, SequenceConfig, SequenceConfig);
+		PALDevDataSet(Dev, PreRangeVcselPeriodPClks,
+			VL53L0_decode_vcsel_period(PreRangeVcselPeriodReg));
+		PALDevDataSet(Dev, FinalRangeVcselPeriodPClks,
+			VL53L0_decode_vcsel_period(FinalRangeVcselPeriodReg));
+		PALDevDataSet(Dev, MsrcEncodedTimeout, MsrcEncodedTimeOut);
+		PALDevDataSet(Dev, PreRangeEncodedTimeout,
+			PreRangeEncodedTimeOut);
+		PALDevDataSet(Dev, FinalRangeEncodedTimeout,
+			FinalRangeEncodedTimeOut);
+		PALDevDataSet(Dev, TimingMirrorValid, 1);
+	}
+
+	LOG_FUNCTION_END(Status);
+	return Status;
+}
+
 VL53L0_Error get_sequence_step_timeout(VL53L0_DEV Dev,
 				VL53L0_SequenceStepId SequenceStepId,
 				uint32_t *pTimeOutMicroSecs)
@@ -594,6 +657,13 @@ VL53L0_Error get_sequence_step_timeout(VL53L0_DEV Dev,
 	uint16_t FinalRangeEncodedTimeOut;
 	VL53L0_SchedulerSequenceSteps_t SchedulerSequenceSteps;
 
+	/* Timeouts are decoded from the register mirrors, no I2C access */
+	if (PALDevDataGet(Dev, TimingMirrorValid) == 0)
+		Status = VL53L0_load_timing_mirror(Dev);
+
+	if (Status != VL53L0_ERROR_NONE)
+		return Status;
+
 	if ((SequenceStepId == VL53L0_SEQUENCESTEP_TCC)	 ||
 		(SequenceStepId == VL53L0_SEQUENCESTEP_DSS)	 ||
 		(SequenceStepId == VL53L0_SEQUENCESTEP_MSRC)) {
@@ -602,9 +672,8 @@ VL53L0_Error get_sequence_step_timeout(VL53L0_DEV Dev,
 					VL53L0_VCSEL_PERIOD_PRE_RANGE,
 					&CurrentVCSELPulsePeriodPClk);
 		if (Status == VL53L0_ERROR_NONE) {
-			Status = VL53L0_RdByte(Dev,
-					VL53L0_REG_MSRC_CONFIG_TIMEOUT_MACROP,
-					&EncodedTimeOutByte);
+			EncodedTimeOutByte =
+				PALDevDataGet(Dev, MsrcEncodedTimeout);
 		}
 		MsrcTimeOutMClks = VL53L0_decode_timeout(EncodedTimeOutByte);
 
@@ -626,9 +695,8 @@ VL53L0_Error get_sequence_step_timeout(VL53L0_DEV Dev,
 					&CurrentVCSELPulsePeriodPClk);
 
 			if (Status == VL53L0_ERROR_NONE) {
-				Status = VL53L0_RdWord(Dev,
-				VL53L0_REG_PRE_RANGE_CONFIG_TIMEOUT_MACROP_HI,
-				&PreRangeEncodedTimeOut);
+				PreRangeEncodedTimeOut = PALDevDataGet(Dev,
+					PreRangeEncodedTimeout);
 			}
 
 			PreRangeTimeOutMClks = VL53L0_decode_timeout(
@@ -653,9 +721,8 @@ VL53L0_Error get_sequence_step_timeout(VL53L0_DEV Dev,
 			 * (MCLKS)
 			 */
 			if (Status == VL53L0_ERROR_NONE) {
-				Status = VL53L0_RdWord(Dev,
-				VL53L0_REG_PRE_RANGE_CONFIG_TIMEOUT_MACROP_HI,
-				&PreRangeEncodedTimeOut);
+				PreRangeEncodedTimeOut = PALDevDataGet(Dev,
+					PreRangeEncodedTimeout);
 				PreRangeTimeOutMClks = VL53L0_decode_timeout(
 						PreRangeEncodedTimeOut);
 			}
@@ -670,9 +737,8 @@ VL53L0_Error get_sequence_step_timeout(VL53L0_DEV Dev,
 
 		/* Retrieve FINAL-RANGE Timeout in Macro periods (MCLKS) */
 		if (Status == VL53L0_ERROR_NONE) {
-			Status = VL53L0_RdWord(Dev,
-				VL53L0_REG_FINAL_RANGE_CONFIG_TIMEOUT_MACROP_HI,
-				&FinalRangeEncodedTimeOut);
+			FinalRangeEncodedTimeOut = PALDevDataGet(Dev,
+				FinalRangeEncodedTimeout);
 			FinalRangeTimeOutMClks = VL53L0_decode_timeout(
 					FinalRangeEncodedTimeOut);
 		}
@@ -732,6 +798,10 @@ VL53L0_Error set_sequence_step_timeout(VL53L0_DEV Dev,
 				VL53L0_REG_MSRC_CONFIG_TIMEOUT_MACROP,
 				MsrcEncodedTimeOut);
 		}
+
+		if (Status == VL53L0_ERROR_NONE)
+			PALDevDataSet(Dev, MsrcEncodedTimeout,
+				MsrcEncodedTimeOut);
 	} else {
 
 		if (SequenceStepId == VL53L0_SEQUENCESTEP_PRE_RANGE) {
@@ -763,6 +833,9 @@ VL53L0_Error set_sequence_step_timeout(VL53L0_DEV Dev,
 					Dev,
 					PreRangeTimeoutMicroSecs,
 					TimeOutMicroSecs);
+				PALDevDataSet(Dev, PreRangeEncodedTimeout,
+					PreRangeEncodedTimeOut);
+				PALDevDataSet(Dev, SigmaEstConfigValid, 0);
 			}
 		} else if (SequenceStepId == VL53L0_SEQUENCESTEP_FINAL_RANGE) {
 
@@ -786,8 +859,8 @@ VL53L0_Error set_sequence_step_timeout(VL53L0_DEV Dev,
 				 * (MCLKS)
 				 */
 				if (Status == VL53L0_ERROR_NONE) {
-					Status = VL53L0_RdWord(Dev, 0x51,
-						&PreRangeEncodedTimeOut);
+					PreRangeEncodedTimeOut = PALDevDataGet(
+						Dev, PreRangeEncodedTimeout);
 					PreRangeTimeOutMClks =
 						VL53L0_decode_timeout(
 							PreRangeEncodedTimeOut);
@@ -825,6 +898,11 @@ VL53L0_Error set_sequence_step_timeout(VL53L0_DEV Dev,
 						Dev,
 						FinalRangeTimeoutMicroSecs,
 						TimeOutMicroSecs);
+					PALDevDataSet(Dev,
+						FinalRangeEncodedTimeout,
+						FinalRangeEncodedTimeOut);
+					PALDevDataSet(Dev, SigmaEstConfigValid,
+						0);
 				}
 			}
 		} else
@@ -1020,6 +1098,9 @@ VL53L0_Error VL53L0_set_vcsel_pulse_period(VL53L0_DEV Dev,
 				VL53L0_REG_PRE_RANGE_CONFIG_VCSEL_PERIOD,
 					vcsel_period_reg);
 
+			if (Status == VL53L0_ERROR_NONE)
+				PALDevDataSet(Dev, PreRangeVcselPeriodPClks,
+					VCSELPulsePeriodPCLK);
 
 			if (Status == VL53L0_ERROR_NONE)
 				Status = set_sequence_step_timeout(Dev,
@@ -1036,6 +1117,7 @@ VL53L0_Error VL53L0_set_vcsel_pulse_period(VL53L0_DEV Dev,
 				Dev,
 				PreRangeVcselPulsePeriod,
 				VCSELPulsePeriodPCLK);
+			PALDevDataSet(Dev, SigmaEstConfigValid, 0);
 			break;
 		case VL53L0_VCSEL_PERIOD_FINAL_RANGE:
 			Status = get_sequence_step_timeout(Dev,
@@ -1047,6 +1129,9 @@ VL53L0_Error VL53L0_set_vcsel_pulse_period(VL53L0_DEV Dev,
 				VL53L0_REG_FINAL_RANGE_CONFIG_VCSEL_PERIOD,
 					vcsel_period_reg);
 
+			if (Status == VL53L0_ERROR_NONE)
+				PALDevDataSet(Dev, FinalRangeVcselPeriodPClks,
+					VCSELPulsePeriodPCLK);
 
 			if (Status == VL53L0_ERROR_NONE)
 				Status = set_sequence_step_timeout(Dev,
@@ -1057,6 +1142,7 @@ VL53L0_Error VL53L0_set_vcsel_pulse_period(VL53L0_DEV Dev,
 				Dev,
 				FinalRangeVcselPulsePeriod,
 				VCSELPulsePeriodPCLK);
+			PALDevDataSet(Dev, SigmaEstConfigValid, 0);
 			break;
 		default:
 			Status = VL53L0_ERROR_INVALID_PARAMS;
@@ -1088,27 +1174,26 @@ VL53L0_Error VL53L0_get_vcsel_pulse_period(VL53L0_DEV Dev,
 	VL53L0_VcselPeriod VcselPeriodType, uint8_t *pVCSELPulsePeriodPCLK)
 {
 	VL53L0_Error Status = VL53L0_ERROR_NONE;
-	uint8_t vcsel_period_reg;
+
+	if (PALDevDataGet(Dev, TimingMirrorValid) == 0)
+		Status = VL53L0_load_timing_mirror(Dev);
+
+	if (Status != VL53L0_ERROR_NONE)
+		return Status;
 
 	switch (VcselPeriodType) {
 	case VL53L0_VCSEL_PERIOD_PRE_RANGE:
-		Status = VL53L0_RdByte(Dev,
-			VL53L0_REG_PRE_RANGE_CONFIG_VCSEL_PERIOD,
-			&vcsel_period_reg);
+		*pVCSELPulsePeriodPCLK =
+			PALDevDataGet(Dev, PreRangeVcselPeriodPClks);
 	break;
 	case VL53L0_VCSEL_PERIOD_FINAL_RANGE:
-		Status = VL53L0_RdByte(Dev,
-			VL53L0_REG_FINAL_RANGE_CONFIG_VCSEL_PERIOD,
-			&vcsel_period_reg);
+		*pVCSELPulsePeriodPCLK =
+			PALDevDataGet(Dev, FinalRangeVcselPeriodPClks);
 	break;
 	default:
 		Status = VL53L0_ERROR_INVALID_PARAMS;
 	}
 
-	if (Status == VL53L0_ERROR_NONE)
-		*pVCSELPulsePeriodPCLK =
-			VL53L0_decode_vcsel_period(vcsel_period_reg);
-
 	return Status;
 }
 
@@ -1431,6 +1516,9 @@ VL53L0_Error VL53L0_load_tuning_settings(VL53L0_DEV Dev,
 		}
 	}
 
+	/* The tuning may have changed the timing registers */
+	PALDevDataSet(Dev, TimingMirrorValid, 0);
+
 	LOG_FUNCTION_END(Status);
 	return Status;
 }
@@ -1492,83 +1580,89 @@ VL53L0_Error VL53L0_get_total_signal_rate(VL53L0_DEV Dev,
 	return Status;
 }
 
-VL53L0_Error get_dmax_lut_points(VL53L0_DMaxLUT_t data, uint32_t lut_size,
-	FixPoint1616_t input, int32_t *index0,	int32_t *index1){
+VL53L0_Error VL53L0_calc_dmax_lut_segments(VL53L0_DEV Dev)
+{
 	VL53L0_Error Status = VL53L0_ERROR_NONE;
-	FixPoint1616_t index0_tmp = 0;
-	FixPoint1616_t index1_tmp = 0;
-	int index = 0;
+	VL53L0_DMaxLUT_t *pLut = &Dev->Data.CurrentParameters.dmax_lut;
+	FixPoint1616_t breakPoint;
+	FixPoint1616_t ambDelta;
+	int i;
 
-	for (index = 0; index < lut_size; index++) {
-		if (input <= data.ambRate_mcps[index]) {
-			index1_tmp = index;
-			break;
-		}
-	}
+	LOG_FUNCTION_START("");
 
-	if (index == lut_size) {
-		/* input is higher than last x point */
-		index0_tmp = index1_tmp = lut_size - 1;
-	} else if (index1_tmp == 0) {
-		/* input is lower than first x point */
-		index0_tmp = 0;
-	} else{
-		/* input is in between 2 points */
-		index0_tmp = index1_tmp - 1;
+	/*
+	 * DmaxLutBreak[i] is the running maximum of the ambient rates up to
+	 * point i. It is sorted even if the table is not, and the first
+	 * break point at or above the ambient rate is the same point the
+	 * original linear scan stopped at, so the table can be searched
+	 * with a binary search.
+	 *
+	 * DmaxLutSlope[i] is the Fix16:8 slope of the segment ending at
+	 * point i.
+	 */
+	breakPoint = pLut->ambRate_mcps[0];
+	PALDevDataSet(Dev, DmaxLutBreak[0], breakPoint);
+	PALDevDataSet(Dev, DmaxLutSlope[0], 0);
+
+	for (i = 1; i < VL53L0_DMAX_LUT_SIZE; i++) {
+		if (pLut->ambRate_mcps[i] > breakPoint)
+			breakPoint = pLut->ambRate_mcps[i];
+		PALDevDataSet(Dev, DmaxLutBreak[i], breakPoint);
+
+		/* Fix16:16/Fix16:8 => Fix16:8 */
+		ambDelta = (pLut->ambRate_mcps[i] -
+			pLut->ambRate_mcps[i - 1]) >> 8;
+		if (ambDelta != 0)
+			PALDevDataSet(Dev, DmaxLutSlope[i],
+				(pLut->dmax_mm[i - 1] - pLut->dmax_mm[i]) /
+				ambDelta);
+		else
+			PALDevDataSet(Dev, DmaxLutSlope[i], 0);
 	}
 
-	*index0 = index0_tmp;
-	*index1 = index1_tmp;
+	PALDevDataSet(Dev, DmaxLutValid, 1);
 
+	LOG_FUNCTION_END(Status);
 	return Status;
 }
 
 VL53L0_Error VL53L0_calc_dmax(
 	VL53L0_DEV Dev, FixPoint1616_t ambRateMeas, uint32_t *pdmax_mm){
 	VL53L0_Error Status = VL53L0_ERROR_NONE;
-	VL53L0_DeviceParameters_t CurrentParameters;
-	int32_t index0 = 0;
-	int32_t index1 = 0;
-	FixPoint1616_t amb0, amb1, dmax0, dmax1;
+	VL53L0_DMaxLUT_t *pLut = &Dev->Data.CurrentParameters.dmax_lut;
+	FixPoint1616_t *pBreak;
+	uint32_t base;
+	uint32_t len;
+	uint32_t half;
 	FixPoint1616_t dmax_mm;
-	FixPoint1616_t linearSlope;
 
 	LOG_FUNCTION_START("");
 
-	Status = VL53L0_GetDeviceParameters(Dev, &CurrentParameters);
+	if (PALDevDataGet(Dev, DmaxLutValid) == 0)
+		Status = VL53L0_calc_dmax_lut_segments(Dev);
 
-	if (ambRateMeas <= CurrentParameters.dmax_lut.ambRate_mcps[0]) {
-		dmax_mm = CurrentParameters.dmax_lut.dmax_mm[0];
+	if (ambRateMeas <= pLut->ambRate_mcps[0]) {
+		dmax_mm = pLut->dmax_mm[0];
 	} else if (ambRateMeas >=
-		   CurrentParameters.dmax_lut.
-		   ambRate_mcps[VL53L0_DMAX_LUT_SIZE - 1]) {
-		dmax_mm =
-		    CurrentParameters.dmax_lut.dmax_mm[VL53L0_DMAX_LUT_SIZE -
-						       1];
-	} else{
-		get_dmax_lut_points(CurrentParameters.dmax_lut,
-			VL53L0_DMAX_LUT_SIZE, ambRateMeas, &index0, &index1);
-
-		if (index0 == index1) {
-			dmax_mm = CurrentParameters.dmax_lut.dmax_mm[index0];
-		} else {
-			amb0 = CurrentParameters.dmax_lut.ambRate_mcps[index0];
-			amb1 = CurrentParameters.dmax_lut.ambRate_mcps[index1];
-			dmax0 = CurrentParameters.dmax_lut.dmax_mm[index0];
-			dmax1 = CurrentParameters.dmax_lut.dmax_mm[index1];
-			if ((amb1 - amb0) != 0) {
-				/* Fix16:16/Fix16:8 => Fix16:8 */
-				linearSlope = (dmax0-dmax1)/((amb1-amb0) >> 8);
-
-				/* Fix16:8 * Fix16:8 => Fix16:16 */
-				dmax_mm =
-				    (((amb1 -
-				       ambRateMeas) >> 8) * linearSlope) +
-				    dmax1;
-			} else{
-				dmax_mm = dmax0;
-			}
+		   pLut->ambRate_mcps[VL53L0_DMAX_LUT_SIZE - 1]) {
+		dmax_mm = pLut->dmax_mm[VL53L0_DMAX_LUT_SIZE - 1];
+	} else {
+		/* Lower bound of ambRateMeas in break points 1..SIZE-1 */
+		pBreak = Dev->Data.DmaxLutBreak;
+		base = 1;
+		len = VL53L0_DMAX_LUT_SIZE - 1;
+		while (len > 1) {
+			half = len / 2;
+			base += (pBreak[base + half] < ambRateMeas) ?
+				half : 0;
+			len -= half;
 		}
+		base += (pBreak[base] < ambRateMeas);
+
+		/* Fix16:8 * Fix16:8 => Fix16:16 */
+		dmax_mm = (((pLut->ambRate_mcps[base] - ambRateMeas) >> 8) *
+			PALDevDataGet(Dev, DmaxLutSlope[base])) +
+			pLut->dmax_mm[base];
 	}
 	*pdmax_mm = (uint32_t)(dmax_mm >> 16);
 
@@ -1577,6 +1671,106 @@ VL53L0_Error VL53L0_calc_dmax(
 	return Status;
 }
 
+VL53L0_Error VL53L0_calc_sigma_estimate_config(VL53L0_DEV Dev)
+{
+	const FixPoint1616_t cDfltFinalRangeIntegrationTimeMilliSecs =
+						0x00190000; /* 25ms */
+	const uint32_t cPllPeriod_ps			= 1655;
+
+	VL53L0_Error Status = VL53L0_ERROR_NONE;
+	uint8_t xtalkCompEnable;
+	FixPoint1616_t xtalkPerSpadMegaCps = 0;
+	uint32_t finalRangeTimeoutMicroSecs;
+	uint32_t preRangeTimeoutMicroSecs;
+	uint32_t finalRangeIntegrationTimeMilliSecs;
+	uint32_t vcselWidth;
+	uint32_t finalRangeMacroPCLKS;
+	uint32_t preRangeMacroPCLKS;
+	uint32_t peakVcselDuration_us;
+	uint8_t finalRangeVcselPCLKS;
+	uint8_t preRangeVcselPCLKS;
+	FixPoint1616_t sigmaEstRef;
+
+	/*
+	 * Everything computed here only depends on the timing budget, the
+	 * VCSEL periods and the xtalk compensation settings. It is cached in
+	 * the device data and invalidated whenever one of them is written.
+	 */
+
+	LOG_FUNCTION_START("");
+
+	Status = VL53L0_GetXTalkCompensationEnable(Dev, &xtalkCompEnable);
+	if (Status != VL53L0_ERROR_NONE) {
+		LOG_FUNCTION_END(Status);
+		return Status;
+	}
+
+	if (xtalkCompEnable)
+		VL53L0_GETPARAMETERFIELD(Dev, XTalkCompensationRateMegaCps,
+			xtalkPerSpadMegaCps);
+
+	/* Calculate final range macro periods */
+	finalRangeTimeoutMicroSecs = VL53L0_GETDEVICESPECIFICPARAMETER(
+		Dev, FinalRangeTimeoutMicroSecs);
+
+	finalRangeVcselPCLKS = VL53L0_GETDEVICESPECIFICPARAMETER(
+		Dev, FinalRangeVcselPulsePeriod);
+
+	finalRangeMacroPCLKS = VL53L0_calc_timeout_mclks(
+		Dev, finalRangeTimeoutMicroSecs, finalRangeVcselPCLKS);
+
+	/* Calculate pre-range macro periods */
+	preRangeTimeoutMicroSecs = VL53L0_GETDEVICESPECIFICPARAMETER(
+		Dev, PreRangeTimeoutMicroSecs);
+
+	preRangeVcselPCLKS = VL53L0_GETDEVICESPECIFICPARAMETER(
+		Dev, PreRangeVcselPulsePeriod);
+
+	preRangeMacroPCLKS = VL53L0_calc_timeout_mclks(
+		Dev, preRangeTimeoutMicroSecs, preRangeVcselPCLKS);
+
+	vcselWidth = 3;
+	if (finalRangeVcselPCLKS == 8)
+		vcselWidth = 2;
+
+
+	peakVcselDuration_us = vcselWidth * 2048 *
+		(preRangeMacroPCLKS + finalRangeMacroPCLKS);
+	peakVcselDuration_us = (peakVcselDuration_us + 500)/1000;
+	peakVcselDuration_us *= cPllPeriod_ps;
+	peakVcselDuration_us = (peakVcselDuration_us + 500)/1000;
+
+	finalRangeIntegrationTimeMilliSecs =
+	    (finalRangeTimeoutMicroSecs + preRangeTimeoutMicroSecs +
+	     500) / 1000;
+
+	/* Timeouts not known yet, avoid a division by zero */
+	if (finalRangeIntegrationTimeMilliSecs == 0)
+		finalRangeIntegrationTimeMilliSecs = 1;
+
+	/* sigmaEstRef = 1mm * 25ms/final range integration time
+	 * (inc pre-range)
+	 * sqrt(FixPoint1616/int) = FixPoint2408)
+	 */
+	sigmaEstRef =
+		VL53L0_isqrt((cDfltFinalRangeIntegrationTimeMilliSecs +
+			finalRangeIntegrationTimeMilliSecs/2)/
+			finalRangeIntegrationTimeMilliSecs);
+
+	/* FixPoint2408 << 8 = FixPoint1616 */
+	sigmaEstRef <<= 8;
+	sigmaEstRef = (sigmaEstRef + 500)/1000;
+
+	PALDevDataSet(Dev, SigmaEstXTalkPerSpadMegaCps, xtalkPerSpadMegaCps);
+	PALDevDataSet(Dev, SigmaEstPeakVcselDuration_us, peakVcselDuration_us);
+	/* FixPoint1616 * FixPoint1616 = FixPoint3232 */
+	PALDevDataSet(Dev, SigmaEstRefSqr, sigmaEstRef * sigmaEstRef);
+	PALDevDataSet(Dev, SigmaEstConfigValid, 1);
+
+	LOG_FUNCTION_END(Status);
+	return Status;
+}
+
 VL53L0_Error VL53L0_calc_sigma_estimate(VL53L0_DEV Dev,
 	VL53L0_RangingMeasurementData_t *pRangingMeasurementData,
 	FixPoint1616_t *pSigmaEstimate)
@@ -1585,8 +1779,6 @@ VL53L0_Error VL53L0_calc_sigma_estimate(VL53L0_DEV Dev,
 	const uint32_t cPulseEffectiveWidth_centi_ns   = 800;
 	/* Expressed in 100ths of a ns, i.e. centi-ns */
 	const uint32_t cAmbientEffectiveWidth_centi_ns = 600;
-	const FixPoint1616_t cDfltFinalRangeIntegrationTimeMilliSecs =
-						0x00190000; /* 25ms */
 	const uint32_t cVcselPulseWidth_ps	= 4700; /* pico secs */
 	const FixPoint1616_t cSigmaEstMax	= 0x028F87AE;
 	const FixPoint1616_t cSigmaEstRtnMax	= 0xF000;
@@ -1596,12 +1788,8 @@ VL53L0_Error VL53L0_calc_sigma_estimate(VL53L0_DEV Dev,
 	const FixPoint1616_t cTOF_per_mm_ps		= 0x0006999A;
 	const uint32_t c16BitRoundingParam		= 0x00008000;
 	const FixPoint1616_t cMaxXTalk_kcps		= 0x00320000;
-	const uint32_t cPllPeriod_ps			= 1655;
 
 	uint32_t vcselTotalEventsRtn;
-	uint32_t finalRangeTimeoutMicroSecs;
-	uint32_t preRangeTimeoutMicroSecs;
-	uint32_t finalRangeIntegrationTimeMilliSecs;
 	FixPoint1616_t sigmaEstimateP1;
 	FixPoint1616_t sigmaEstimateP2;
 	FixPoint1616_t sigmaEstimateP3;
@@ -1623,13 +1811,7 @@ VL53L0_Error VL53L0_calc_sigma_estimate(VL53L0_DEV Dev,
 	FixPoint1616_t sqrtResult_centi_ns;
 	FixPoint1616_t sqrtResult;
 	FixPoint1616_t totalSignalRate_mcps;
-	FixPoint1616_t sigmaEstRef;
-	uint32_t vcselWidth;
-	uint32_t finalRangeMacroPCLKS;
-	uint32_t preRangeMacroPCLKS;
 	uint32_t peakVcselDuration_us;
-	uint8_t finalRangeVcselPCLKS;
-	uint8_t preRangeVcselPCLKS;
 	/*! \addtogroup calc_sigma_estimate
 	 * @{
 	 *
@@ -1638,8 +1820,14 @@ VL53L0_Error VL53L0_calc_sigma_estimate(VL53L0_DEV Dev,
 
 	LOG_FUNCTION_START("");
 
-	VL53L0_GETPARAMETERFIELD(Dev, XTalkCompensationRateMegaCps,
-			xTalkCompRate_mcps);
+	/* Configuration dependent terms, see calc_sigma_estimate_config */
+	if (PALDevDataGet(Dev, SigmaEstConfigValid) == 0)
+		Status = VL53L0_calc_sigma_estimate_config(Dev);
+
+	if (Status != VL53L0_ERROR_NONE) {
+		LOG_FUNCTION_END(Status);
+		return Status;
+	}
 
 	/*
 	 * We work in kcps rather than mcps as this helps keep within the
@@ -1649,10 +1837,14 @@ VL53L0_Error VL53L0_calc_sigma_estimate(VL53L0_DEV Dev,
 	ambientRate_kcps =
 		(pRangingMeasurementData->AmbientRateRtnMegaCps * 1000) >> 16;
 
-	Status = VL53L0_get_total_signal_rate(
-		Dev, pRangingMeasurementData, &totalSignalRate_mcps);
-	Status = VL53L0_get_total_xtalk_rate(
-		Dev, pRangingMeasurementData, &xTalkCompRate_mcps);
+	/* Same as VL53L0_get_total_xtalk_rate() with the cached rate:
+	 * FixPoint1616 * FixPoint 8:8 = FixPoint0824 >> 8 = FixPoint1616
+	 */
+	xTalkCompRate_mcps = (pRangingMeasurementData->EffectiveSpadRtnCount *
+		PALDevDataGet(Dev, SigmaEstXTalkPerSpadMegaCps) + 0x80) >> 8;
+
+	totalSignalRate_mcps = pRangingMeasurementData->SignalRateRtnMegaCps +
+		xTalkCompRate_mcps;
 
 
 	/* Signal rate measurement provided by device is the
@@ -1666,57 +1858,21 @@ VL53L0_Error VL53L0_calc_sigma_estimate(VL53L0_DEV Dev,
 	if (xTalkCompRate_kcps > cMaxXTalk_kcps)
 		xTalkCompRate_kcps = cMaxXTalk_kcps;
 
-	if (Status == VL53L0_ERROR_NONE) {
+	peakVcselDuration_us = PALDevDataGet(Dev,
+		SigmaEstPeakVcselDuration_us);
 
-		/* Calculate final range macro periods */
-		finalRangeTimeoutMicroSecs = VL53L0_GETDEVICESPECIFICPARAMETER(
-			Dev, FinalRangeTimeoutMicroSecs);
+	/* Fix1616 >> 8 = Fix2408 */
+	totalSignalRate_mcps = (totalSignalRate_mcps + 0x80) >> 8;
 
-		finalRangeVcselPCLKS = VL53L0_GETDEVICESPECIFICPARAMETER(
-			Dev, FinalRangeVcselPulsePeriod);
+	/* Fix2408 * uint32 = Fix2408 */
+	vcselTotalEventsRtn = totalSignalRate_mcps *
+		peakVcselDuration_us;
 
-		finalRangeMacroPCLKS = VL53L0_calc_timeout_mclks(
-			Dev, finalRangeTimeoutMicroSecs, finalRangeVcselPCLKS);
+	/* Fix2408 >> 8 = uint32 */
+	vcselTotalEventsRtn = (vcselTotalEventsRtn + 0x80) >> 8;
 
-		/* Calculate pre-range macro periods */
-		preRangeTimeoutMicroSecs = VL53L0_GETDEVICESPECIFICPARAMETER(
-			Dev, PreRangeTimeoutMicroSecs);
-
-		preRangeVcselPCLKS = VL53L0_GETDEVICESPECIFICPARAMETER(
-			Dev, PreRangeVcselPulsePeriod);
-
-		preRangeMacroPCLKS = VL53L0_calc_timeout_mclks(
-			Dev, preRangeTimeoutMicroSecs, preRangeVcselPCLKS);
-
-		vcselWidth = 3;
-		if (finalRangeVcselPCLKS == 8)
-			vcselWidth = 2;
-
-
-		peakVcselDuration_us = vcselWidth * 2048 *
-			(preRangeMacroPCLKS + finalRangeMacroPCLKS);
-		peakVcselDuration_us = (peakVcselDuration_us + 500)/1000;
-		peakVcselDuration_us *= cPllPeriod_ps;
-		peakVcselDuration_us = (peakVcselDuration_us + 500)/1000;
-
-		/* Fix1616 >> 8 = Fix2408 */
-		totalSignalRate_mcps = (totalSignalRate_mcps + 0x80) >> 8;
-
-		/* Fix2408 * uint32 = Fix2408 */
-		vcselTotalEventsRtn = totalSignalRate_mcps *
-			peakVcselDuration_us;
-
-		/* Fix2408 >> 8 = uint32 */
-		vcselTotalEventsRtn = (vcselTotalEventsRtn + 0x80) >> 8;
-
-		/* Fix2408 << 8 = Fix1616 = */
-		totalSignalRate_mcps <<= 8;
-	}
-
-	if (Status != VL53L0_ERROR_NONE) {
-		LOG_FUNCTION_END(Status);
-		return Status;
-	}
+	/* Fix2408 << 8 = Fix1616 = */
+	totalSignalRate_mcps <<= 8;
 
 	if (peakSignalRate_kcps == 0) {
 		*pSigmaEstimate = cSigmaEstMax;
@@ -1846,27 +2002,11 @@ VL53L0_Error VL53L0_calc_sigma_estimate(VL53L0_DEV Dev,
 			 */
 			sigmaEstRtn = cSigmaEstRtnMax;
 		}
-		finalRangeIntegrationTimeMilliSecs =
-		    (finalRangeTimeoutMicroSecs + preRangeTimeoutMicroSecs +
-		     500) / 1000;
-
-		/* sigmaEstRef = 1mm * 25ms/final range integration time
-		 * (inc pre-range)
-		 * sqrt(FixPoint1616/int) = FixPoint2408)
-		 */
-		sigmaEstRef =
-			VL53L0_isqrt((cDfltFinalRangeIntegrationTimeMilliSecs +
-				finalRangeIntegrationTimeMilliSecs/2)/
-				finalRangeIntegrationTimeMilliSecs);
-
-		/* FixPoint2408 << 8 = FixPoint1616 */
-		sigmaEstRef <<= 8;
-		sigmaEstRef = (sigmaEstRef + 500)/1000;
 
 		/* FixPoint1616 * FixPoint1616 = FixPoint3232 */
 		sqr1 = sigmaEstRtn * sigmaEstRtn;
-		/* FixPoint1616 * FixPoint1616 = FixPoint3232 */
-		sqr2 = sigmaEstRef * sigmaEstRef;
+		/* Reference sigma squared (FixPoint3232), precomputed */
+		sqr2 = PALDevDataGet(Dev, SigmaEstRefSqr);
 
 		/* sqrt(FixPoint3232) = FixPoint1616 */
 		sqrtResult = VL53L0_isqrt((sqr1 + sqr2));
@@ -619,6 +619,10 @@ VL53L0_Error set_final_range_timeout_us(
 		VL53L0_REG_FINAL_RANGE_CONFIG_TIMEOUT_MACROP_HI,
 		final_range_encoded_timeOut);
 
+	if (status == VL53L0_ERROR_NONE)
+		PALDevDataSet(dev, FinalRangeEncodedTimeout,
+			final_range_encoded_timeOut);
+
 	LOG_FUNCTION_END(status);
 
 	return status;
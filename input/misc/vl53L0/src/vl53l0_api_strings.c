@@ -120,6 +120,7 @@ VL53L0_Error VL53L0_get_device_info(VL53L0_DEV Dev,
 }
 
 
+#ifndef USE_MINIMAL_API
 VL53L0_Error VL53L0_get_device_error_string(VL53L0_DeviceError ErrorCode,
 		char *pDeviceErrorString)
 {
@@ -461,3 +462,4 @@ VL53L0_Error VL53L0_get_limit_check_info(VL53L0_DEV Dev, uint16_t LimitCheckId,
 	LOG_FUNCTION_END(Status);
 	return Status;
 }
+#endif /* USE_MINIMAL_API */
@@ -236,6 +236,9 @@ VL53L0_Error VL53L0_PollingDelay(VL53L0_DEV Dev)
 	VL53L0_Error status = VL53L0_ERROR_NONE;
 
 	LOG_FUNCTION_START("");
+	/* the device must see the queued writes before the delay */
+	if (VL53L0_I2CFlush(Dev) != 0)
+		status = VL53L0_ERROR_CONTROL_INTERFACE;
 	usleep_range(950, 1000);
 	LOG_FUNCTION_END(status);
 	return status;
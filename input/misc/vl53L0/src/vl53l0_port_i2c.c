@@ -7,23 +7,111 @@
 
 #include <linux/i2c.h>
 #include <linux/module.h>
+#include <linux/slab.h>
 #include "stmvl53l0-i2c.h"
 #include "stmvl53l0-cci.h"
 #include "vl53l0_platform.h"
 #include "vl53l0_i2c_platform.h"
 #include "stmvl53l0.h"
+#include "stmvl53l0_trace.h"
 
 #define I2C_M_WR			0x00
 #define STATUS_OK			0x00
 #define STATUS_FAIL			(-1)
-/** int  VL53L0_I2CWrite(VL53L0_Dev_t dev, void *buff, uint8_t len);
- * @brief       Write data buffer to VL53L0 device via i2c
- * @param dev   The device to write to
- * @param buff  The data buffer
- * @param len   The length of the transaction in byte
- * @return      0 on success
+
+/* record a transfer, see struct stmvl53l0_i2c_capture */
+static void stmvl53l0_i2c_capture(VL53L0_DEV dev, uint8_t reg,
+		const uint8_t *data, uint8_t len, char dir, int err)
+{
+	struct stmvl53l0_i2c_capture *cap = dev->i2cCapture;
+	struct stmvl53l0_i2c_record *rec;
+
+	if (len > STMVL53L0_I2C_CAPTURE_DATA)
+		len = STMVL53L0_I2C_CAPTURE_DATA;
+
+	spin_lock(&cap->lock);
+	rec = &cap->rec[cap->head++ % STMVL53L0_I2C_CAPTURE_SLOTS];
+	rec->timestamp = ktime_to_ns(ktime_get());
+	rec->err = err;
+	rec->dir = dir;
+	rec->reg = reg;
+	rec->len = len;
+	memcpy(rec->data, data, len);
+	spin_unlock(&cap->lock);
+}
+
+#ifdef CAMERA_CCI
+/*
+ * Send the queued byte writes in one CCI transaction. Its status is
+ * the status of each queued write, which is traced and captured here.
  */
-int VL53L0_I2CWrite(VL53L0_DEV dev, uint8_t *buff, uint8_t len)
+static int stmvl53l0_cci_flush(VL53L0_DEV dev)
+{
+	struct cci_data *cci_client_obj =
+		(struct cci_data *)dev->client_object;
+	struct msm_camera_i2c_client *client = cci_client_obj->client;
+	struct msm_camera_i2c_reg_setting setting = {
+		.reg_setting = dev->cciBatch,
+		.size = dev->cciBatchCount,
+		.addr_type = client->addr_type,
+		.data_type = MSM_CAMERA_I2C_BYTE_DATA,
+		.delay = 0,
+	};
+	struct msm_camera_i2c_reg_array *reg;
+	uint8_t data;
+	uint16_t i;
+	int err;
+
+	if (!dev->cciBatchCount)
+		return 0;
+	dev->cciBatchCount = 0;
+
+	err = client->i2c_func_tbl->i2c_write_table(client, &setting);
+	if (err > 0)
+		err = 0;
+	for (i = 0; i < setting.size; i++) {
+		reg = &dev->cciBatch[i];
+		data = reg->reg_data;
+		trace_stmvl53l0_i2c_flushed(reg->reg_addr, 2, 0, err);
+		if (dev->i2cCaptureOn)
+			stmvl53l0_i2c_capture(dev, reg->reg_addr, &data, 1,
+				'w', err);
+	}
+	if (err < 0) {
+		STMVL53L0_STAT_INC(dev, i2cErrors);
+		pr_err("%s:%d failed status=%d, %u writes lost\n",
+			__func__, __LINE__, err, setting.size);
+		return err;
+	}
+
+	return 0;
+}
+
+/* queue a byte write while batching, returns 1 when it was queued */
+static int stmvl53l0_cci_queue(VL53L0_DEV dev, const uint8_t *buff,
+		uint8_t len)
+{
+	struct msm_camera_i2c_reg_array *reg;
+	int err;
+
+	if (dev->bus_type != CCI_BUS || !dev->cciBatchOn || len != 2)
+		return 0;
+
+	if (dev->cciBatchCount == STMVL53L0_CCI_BATCH_MAX) {
+		err = stmvl53l0_cci_flush(dev);
+		if (err < 0)
+			return err;
+	}
+	reg = &dev->cciBatch[dev->cciBatchCount++];
+	reg->reg_addr = buff[0];
+	reg->reg_data = buff[1];
+	reg->delay = 0;
+
+	return 1;
+}
+#endif
+
+static int stmvl53l0_i2c_write(VL53L0_DEV dev, uint8_t *buff, uint8_t len)
 {
 	int err = 0;
 
@@ -60,7 +148,7 @@ int VL53L0_I2CWrite(VL53L0_DEV dev, uint8_t *buff, uint8_t len)
 					__func__, __LINE__, err);
 				return err;
 			}
-		} else if (len >= 5) {
+		} else if (len >= 4) {
 			err = client->i2c_func_tbl->i2c_write_seq(client,
 					index, &buff[1], (len-1));
 			if (err < 0) {
@@ -69,7 +157,12 @@ int VL53L0_I2CWrite(VL53L0_DEV dev, uint8_t *buff, uint8_t len)
 				return err;
 			}
 
+		} else if (len == 0) {
+			pr_err("%s:%d no data to write\n",
+				__func__, __LINE__);
+			return -EINVAL;
 		}
+		/* len 1: index write ahead of a read, i2c_read_seq sends it */
 #endif
 #ifndef CAMERA_CCI
 	} else {
@@ -99,14 +192,7 @@ int VL53L0_I2CWrite(VL53L0_DEV dev, uint8_t *buff, uint8_t len)
 }
 
 
-/** int VL53L0_I2CRead(VL53L0_Dev_t dev, void *buff, uint8_t len);
- * @brief       Read data buffer from VL53L0 device via i2c
- * @param dev   The device to read from
- * @param buff  The data buffer to fill
- * @param len   The length of the transaction in byte
- * @return      transaction status
- */
-int VL53L0_I2CRead(VL53L0_DEV dev, uint8_t *buff, uint8_t len)
+static int stmvl53l0_i2c_read(VL53L0_DEV dev, uint8_t *buff, uint8_t len)
 {
 
 	int err = 0;
@@ -153,3 +239,126 @@ int VL53L0_I2CRead(VL53L0_DEV dev, uint8_t *buff, uint8_t len)
 
 	return 0;
 }
+
+/** void VL53L0_I2CBatchBegin(VL53L0_DEV dev);
+ * @brief       Queue the following single byte writes on a CCI bus
+ * @param dev   The device to queue writes for
+ */
+void VL53L0_I2CBatchBegin(VL53L0_DEV dev)
+{
+#ifdef CAMERA_CCI
+	if (dev->bus_type != CCI_BUS)
+		return;
+	if (!dev->cciBatch) {
+		dev->cciBatch = kcalloc(STMVL53L0_CCI_BATCH_MAX,
+				sizeof(*dev->cciBatch), GFP_KERNEL);
+		if (!dev->cciBatch) {
+			pr_err("%s: CCI batch not available\n", __func__);
+			return;
+		}
+	}
+	dev->cciBatchOn = 1;
+#endif
+}
+
+/** int VL53L0_I2CBatchEnd(VL53L0_DEV dev);
+ * @brief       Send the queued writes and stop queuing
+ * @param dev   The device to send the writes to
+ * @return      0 on success
+ */
+int VL53L0_I2CBatchEnd(VL53L0_DEV dev)
+{
+	int err = VL53L0_I2CFlush(dev);
+
+	dev->cciBatchOn = 0;
+
+	return err;
+}
+
+/** int VL53L0_I2CFlush(VL53L0_DEV dev);
+ * @brief       Send the queued writes
+ * @param dev   The device to send the writes to
+ * @return      0 on success
+ */
+int VL53L0_I2CFlush(VL53L0_DEV dev)
+{
+	int err = 0;
+
+#ifdef CAMERA_CCI
+	if (dev->bus_type == CCI_BUS)
+		err = stmvl53l0_cci_flush(dev);
+#endif
+
+	return err;
+}
+
+/** int  VL53L0_I2CWrite(VL53L0_Dev_t dev, void *buff, uint8_t len);
+ * @brief       Write data buffer to VL53L0 device via i2c
+ * @param dev   The device to write to
+ * @param buff  The data buffer
+ * @param len   The length of the transaction in byte
+ * @return      0 on success
+ */
+int VL53L0_I2CWrite(VL53L0_DEV dev, uint8_t *buff, uint8_t len)
+{
+	uint8_t index = buff[0];
+	int err;
+
+#ifdef CAMERA_CCI
+	err = stmvl53l0_cci_queue(dev, buff, len);
+	if (err < 0)
+		return err;
+	if (err) {
+		/* not sent yet, the flush reports the outcome */
+		trace_stmvl53l0_i2c_queued(index, len, 0, 0);
+		if (dev->i2cCaptureOn)
+			stmvl53l0_i2c_capture(dev, index, &buff[1], 1, 'q', 0);
+		return 0;
+	}
+#endif
+	/* the queued writes go first, and fail on their own account */
+	err = VL53L0_I2CFlush(dev);
+	if (err)
+		return err;
+
+	trace_stmvl53l0_i2c_start(index, len, 0, 0);
+	err = stmvl53l0_i2c_write(dev, buff, len);
+	trace_stmvl53l0_i2c_end(index, len, 0, err);
+	if (err)
+		STMVL53L0_STAT_INC(dev, i2cErrors);
+	/* len 0 has no index byte either, nothing to record */
+	if (dev->i2cCaptureOn && len)
+		stmvl53l0_i2c_capture(dev, index, &buff[1], len - 1, 'w',
+			err);
+
+	return err;
+}
+
+/** int VL53L0_I2CRead(VL53L0_Dev_t dev, void *buff, uint8_t len);
+ * @brief       Read data buffer from VL53L0 device via i2c
+ * @param dev   The device to read from
+ * @param buff  The data buffer to fill, buff[0] holds the register index
+ * @param len   The length of the transaction in byte
+ * @return      transaction status
+ */
+int VL53L0_I2CRead(VL53L0_DEV dev, uint8_t *buff, uint8_t len)
+{
+	/* buff[0] is overwritten by the data, keep the index for the trace */
+	uint8_t index = buff[0];
+	int err;
+
+	/* the queued writes go first, and fail on their own account */
+	err = VL53L0_I2CFlush(dev);
+	if (err)
+		return err;
+
+	trace_stmvl53l0_i2c_start(index, len, 1, 0);
+	err = stmvl53l0_i2c_read(dev, buff, len);
+	trace_stmvl53l0_i2c_end(index, len, 1, err);
+	if (err)
+		STMVL53L0_STAT_INC(dev, i2cErrors);
+	if (dev->i2cCaptureOn)
+		stmvl53l0_i2c_capture(dev, index, buff, len, 'r', err);
+
+	return err;
+}
@@ -0,0 +1,82 @@
+/*
+ *  stmvl53l0-config.h - Linux kernel modules for STM VL53L0 FlightSense TOF
+ *						 sensor
+ *
+ *  Copyright (C) 2016 STMicroelectronics Imaging Division
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+/*
+ * Configuration values of the driver, also built into the host tools
+ * of debug_tool/stm_vl53l0/vl53l0_sim so that their flows follow the
+ * driver. Plain defines only, no kernel dependency.
+ */
+#ifndef STMVL53L0_CONFIG_H
+#define STMVL53L0_CONFIG_H
+
+/* Use cases */
+#define USE_CASE_LONG_DISTANCE	1
+#define USE_CASE_HIGH_ACCURACY	2
+#define USE_CASE_HIGH_SPEED		3
+#define USE_CASE_CUSTOM			4
+#define USE_CASE_ULTRA_HIGH_SPEED	5
+
+#define LONG_DISTANCE_TIMING_BUDGET			26000
+#define LONG_DISTANCE_SIGNAL_RATE_LIMIT		(65536 / 10) /* 0.1 * 65536  */
+#define LONG_DISTANCE_SIGMA_LIMIT			(60*65536)
+#define LONG_DISTANCE_PRE_RANGE_PULSE_PERIOD	18
+#define LONG_DISTANCE_FINAL_RANGE_PULSE_PERIOD	14
+
+
+
+#define HIGH_ACCURACY_TIMING_BUDGET				200000
+#define HIGH_ACCURACY_SIGNAL_RATE_LIMIT	 (25 * 65536 / 100) /* 0.25 * 65536 */
+#define HIGH_ACCURACY_SIGMA_LIMIT				(18*65536)
+#define HIGH_ACCURACY_PRE_RANGE_PULSE_PERIOD	14
+#define HIGH_ACCURACY_FINAL_RANGE_PULSE_PERIOD	10
+
+
+
+#define HIGH_SPEED_TIMING_BUDGET				20000
+#define HIGH_SPEED_SIGNAL_RATE_LIMIT	(25 * 65536 / 100) /* 0.25 * 65536 */
+#define HIGH_SPEED_SIGMA_LIMIT					(32*65536)
+#define HIGH_SPEED_PRE_RANGE_PULSE_PERIOD		14
+#define HIGH_SPEED_FINAL_RANGE_PULSE_PERIOD		10
+
+/*
+ * Ultra high speed: TCC, MSRC and pre-range are skipped and the DSS
+ * timeout is cut down, leaving most of the budget to the final range.
+ * This trades accuracy and range for rate: sigma is about twice the
+ * high speed one, targets beyond ~1.2 m are not reliably detected and,
+ * without the pre-range phase check, may alias to a shorter distance.
+ * Meant for short range gesture and collision detection at 100+ Hz.
+ */
+#define ULTRA_HIGH_SPEED_TIMING_BUDGET			8000
+#define ULTRA_HIGH_SPEED_SIGNAL_RATE_LIMIT	(25 * 65536 / 100) /* 0.25 */
+#define ULTRA_HIGH_SPEED_SIGMA_LIMIT			(60*65536)
+#define ULTRA_HIGH_SPEED_PRE_RANGE_PULSE_PERIOD		14
+#define ULTRA_HIGH_SPEED_FINAL_RANGE_PULSE_PERIOD	10
+#define ULTRA_HIGH_SPEED_MSRC_TIMEOUT	(3 * 65536 / 10) /* 0.3 ms */
+
+/*
+ *  Energy estimate
+ *
+ *  VL53L0X datasheet figures at 2.8 V: 19 mA average while ranging,
+ *  VCSEL included, and 16 uA between timed measurements. A sample costs
+ *  the ranging current over the programmed timing budget, which the PAL
+ *  derives from the sequence step timeouts in VCSEL periods; the rest
+ *  of the regulator on-time costs the idle current.
+ */
+#define STMVL53L0_SUPPLY_MV		2800
+#define STMVL53L0_RANGING_UA		19000
+#define STMVL53L0_IDLE_UA		16
+
+#endif /* STMVL53L0_CONFIG_H */
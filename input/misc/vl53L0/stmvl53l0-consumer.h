@@ -0,0 +1,55 @@
+/*
+ *  stmvl53l0-consumer.h - Linux kernel modules for STM VL53L0 FlightSense TOF
+ *						 sensor
+ *
+ *  Copyright (C) 2016 STMicroelectronics Imaging Division
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+/*
+ * In-kernel range consumer API
+ *
+ * Lets a driver on the same camera module (typically the autofocus
+ * actuator) follow the ranging without going through userspace:
+ *  - stmvl53l0_get_last_range() copies the latest sample, it never
+ *    sleeps and may be called from any context. It returns -ENODATA
+ *    until the first sample and again once ranging stopped;
+ *  - a notifier registered with stmvl53l0_register_range_notifier() is
+ *    called with STMVL53L0_RANGE_UPDATE and a struct
+ *    stmvl53l0_range_sample for every new measurement.
+ *
+ * Notifiers run from the ranging work handler, in process context, so
+ * they may sleep; but they hold up the next measurement and must not
+ * call back into the stmvl53l0 driver.
+ */
+#ifndef STMVL53L0_CONSUMER_H
+#define STMVL53L0_CONSUMER_H
+#include <linux/types.h>
+#include <linux/ktime.h>
+#include <linux/notifier.h>
+
+#define STMVL53L0_RANGE_UPDATE	1
+
+struct stmvl53l0_range_sample {
+	uint32_t seq; /* 1 on the first sample of a run, then increments */
+	ktime_t timestamp; /* ktime_get() when the result was read */
+	uint16_t rangeMm;
+	uint8_t rangeStatus; /* 0: valid range */
+	uint32_t signalRateRtnMegaCps; /* FixPoint1616 */
+	uint32_t ambientRateRtnMegaCps; /* FixPoint1616 */
+	uint32_t measurementTimeUsec;
+};
+
+int stmvl53l0_register_range_notifier(struct notifier_block *nb);
+int stmvl53l0_unregister_range_notifier(struct notifier_block *nb);
+int stmvl53l0_get_last_range(struct stmvl53l0_range_sample *sample);
+
+#endif /* STMVL53L0_CONSUMER_H */
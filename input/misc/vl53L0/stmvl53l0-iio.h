@@ -0,0 +1,39 @@
+/*
+ *  stmvl53l0-iio.h - Linux kernel modules for STM VL53L0 FlightSense TOF sensor
+ *
+ *  Copyright (C) 2016 STMicroelectronics Imaging Division
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+/*
+ * Defines
+ */
+#ifndef STMVL53L0_IIO_H
+#define STMVL53L0_IIO_H
+
+struct stmvl53l0_data;
+
+#if IS_ENABLED(CONFIG_IIO_TRIGGERED_BUFFER)
+int stmvl53l0_iio_init(struct stmvl53l0_data *data);
+void stmvl53l0_iio_exit(struct stmvl53l0_data *data);
+void stmvl53l0_iio_data_ready(struct stmvl53l0_data *data);
+void stmvl53l0_iio_push(struct stmvl53l0_data *data);
+#else
+static inline int stmvl53l0_iio_init(struct stmvl53l0_data *data)
+{
+	return 0;
+}
+static inline void stmvl53l0_iio_exit(struct stmvl53l0_data *data) {}
+static inline void stmvl53l0_iio_data_ready(struct stmvl53l0_data *data) {}
+static inline void stmvl53l0_iio_push(struct stmvl53l0_data *data) {}
+#endif /* CONFIG_IIO_TRIGGERED_BUFFER */
+
+#endif /* STMVL53L0_IIO_H */
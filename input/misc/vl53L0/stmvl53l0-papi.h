@@ -0,0 +1,251 @@
+/*
+ *  stmvl53l0-papi.h - Linux kernel modules for STM VL53L0 FlightSense TOF sensor
+ *
+ *  Copyright (C) 2016 STMicroelectronics Imaging Division
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+/*
+ * Defines
+ */
+#ifndef STMVL53L0_PAPI_H
+#define STMVL53L0_PAPI_H
+
+/* #define USE_PAL_FUNC_TABLE */
+
+struct stmvl53l0_api_fn_t {
+	int8_t (*GetVersion)(VL53L0_Version_t *pVersion);
+	int8_t (*GetPalSpecVersion)(VL53L0_Version_t *pPalSpecVersion);
+
+	int8_t (*GetProductRevision)(VL53L0_DEV Dev,
+					uint8_t *pProductRevisionMajor,
+					uint8_t *pProductRevisionMinor);
+	int8_t (*GetDeviceInfo)(VL53L0_DEV Dev,
+				VL53L0_DeviceInfo_t *pVL53L0_DeviceInfo);
+	int8_t (*GetDeviceErrorStatus)(VL53L0_DEV Dev,
+				VL53L0_DeviceError *pDeviceErrorStatus);
+	int8_t (*GetRangeStatusString)(uint8_t RangeStatus,
+				char *pRangeStatusString);
+	int8_t (*GetDeviceErrorString)(VL53L0_DeviceError ErrorCode,
+				char *pDeviceErrorString);
+	int8_t (*GetPalErrorString)(VL53L0_Error PalErrorCode,
+				char *pPalErrorString);
+	int8_t (*GetPalStateString)(VL53L0_State PalStateCode,
+				char *pPalStateString);
+	int8_t (*GetPalState)(VL53L0_DEV Dev,	VL53L0_State *pPalState);
+	int8_t (*SetPowerMode)(VL53L0_DEV Dev,
+				VL53L0_PowerModes PowerMode);
+	int8_t (*GetPowerMode)(VL53L0_DEV Dev,
+				VL53L0_PowerModes *pPowerMode);
+	int8_t (*SetOffsetCalibrationDataMicroMeter)(VL53L0_DEV Dev,
+				int32_t OffsetCalibrationDataMicroMeter);
+	int8_t (*GetOffsetCalibrationDataMicroMeter)(VL53L0_DEV Dev,
+				int32_t *pOffsetCalibrationDataMicroMeter);
+	int8_t (*SetLinearityCorrectiveGain)(VL53L0_DEV Dev,
+				int16_t LinearityCorrectiveGain);
+	int8_t (*GetLinearityCorrectiveGain)(VL53L0_DEV Dev,
+				uint16_t *pLinearityCorrectiveGain);
+	int8_t (*SetGroupParamHold)(VL53L0_DEV Dev,
+				uint8_t GroupParamHold);
+	int8_t (*GetUpperLimitMilliMeter)(VL53L0_DEV Dev,
+				uint16_t *pUpperLimitMilliMeter);
+	int8_t (*SetDeviceAddress)(VL53L0_DEV Dev,
+				uint8_t DeviceAddress);
+	int8_t (*DataInit)(VL53L0_DEV Dev);
+	int8_t (*SetTuningSettingBuffer)(VL53L0_DEV Dev,
+				uint8_t *pTuningSettingBuffer,
+				uint8_t UseInternalTuningSettings);
+	int8_t (*GetTuningSettingBuffer)(VL53L0_DEV Dev,
+				uint8_t **pTuningSettingBuffer,
+				uint8_t *pUseInternalTuningSettings);
+	int8_t (*StaticInit)(VL53L0_DEV Dev);
+	int8_t (*WaitDeviceBooted)(VL53L0_DEV Dev);
+	int8_t (*ResetDevice)(VL53L0_DEV Dev);
+	int8_t (*SetDeviceParameters)(VL53L0_DEV Dev,
+			const VL53L0_DeviceParameters_t *pDeviceParameters);
+	int8_t (*GetDeviceParameters)(VL53L0_DEV Dev,
+				VL53L0_DeviceParameters_t *pDeviceParameters);
+	int8_t (*SetDeviceMode)(VL53L0_DEV Dev,
+				VL53L0_DeviceModes DeviceMode);
+	int8_t (*GetDeviceMode)(VL53L0_DEV Dev,
+				VL53L0_DeviceModes *pDeviceMode);
+	int8_t (*SetHistogramMode)(VL53L0_DEV Dev,
+				VL53L0_HistogramModes HistogramMode);
+	int8_t (*GetHistogramMode)(VL53L0_DEV Dev,
+				VL53L0_HistogramModes *pHistogramMode);
+	int8_t (*SetMeasurementTimingBudgetMicroSeconds)(VL53L0_DEV Dev,
+				uint32_t  MeasurementTimingBudgetMicroSeconds);
+	int8_t (*GetMeasurementTimingBudgetMicroSeconds)(
+				VL53L0_DEV Dev,
+				uint32_t *pMeasurementTimingBudgetMicroSeconds);
+	int8_t (*GetVcselPulsePeriod)(VL53L0_DEV Dev,
+				VL53L0_VcselPeriod VcselPeriodType,
+				uint8_t	*pVCSELPulsePeriod);
+	int8_t (*SetVcselPulsePeriod)(VL53L0_DEV Dev,
+				VL53L0_VcselPeriod VcselPeriodType,
+				uint8_t VCSELPulsePeriod);
+	int8_t (*SetSequenceStepEnable)(VL53L0_DEV Dev,
+				VL53L0_SequenceStepId SequenceStepId,
+				uint8_t SequenceStepEnabled);
+	int8_t (*GetSequenceStepEnable)(VL53L0_DEV Dev,
+				VL53L0_SequenceStepId SequenceStepId,
+				uint8_t *pSequenceStepEnabled);
+	int8_t (*GetSequenceStepEnables)(VL53L0_DEV Dev,
+		VL53L0_SchedulerSequenceSteps_t *pSchedulerSequenceSteps);
+	int8_t (*SetSequenceStepTimeout)(VL53L0_DEV Dev,
+				VL53L0_SequenceStepId SequenceStepId,
+				FixPoint1616_t TimeOutMilliSecs);
+	int8_t (*GetSequenceStepTimeout)(VL53L0_DEV Dev,
+				VL53L0_SequenceStepId SequenceStepId,
+				FixPoint1616_t *pTimeOutMilliSecs);
+	int8_t (*GetNumberOfSequenceSteps)(VL53L0_DEV Dev,
+				uint8_t *pNumberOfSequenceSteps);
+	int8_t (*GetSequenceStepsInfo)(
+				VL53L0_SequenceStepId SequenceStepId,
+				char *pSequenceStepsString);
+	int8_t (*SetInterMeasurementPeriodMilliSeconds)(
+				VL53L0_DEV Dev,
+				uint32_t InterMeasurementPeriodMilliSeconds);
+	int8_t (*GetInterMeasurementPeriodMilliSeconds)(
+				VL53L0_DEV Dev,
+				uint32_t *pInterMeasurementPeriodMilliSeconds);
+	int8_t (*SetXTalkCompensationEnable)(VL53L0_DEV Dev,
+				uint8_t XTalkCompensationEnable);
+	int8_t (*GetXTalkCompensationEnable)(VL53L0_DEV Dev,
+				uint8_t *pXTalkCompensationEnable);
+	int8_t (*SetXTalkCompensationRateMegaCps)(
+				VL53L0_DEV Dev,
+				FixPoint1616_t XTalkCompensationRateMegaCps);
+	int8_t (*GetXTalkCompensationRateMegaCps)(
+				VL53L0_DEV Dev,
+				FixPoint1616_t *pXTalkCompensationRateMegaCps);
+	int8_t (*GetNumberOfLimitCheck)(
+				uint16_t *pNumberOfLimitCheck);
+	int8_t (*GetLimitCheckInfo)(VL53L0_DEV Dev,
+				uint16_t LimitCheckId, char *pLimitCheckString);
+	int8_t (*SetLimitCheckEnable)(VL53L0_DEV Dev,
+				uint16_t LimitCheckId,
+				uint8_t LimitCheckEnable);
+	int8_t (*GetLimitCheckEnable)(VL53L0_DEV Dev,
+		uint16_t LimitCheckId, uint8_t *pLimitCheckEnable);
+	int8_t (*SetLimitCheckValue)(VL53L0_DEV Dev,
+				uint16_t LimitCheckId,
+				FixPoint1616_t LimitCheckValue);
+	int8_t (*GetLimitCheckValue)(VL53L0_DEV Dev,
+				uint16_t LimitCheckId,
+				FixPoint1616_t *pLimitCheckValue);
+	int8_t (*GetLimitCheckCurrent)(VL53L0_DEV Dev,
+		uint16_t LimitCheckId, FixPoint1616_t *pLimitCheckCurrent);
+	int8_t (*SetWrapAroundCheckEnable)(VL53L0_DEV Dev,
+				uint8_t WrapAroundCheckEnable);
+	int8_t (*GetWrapAroundCheckEnable)(VL53L0_DEV Dev,
+				uint8_t *pWrapAroundCheckEnable);
+	int8_t (*PerformSingleMeasurement)(VL53L0_DEV Dev);
+	int8_t (*PerformRefCalibration)(VL53L0_DEV Dev,
+				uint8_t *pVhvSettings, uint8_t *pPhaseCal);
+	int8_t (*SetRefCalibration)(VL53L0_DEV Dev,
+			uint8_t VhvSettings,
+			uint8_t PhaseCal);
+	int8_t (*GetRefCalibration)(VL53L0_DEV Dev,
+			uint8_t *pVhvSettings,
+			uint8_t *pPhaseCal);
+	int8_t (*PerformXTalkCalibration)(VL53L0_DEV Dev,
+				FixPoint1616_t XTalkCalDistance,
+				FixPoint1616_t *pXTalkCompensationRateMegaCps);
+	int8_t (*PerformOffsetCalibration)(VL53L0_DEV Dev,
+				FixPoint1616_t CalDistanceMilliMeter,
+				int32_t *pOffsetMicroMeter);
+	int8_t (*StartMeasurement)(VL53L0_DEV Dev);
+	int8_t (*StopMeasurement)(VL53L0_DEV Dev);
+	int8_t (*GetMeasurementDataReady)(VL53L0_DEV Dev,
+				uint8_t *pMeasurementDataReady);
+	int8_t (*WaitDeviceReadyForNewMeasurement)(VL53L0_DEV Dev,
+				uint32_t MaxLoop);
+	int8_t (*GetRangingMeasurementData)(VL53L0_DEV Dev,
+		VL53L0_RangingMeasurementData_t *pRangingMeasurementData);
+	int8_t (*GetHistogramMeasurementData)(VL53L0_DEV Dev,
+		VL53L0_HistogramMeasurementData_t *pHistogramMeasurementData);
+	int8_t (*PerformSingleRangingMeasurement)(VL53L0_DEV Dev,
+		VL53L0_RangingMeasurementData_t *pRangingMeasurementData);
+	int8_t (*PerformSingleHistogramMeasurement)(VL53L0_DEV Dev,
+		VL53L0_HistogramMeasurementData_t *pHistogramMeasurementData);
+	int8_t (*SetNumberOfROIZones)(VL53L0_DEV Dev,
+				uint8_t NumberOfROIZones);
+	int8_t (*GetNumberOfROIZones)(VL53L0_DEV Dev,
+				uint8_t *pNumberOfROIZones);
+	int8_t (*GetMaxNumberOfROIZones)(VL53L0_DEV Dev,
+				uint8_t *pMaxNumberOfROIZones);
+	int8_t (*SetGpioConfig)(VL53L0_DEV Dev,
+				uint8_t Pin,
+				VL53L0_DeviceModes DeviceMode,
+				VL53L0_GpioFunctionality Functionality,
+				VL53L0_InterruptPolarity Polarity);
+	int8_t (*GetGpioConfig)(VL53L0_DEV Dev,
+				uint8_t Pin,
+				VL53L0_DeviceModes *pDeviceMode,
+				VL53L0_GpioFunctionality *pFunctionality,
+				VL53L0_InterruptPolarity *pPolarity);
+	int8_t (*SetInterruptThresholds)(VL53L0_DEV Dev,
+				VL53L0_DeviceModes DeviceMode,
+				FixPoint1616_t ThresholdLow,
+				FixPoint1616_t ThresholdHigh);
+	int8_t (*GetInterruptThresholds)(VL53L0_DEV Dev,
+				VL53L0_DeviceModes DeviceMode,
+				FixPoint1616_t *pThresholdLow,
+				FixPoint1616_t *pThresholdHigh);
+	int8_t (*ClearInterruptMask)(VL53L0_DEV Dev,
+				uint32_t InterruptMask);
+	int8_t (*GetInterruptMaskStatus)(VL53L0_DEV Dev,
+				uint32_t *pInterruptMaskStatus);
+	int8_t (*EnableInterruptMask)(VL53L0_DEV Dev, uint32_t InterruptMask);
+	int8_t (*SetSpadAmbientDamperThreshold)(VL53L0_DEV Dev,
+				uint16_t SpadAmbientDamperThreshold);
+	int8_t (*GetSpadAmbientDamperThreshold)(VL53L0_DEV Dev,
+				uint16_t *pSpadAmbientDamperThreshold);
+	int8_t (*SetSpadAmbientDamperFactor)(VL53L0_DEV Dev,
+				uint16_t SpadAmbientDamperFactor);
+	int8_t (*GetSpadAmbientDamperFactor)(VL53L0_DEV Dev,
+				uint16_t *pSpadAmbientDamperFactor);
+	int8_t (*PerformRefSpadManagement)(VL53L0_DEV Dev,
+		uint32_t *refSpadCount, uint8_t *isApertureSpads);
+	int8_t (*SetReferenceSpads)(VL53L0_DEV Dev,
+			 uint32_t count, uint8_t isApertureSpads);
+	int8_t (*GetReferenceSpads)(VL53L0_DEV Dev,
+			uint32_t *pSpadCount, uint8_t *pIsApertureSpads);
+	int8_t (*GetStopCompletedStatus)(VL53L0_DEV Dev,
+					 uint32_t *pStopStatus);
+};
+extern struct stmvl53l0_api_fn_t *papi_func_tbl;
+
+/*
+ * PAL dispatch
+ *
+ * Only cut 1.1 is supported, for which stmvl53l0_setupAPIFunctions
+ * fills the table with the PAL functions of the same name. Calls are
+ * therefore bound at build time, avoiding an indirect call per PAL
+ * function on the ranging path. The table is kept, and used when
+ * USE_PAL_FUNC_TABLE is defined, to plug in another cut.
+ *
+ * The minimal profile (USE_MINIMAL_API) builds the PAL without the
+ * entry points the driver does not call, so it has no table.
+ */
+#if defined(USE_PAL_FUNC_TABLE) && defined(USE_MINIMAL_API)
+#error "USE_PAL_FUNC_TABLE needs the full PAL, not USE_MINIMAL_API"
+#endif
+#ifdef USE_PAL_FUNC_TABLE
+#define PAPI(fn)		(papi_func_tbl->fn)
+#define PAPI_AVAILABLE(fn)	(papi_func_tbl->fn != NULL)
+#else
+#define PAPI(fn)		VL53L0_##fn
+#define PAPI_AVAILABLE(fn)	1
+#endif
+
+#endif /* STMVL53L0_PAPI_H */
@@ -24,6 +24,9 @@
 #include <linux/workqueue.h>
 #include <linux/miscdevice.h>
 #include <linux/wait.h>
+#include <linux/ktime.h>
+#include <linux/percpu.h>
+#include <linux/spinlock.h>
 
 
 #define STMVL53L0_DRV_NAME	"stmvl53l0"
@@ -77,6 +80,26 @@ struct stmvl53l0_register {
 	int32_t status;
 };
 
+/*
+ *  IOCTL bulk register data structs
+ *
+ *  Reads or writes reg_count bytes of page in one burst under the
+ *  driver lock, switching page once: from reg_index on, or, when
+ *  scatter is set, the single byte registers listed in reg_list.
+ */
+#define STMVL53L0_REG_BULK_MAX	64 /* VL53L0_MAX_I2C_XFER_SIZE */
+
+struct stmvl53l0_register_bulk {
+	uint32_t is_read; /*1: read 0: write*/
+	uint32_t page;
+	uint32_t reg_index;
+	uint32_t reg_count;
+	uint32_t scatter;
+	uint8_t reg_list[STMVL53L0_REG_BULK_MAX];
+	uint8_t reg_data[STMVL53L0_REG_BULK_MAX];
+	int32_t status;
+};
+
 /*
  *  IOCTL parameter structs
  */
@@ -88,6 +111,23 @@ struct stmvl53l0_parameter {
 	int32_t status;
 };
 
+/*
+ *  IOCTL parameter vector
+ *
+ *  The entries are checked together before any is applied, then applied
+ *  in order under one hold of the driver lock. If one fails, the values
+ *  the driver held before applying are written back, so the device is
+ *  left either fully reconfigured or as it was. status holds the first
+ *  error; entries which were not applied report 0.
+ */
+#define STMVL53L0_PARAMETER_VEC_MAX	16
+
+struct stmvl53l0_parameter_vec {
+	uint32_t count;
+	struct stmvl53l0_parameter param[STMVL53L0_PARAMETER_VEC_MAX];
+	int32_t status;
+};
+
 /*
  *  IOCTL Custom Use Case
  */
@@ -99,6 +139,252 @@ struct stmvl53l0_custom_use_case {
 	uint32_t		timingBudget;
 };
 
+/*
+ *  IOCTL proximity (near/far event) mode
+ *
+ *  The sensor runs continuous timed ranging and only interrupts the host
+ *  when the target crosses the [nearMm, farMm] window.
+ */
+#define STMVL53L0_PROXIMITY_MAX_MM	8190 /* 12-bit threshold in 2 mm */
+
+#define STMVL53L0_PROXIMITY_UNKNOWN	0
+#define STMVL53L0_PROXIMITY_NEAR	1
+#define STMVL53L0_PROXIMITY_FAR		2
+
+struct stmvl53l0_proximity {
+	uint32_t	nearMm; /* nearMm == farMm == 0 disables the mode */
+	uint32_t	farMm;
+	uint32_t	interMeasurementMs;
+};
+
+/*
+ *  Histogram capture ring, shared with userspace through mmap()
+ *
+ *  A slot is valid when its seq is non-zero and matches the value of
+ *  head at the time it was produced plus one. The reader advances tail
+ *  once a slot has been consumed; slots overwritten before tail caught
+ *  up are accounted in overrun.
+ */
+#define STMVL53L0_HISTO_RING_SLOTS	64
+
+struct stmvl53l0_histo_slot {
+	uint32_t seq; /* 0 while the slot is being written */
+	uint32_t tv_sec;
+	uint32_t tv_usec;
+	int32_t status;
+	VL53L0_HistogramMeasurementData_t histo;
+};
+
+struct stmvl53l0_histo_ring {
+	uint32_t head; /* slots produced, written by the driver */
+	uint32_t tail; /* slots consumed, written by the reader */
+	uint32_t overrun;
+	uint32_t slot_count;
+	struct stmvl53l0_histo_slot slot[STMVL53L0_HISTO_RING_SLOTS];
+};
+
+/*
+ *  IOCTL batched range data
+ *
+ *  Every measurement is kept, with a sequence number starting at 1, in
+ *  a ring of STMVL53L0_SAMPLE_RING_SLOTS. The ioctl returns, oldest
+ *  first, up to count samples newer than sinceSeq (0: the whole ring).
+ *  With minCount set it first waits until that many are there, or
+ *  timeoutMs (0: no limit) expires. lost counts samples newer than
+ *  sinceSeq that were already overwritten.
+ */
+#define STMVL53L0_SAMPLE_RING_SLOTS	64
+
+struct stmvl53l0_sample {
+	uint32_t seq;
+	uint32_t tv_sec;
+	uint32_t tv_usec;
+	VL53L0_RangingMeasurementData_t rangeData;
+};
+
+struct stmvl53l0_getdatas_batch {
+	uint32_t sinceSeq;
+	uint32_t minCount;
+	uint32_t timeoutMs;
+	uint32_t count; /* in: samples wanted, out: samples returned */
+	uint32_t lost;
+	struct stmvl53l0_sample sample[STMVL53L0_SAMPLE_RING_SLOTS];
+};
+
+/*
+ *  Device configuration reported by show_current_configuration
+ *
+ *  Each Set path records what it writes, so that reading it back does
+ *  not touch the bus. Paths whose effect the driver does not track
+ *  (initialization, calibration, raw register writes) mark it stale,
+ *  and it is read back in full when next used.
+ */
+#define STMVL53L0_CFG_LIMIT_CHECKS \
+	(VL53L0_CHECKENABLE_RANGE_IGNORE_THRESHOLD + 1)
+
+struct stmvl53l0_cfg_mirror {
+	VL53L0_Error status; /* of the last refresh */
+	uint8_t valid;
+	uint8_t stale;
+	FixPoint1616_t limitValue[STMVL53L0_CFG_LIMIT_CHECKS];
+	uint8_t limitEnable[STMVL53L0_CFG_LIMIT_CHECKS];
+	uint8_t vhvSettings;
+	uint8_t phaseCal;
+	uint32_t refSpadCount;
+	uint8_t isApertureSpads;
+	uint32_t timingBudget;
+	uint8_t preRangePulsePeriod;
+	uint8_t finalRangePulsePeriod;
+	int32_t offsetMicroMeter;
+	uint8_t xtalkEnable;
+	FixPoint1616_t xtalkRateMegaCps;
+};
+
+/*
+ *  Range filter stage, applied to every sample before it is reported
+ *
+ *  With the default configuration (no filter, no rejection, no deadband)
+ *  every sample is reported as read from the device.
+ */
+#define STMVL53L0_FILTER_NONE		0
+#define STMVL53L0_FILTER_MEDIAN		1
+#define STMVL53L0_FILTER_ALPHA_BETA	2
+
+#define STMVL53L0_FILTER_MEDIAN_MAX	7
+
+struct stmvl53l0_filter {
+	uint8_t mode;
+	uint8_t medianLen; /* odd, up to STMVL53L0_FILTER_MEDIAN_MAX */
+	uint16_t alpha; /* alpha-beta gains, in 1/256 */
+	uint16_t beta;
+	uint32_t rejectMask; /* bit n set: drop samples with RangeStatus n */
+	uint16_t deadbandMm; /* 0: report every accepted sample */
+	uint32_t heartbeatMs; /* 0: no heartbeat */
+
+	/* state, cleared on start */
+	uint16_t window[STMVL53L0_FILTER_MEDIAN_MAX];
+	uint8_t windowCount;
+	uint8_t windowIdx;
+	uint8_t abValid;
+	int32_t abRange; /* mm, in 1/256 */
+	int32_t abRate; /* mm per sample, in 1/256 */
+	uint8_t lastValid;
+	uint16_t lastRange;
+	uint8_t lastStatus;
+	unsigned long lastReport; /* jiffies */
+
+	/* statistics */
+	uint32_t samples;
+	uint32_t rejected;
+	uint32_t suppressed;
+	uint32_t reported;
+};
+
+/*
+ *  Timing budget governor
+ *
+ *  Steps the timing budget of single ranging down while the sigma
+ *  estimate predicted at the shorter budget stays below targetSigmaMm,
+ *  and back up when the signal weakens.
+ */
+#define STMVL53L0_GOVERNOR_SIGMA_MAX	1000
+
+struct stmvl53l0_governor {
+	uint8_t enable;
+	uint32_t targetSigmaMm;
+	/* consecutive samples in favor of a step */
+	uint8_t downCount;
+	uint8_t upCount;
+	/* statistics */
+	uint32_t stepsDown;
+	uint32_t stepsUp;
+};
+/*
+ *  Energy estimate, see the model in stmvl53l0-config.h
+ */
+struct stmvl53l0_energy_count {
+	uint32_t samples;
+	u64 activeUs; /* ranging, i.e. the laser duty */
+	u64 onUs; /* regulator on, up to onSince */
+	ktime_t onSince; /* 0 while not counting on-time */
+};
+
+struct stmvl53l0_energy {
+	struct stmvl53l0_energy_count device; /* since probe */
+	struct stmvl53l0_energy_count session; /* since the last start */
+	/* average current cap, 0 if none, applied on the next start */
+	uint32_t capUa;
+	/* period the cap imposed on the running session, 0 if none */
+	uint32_t capPeriodMs;
+	uint8_t capSavedMode;
+	uint32_t capSavedInterMs;
+};
+
+/*
+ *  Runtime statistics, exported through debugfs
+ *
+ *  Counters are per-CPU so the work handler, the poll thread and the
+ *  I2C layer bump them without a lock; readers sum all CPUs. Latency
+ *  histograms use power of two buckets in microseconds, bucket n
+ *  counting [2^(n-1), 2^n) and the last one everything above.
+ */
+#define STMVL53L0_STATS_RANGE_STATUS	8 /* last: any other status */
+#define STMVL53L0_STATS_HIST_BUCKETS	20
+
+struct stmvl53l0_stats {
+	uint32_t samples;
+	uint32_t rangeStatus[STMVL53L0_STATS_RANGE_STATUS];
+	uint32_t rangeErrors; /* GetRangingMeasurementData failed */
+	uint32_t i2cErrors;
+	uint32_t watchdogRestarts; /* poll thread forced a restart */
+	uint32_t enables;
+	/* start() to first sample */
+	uint32_t enableLatency[STMVL53L0_STATS_HIST_BUCKETS];
+	/* work scheduled to work handler running */
+	uint32_t queueDelay[STMVL53L0_STATS_HIST_BUCKETS];
+};
+
+#define STMVL53L0_STAT_INC(data, field) \
+	do { \
+		if ((data)->stats) \
+			this_cpu_inc((data)->stats->field); \
+	} while (0)
+
+/*
+ *  I2C capture, exported through debugfs
+ *
+ *  Once enabled, every VL53L0_I2CWrite()/VL53L0_I2CRead() is recorded
+ *  in a ring, overwriting the oldest records. A write records the
+ *  register index and the bytes following it, a read the index it was
+ *  issued for and the bytes returned. On a CCI bus a write queued in a
+ *  batch is recorded as 'q' when queued, then as 'w' with the status of
+ *  the batch once sent.
+ */
+#define STMVL53L0_I2C_CAPTURE_SLOTS	1024
+#define STMVL53L0_I2C_CAPTURE_DATA	64 /* VL53L0_MAX_I2C_XFER_SIZE */
+
+struct stmvl53l0_i2c_record {
+	u64 timestamp; /* ns, ktime_get() at the end of the transfer */
+	int16_t err;
+	char dir; /* 'w', 'r' or 'q' */
+	uint8_t reg;
+	uint8_t len; /* bytes in data */
+	uint8_t data[STMVL53L0_I2C_CAPTURE_DATA];
+};
+
+struct stmvl53l0_i2c_capture {
+	spinlock_t lock;
+	uint32_t head; /* records captured since enabled */
+	struct stmvl53l0_i2c_record rec[STMVL53L0_I2C_CAPTURE_SLOTS];
+};
+
+/*
+ *  CCI write batching, see VL53L0_I2CBatchBegin()
+ */
+#define STMVL53L0_CCI_BATCH_MAX		64
+
+struct iio_dev;
+struct msm_camera_i2c_reg_array;
 
 /*
  *  driver data structs
@@ -160,6 +446,11 @@ struct stmvl53l0_data {
 
 	/* Range Data */
 	VL53L0_RangingMeasurementData_t rangeData;
+	/* Recent samples, for VL53L0_IOCTL_GETDATAS_BATCH */
+	spinlock_t sampleLock;
+	uint32_t sampleSeq; /* of the newest sample, 0: none yet */
+	struct stmvl53l0_sample sampleRing[STMVL53L0_SAMPLE_RING_SLOTS];
+	wait_queue_head_t sampleWq;
 
 	/* Device parameters */
 	VL53L0_DeviceModes	deviceMode;
@@ -180,7 +471,7 @@ struct stmvl53l0_data {
 	uint8_t		useCase;
 	/* Use this flag to indicate an update of use case */
 	uint8_t			updateUseCase;
-	/* Polling thread */
+	/* Polling thread, started on first use */
 	struct task_struct *poll_thread;
 	/* Wait Queue on which the poll thread blocks */
 	wait_queue_head_t poll_thread_wq;
@@ -196,6 +487,63 @@ struct stmvl53l0_data {
 	/* Debug */
 	unsigned int enableDebug;
 	uint8_t interrupt_received;
+
+	/* Set once the resources deferred from probe are set up */
+	uint8_t lateInitDone;
+
+	/* Histogram capture, ring allocated on first use */
+	struct stmvl53l0_histo_ring *histoRing;
+	struct delayed_work histo_work;
+	uint8_t histoCapture;
+	VL53L0_HistogramModes histoMode;
+
+	/* Configuration mirror */
+	struct stmvl53l0_cfg_mirror cfgMirror;
+	uint8_t cfgVerify;
+
+	/* Range filter */
+	struct stmvl53l0_filter filter;
+
+	/* Timing budget governor */
+	struct stmvl53l0_governor governor;
+
+	/* Timing budget derived from delay_ms */
+	uint8_t autoBudget;
+	uint32_t autoBudgetMax;
+
+	/* Proximity (near/far event) mode */
+	struct stmvl53l0_proximity proximity;
+	uint8_t proximityState;
+
+	/* Sequence steps pruned by the ultra high speed use case */
+	uint8_t uhsActive;
+	VL53L0_SchedulerSequenceSteps_t uhsSavedSteps;
+	FixPoint1616_t uhsSavedMsrcTimeout;
+
+	/* Measured output rate */
+	ktime_t lastSampleTime;
+	uint32_t sampleIntervalUs; /* running average */
+
+	/* Energy estimate and power cap */
+	struct stmvl53l0_energy energy;
+
+	/* Statistics, NULL if they could not be allocated */
+	struct stmvl53l0_stats __percpu *stats;
+	struct dentry *debugfs;
+	ktime_t scheduleTime; /* work queued, 0 if not measured */
+	ktime_t enableTime; /* start(), 0 once the first sample came */
+
+	/* IIO front end, NULL if not available */
+	struct iio_dev *indio_dev;
+
+	/* I2C capture, allocated when first enabled */
+	struct stmvl53l0_i2c_capture *i2cCapture;
+	uint8_t i2cCaptureOn;
+
+	/* CCI byte writes queued for one transaction, allocated on use */
+	struct msm_camera_i2c_reg_array *cciBatch;
+	uint16_t cciBatchCount;
+	uint8_t cciBatchOn;
 };
 
 /*
@@ -212,5 +560,6 @@ struct stmvl53l0_module_fn_t {
 
 int stmvl53l0_setup(struct stmvl53l0_data *data);
 void stmvl53l0_cleanup(struct stmvl53l0_data *data);
+int stmvl53l0_set_ranging(struct stmvl53l0_data *data, int on);
 
 #endif /* STMVL53L0_H */
@@ -0,0 +1,369 @@
+/*
+ *  stmvl53l0_module-iio.c - Linux kernel modules for STM VL53L0 FlightSense TOF
+ *							sensor
+ *
+ *  Copyright (C) 2016 STMicroelectronics Imaging Division.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+/*
+ * IIO front end
+ *
+ * Every decoded sample is packed into a scan and exposed through an IIO
+ * device next to the input device. The driver registers a data-ready
+ * trigger fired by the work handler, whether the measurement was
+ * signalled by the interrupt or found by the poll thread, and timestamps
+ * its scans with the data-ready time. Any other trigger (hrtimer,
+ * sysfs) samples the latest measurement with the trigger timestamp.
+ * Enabling the buffer starts ranging if nothing else did.
+ */
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/iio/iio.h>
+#include <linux/iio/buffer.h>
+#include <linux/iio/trigger.h>
+#include <linux/iio/trigger_consumer.h>
+#include <linux/iio/triggered_buffer.h>
+/*
+ * API includes
+ */
+#include "vl53l0_api.h"
+#include "vl53l0_def.h"
+#include "vl53l0_platform.h"
+#include "stmvl53l0-iio.h"
+#include "stmvl53l0-papi.h"
+#include "stmvl53l0.h"
+
+#if IS_ENABLED(CONFIG_IIO_TRIGGERED_BUFFER)
+
+enum {
+	STMVL53L0_SCAN_DISTANCE,
+	STMVL53L0_SCAN_STATUS,
+	STMVL53L0_SCAN_SPAD,
+	STMVL53L0_SCAN_SIGNAL,
+	STMVL53L0_SCAN_AMBIENT,
+	STMVL53L0_SCAN_SIGMA,
+	STMVL53L0_SCAN_TIMESTAMP,
+};
+
+/* Fixed scan layout, subsets are demuxed by the IIO core */
+struct stmvl53l0_iio_scan {
+	uint16_t distance; /* mm */
+	uint16_t status; /* RangeStatus */
+	uint16_t spad; /* effective return SPAD count, 8.8 */
+	uint16_t reserved;
+	uint32_t signal; /* MCPS, FixPoint1616 */
+	uint32_t ambient; /* MCPS, FixPoint1616 */
+	uint32_t sigma; /* mm, FixPoint1616 */
+	uint32_t reserved2;
+	int64_t timestamp;
+};
+
+struct stmvl53l0_iio {
+	struct stmvl53l0_data *data;
+	struct iio_trigger *trig;
+	/* latest sample, shared with triggers not run by the work handler */
+	spinlock_t lock;
+	struct stmvl53l0_iio_scan scan;
+	int64_t dataReadyNs;
+	uint8_t started; /* ranging started by the buffer */
+};
+
+#define STMVL53L0_IIO_CHAN(_type, _ext, _idx, _bits, _scale) { \
+	.type = _type, \
+	.extend_name = _ext, \
+	.info_mask_separate = BIT(IIO_CHAN_INFO_RAW) | (_scale), \
+	.scan_index = _idx, \
+	.scan_type = { \
+		.sign = 'u', \
+		.realbits = _bits, \
+		.storagebits = _bits, \
+		.endianness = IIO_CPU, \
+	}, \
+}
+
+static const struct iio_chan_spec stmvl53l0_iio_channels[] = {
+	STMVL53L0_IIO_CHAN(IIO_DISTANCE, NULL, STMVL53L0_SCAN_DISTANCE,
+		16, BIT(IIO_CHAN_INFO_SCALE)),
+	STMVL53L0_IIO_CHAN(IIO_COUNT, "status", STMVL53L0_SCAN_STATUS,
+		16, 0),
+	STMVL53L0_IIO_CHAN(IIO_COUNT, "spad", STMVL53L0_SCAN_SPAD,
+		16, BIT(IIO_CHAN_INFO_SCALE)),
+	STMVL53L0_IIO_CHAN(IIO_INTENSITY, "signal", STMVL53L0_SCAN_SIGNAL,
+		32, BIT(IIO_CHAN_INFO_SCALE)),
+	STMVL53L0_IIO_CHAN(IIO_INTENSITY, "ambient", STMVL53L0_SCAN_AMBIENT,
+		32, BIT(IIO_CHAN_INFO_SCALE)),
+	STMVL53L0_IIO_CHAN(IIO_DISTANCE, "sigma", STMVL53L0_SCAN_SIGMA,
+		32, BIT(IIO_CHAN_INFO_SCALE)),
+	IIO_CHAN_SOFT_TIMESTAMP(STMVL53L0_SCAN_TIMESTAMP),
+};
+
+static const unsigned long stmvl53l0_iio_scan_masks[] = {
+	BIT(STMVL53L0_SCAN_DISTANCE) | BIT(STMVL53L0_SCAN_STATUS) |
+	BIT(STMVL53L0_SCAN_SPAD) | BIT(STMVL53L0_SCAN_SIGNAL) |
+	BIT(STMVL53L0_SCAN_AMBIENT) | BIT(STMVL53L0_SCAN_SIGMA),
+	0
+};
+
+static int stmvl53l0_iio_read_raw(struct iio_dev *indio_dev,
+				struct iio_chan_spec const *chan,
+				int *val, int *val2, long mask)
+{
+	struct stmvl53l0_iio *priv = iio_priv(indio_dev);
+	struct stmvl53l0_iio_scan scan;
+	unsigned long flags;
+
+	switch (mask) {
+	case IIO_CHAN_INFO_RAW:
+		spin_lock_irqsave(&priv->lock, flags);
+		scan = priv->scan;
+		spin_unlock_irqrestore(&priv->lock, flags);
+
+		switch (chan->scan_index) {
+		case STMVL53L0_SCAN_DISTANCE:
+			*val = scan.distance;
+			break;
+		case STMVL53L0_SCAN_STATUS:
+			*val = scan.status;
+			break;
+		case STMVL53L0_SCAN_SPAD:
+			*val = scan.spad;
+			break;
+		case STMVL53L0_SCAN_SIGNAL:
+			*val = scan.signal;
+			break;
+		case STMVL53L0_SCAN_AMBIENT:
+			*val = scan.ambient;
+			break;
+		case STMVL53L0_SCAN_SIGMA:
+			*val = scan.sigma;
+			break;
+		default:
+			return -EINVAL;
+		}
+		return IIO_VAL_INT;
+	case IIO_CHAN_INFO_SCALE:
+		switch (chan->scan_index) {
+		case STMVL53L0_SCAN_DISTANCE:
+			/* mm to m */
+			*val = 1;
+			*val2 = 1000;
+			return IIO_VAL_FRACTIONAL;
+		case STMVL53L0_SCAN_SPAD:
+			*val = 1;
+			*val2 = 256;
+			return IIO_VAL_FRACTIONAL;
+		case STMVL53L0_SCAN_SIGNAL:
+		case STMVL53L0_SCAN_AMBIENT:
+			*val = 1;
+			*val2 = 65536;
+			return IIO_VAL_FRACTIONAL;
+		case STMVL53L0_SCAN_SIGMA:
+			/* FixPoint1616 mm to m */
+			*val = 1;
+			*val2 = 65536000;
+			return IIO_VAL_FRACTIONAL;
+		default:
+			return -EINVAL;
+		}
+	default:
+		return -EINVAL;
+	}
+}
+
+static const struct iio_info stmvl53l0_iio_info = {
+	.read_raw = stmvl53l0_iio_read_raw,
+};
+
+static irqreturn_t stmvl53l0_iio_trigger_handler(int irq, void *p)
+{
+	struct iio_poll_func *pf = p;
+	struct iio_dev *indio_dev = pf->indio_dev;
+	struct stmvl53l0_iio *priv = iio_priv(indio_dev);
+	struct stmvl53l0_iio_scan scan;
+	unsigned long flags;
+	int64_t timestamp;
+
+	spin_lock_irqsave(&priv->lock, flags);
+	scan = priv->scan;
+	timestamp = priv->dataReadyNs;
+	spin_unlock_irqrestore(&priv->lock, flags);
+
+	/* only our own trigger knows when the data was ready */
+	if (indio_dev->trig != priv->trig)
+		timestamp = pf->timestamp;
+
+	iio_push_to_buffers_with_timestamp(indio_dev, &scan, timestamp);
+	iio_trigger_notify_done(indio_dev->trig);
+
+	return IRQ_HANDLED;
+}
+
+static int stmvl53l0_iio_postenable(struct iio_dev *indio_dev)
+{
+	struct stmvl53l0_iio *priv = iio_priv(indio_dev);
+	int rc;
+
+	rc = iio_triggered_buffer_postenable(indio_dev);
+	if (rc)
+		return rc;
+
+	priv->started = stmvl53l0_set_ranging(priv->data, 1);
+
+	return 0;
+}
+
+static int stmvl53l0_iio_predisable(struct iio_dev *indio_dev)
+{
+	struct stmvl53l0_iio *priv = iio_priv(indio_dev);
+
+	if (priv->started)
+		stmvl53l0_set_ranging(priv->data, 0);
+	priv->started = 0;
+
+	return iio_triggered_buffer_predisable(indio_dev);
+}
+
+static const struct iio_buffer_setup_ops stmvl53l0_iio_buffer_ops = {
+	.postenable = stmvl53l0_iio_postenable,
+	.predisable = stmvl53l0_iio_predisable,
+};
+
+/* Timestamp of the measurement about to be read by the work handler */
+void stmvl53l0_iio_data_ready(struct stmvl53l0_data *data)
+{
+	struct stmvl53l0_iio *priv;
+	unsigned long flags;
+
+	if (!data->indio_dev)
+		return;
+
+	priv = iio_priv(data->indio_dev);
+	spin_lock_irqsave(&priv->lock, flags);
+	priv->dataReadyNs = iio_get_time_ns(data->indio_dev);
+	spin_unlock_irqrestore(&priv->lock, flags);
+}
+
+/*
+ * Latch the decoded sample and fire the data-ready trigger.
+ * Called by the work handler with work_mutex held.
+ */
+void stmvl53l0_iio_push(struct stmvl53l0_data *data)
+{
+	struct stmvl53l0_iio *priv;
+	struct stmvl53l0_iio_scan scan;
+	FixPoint1616_t sigma = 0;
+	unsigned long flags;
+
+	if (!data->indio_dev)
+		return;
+
+	priv = iio_priv(data->indio_dev);
+
+	PAPI(GetLimitCheckCurrent)(data,
+				VL53L0_CHECKENABLE_SIGMA_FINAL_RANGE, &sigma);
+
+	memset(&scan, 0, sizeof(scan));
+	scan.distance = data->rangeData.RangeMilliMeter;
+	scan.status = data->rangeData.RangeStatus;
+	scan.spad = data->rangeData.EffectiveSpadRtnCount;
+	scan.signal = data->rangeData.SignalRateRtnMegaCps;
+	scan.ambient = data->rangeData.AmbientRateRtnMegaCps;
+	scan.sigma = sigma;
+
+	spin_lock_irqsave(&priv->lock, flags);
+	priv->scan = scan;
+	spin_unlock_irqrestore(&priv->lock, flags);
+
+	iio_trigger_poll_chained(priv->trig);
+}
+
+int stmvl53l0_iio_init(struct stmvl53l0_data *data)
+{
+	struct iio_dev *indio_dev;
+	struct stmvl53l0_iio *priv;
+	int rc;
+
+	indio_dev = iio_device_alloc(sizeof(*priv));
+	if (!indio_dev)
+		return -ENOMEM;
+
+	priv = iio_priv(indio_dev);
+	priv->data = data;
+	spin_lock_init(&priv->lock);
+
+	indio_dev->dev.parent = data->input_dev_ps->dev.parent;
+	indio_dev->name = STMVL53L0_DRV_NAME;
+	indio_dev->info = &stmvl53l0_iio_info;
+	indio_dev->modes = INDIO_DIRECT_MODE;
+	indio_dev->channels = stmvl53l0_iio_channels;
+	indio_dev->num_channels = ARRAY_SIZE(stmvl53l0_iio_channels);
+	indio_dev->available_scan_masks = stmvl53l0_iio_scan_masks;
+
+	priv->trig = iio_trigger_alloc("%s-dev%d", indio_dev->name,
+				indio_dev->id);
+	if (!priv->trig) {
+		rc = -ENOMEM;
+		goto exit_free_dev;
+	}
+	priv->trig->dev.parent = indio_dev->dev.parent;
+	iio_trigger_set_drvdata(priv->trig, indio_dev);
+	rc = iio_trigger_register(priv->trig);
+	if (rc)
+		goto exit_free_trig;
+	/* default to the data-ready trigger */
+	indio_dev->trig = iio_trigger_get(priv->trig);
+
+	rc = iio_triggered_buffer_setup(indio_dev, iio_pollfunc_store_time,
+			stmvl53l0_iio_trigger_handler,
+			&stmvl53l0_iio_buffer_ops);
+	if (rc)
+		goto exit_unregister_trig;
+
+	rc = iio_device_register(indio_dev);
+	if (rc)
+		goto exit_cleanup_buffer;
+
+	data->indio_dev = indio_dev;
+
+	return 0;
+exit_cleanup_buffer:
+	iio_triggered_buffer_cleanup(indio_dev);
+exit_unregister_trig:
+	iio_trigger_unregister(priv->trig);
+exit_free_trig:
+	iio_trigger_free(priv->trig);
+exit_free_dev:
+	iio_device_free(indio_dev);
+	return rc;
+}
+
+void stmvl53l0_iio_exit(struct stmvl53l0_data *data)
+{
+	struct iio_dev *indio_dev = data->indio_dev;
+	struct stmvl53l0_iio *priv;
+
+	if (!indio_dev)
+		return;
+
+	priv = iio_priv(indio_dev);
+	iio_device_unregister(indio_dev);
+	iio_triggered_buffer_cleanup(indio_dev);
+	iio_trigger_unregister(priv->trig);
+	iio_trigger_free(priv->trig);
+	iio_device_free(indio_dev);
+	data->indio_dev = NULL;
+}
+
+#endif /* CONFIG_IIO_TRIGGERED_BUFFER */
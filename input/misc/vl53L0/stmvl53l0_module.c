@@ -32,10 +32,22 @@
 #include <linux/platform_device.h>
 #include <linux/kobject.h>
 #include <linux/kthread.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 /*
  * API includes
  */
 #include "vl53l0_api.h"
+#include "vl53l0_i2c_platform.h"
+#include "stmvl53l0-consumer.h"
+#include "stmvl53l0-iio.h"
+#include "stmvl53l0-config.h"
+#include "stmvl53l0-papi.h"
+
+#define CREATE_TRACE_POINTS
+#include "stmvl53l0_trace.h"
 
 /*#define USE_INT */
 #define IRQ_NUM	   95 /*130*/
@@ -66,209 +78,7 @@ static struct stmvl53l0_module_fn_t stmvl53l0_module_func_tbl = {
 #endif
 struct stmvl53l0_module_fn_t *pmodule_func_tbl;
 
-struct stmvl53l0_api_fn_t {
-	int8_t (*GetVersion)(VL53L0_Version_t *pVersion);
-	int8_t (*GetPalSpecVersion)(VL53L0_Version_t *pPalSpecVersion);
-
-	int8_t (*GetProductRevision)(VL53L0_DEV Dev,
-					uint8_t *pProductRevisionMajor,
-					uint8_t *pProductRevisionMinor);
-	int8_t (*GetDeviceInfo)(VL53L0_DEV Dev,
-				VL53L0_DeviceInfo_t *pVL53L0_DeviceInfo);
-	int8_t (*GetDeviceErrorStatus)(VL53L0_DEV Dev,
-				VL53L0_DeviceError *pDeviceErrorStatus);
-	int8_t (*GetRangeStatusString)(uint8_t RangeStatus,
-				char *pRangeStatusString);
-	int8_t (*GetDeviceErrorString)(VL53L0_DeviceError ErrorCode,
-				char *pDeviceErrorString);
-	int8_t (*GetPalErrorString)(VL53L0_Error PalErrorCode,
-				char *pPalErrorString);
-	int8_t (*GetPalStateString)(VL53L0_State PalStateCode,
-				char *pPalStateString);
-	int8_t (*GetPalState)(VL53L0_DEV Dev,	VL53L0_State *pPalState);
-	int8_t (*SetPowerMode)(VL53L0_DEV Dev,
-				VL53L0_PowerModes PowerMode);
-	int8_t (*GetPowerMode)(VL53L0_DEV Dev,
-				VL53L0_PowerModes *pPowerMode);
-	int8_t (*SetOffsetCalibrationDataMicroMeter)(VL53L0_DEV Dev,
-				int32_t OffsetCalibrationDataMicroMeter);
-	int8_t (*GetOffsetCalibrationDataMicroMeter)(VL53L0_DEV Dev,
-				int32_t *pOffsetCalibrationDataMicroMeter);
-	int8_t (*SetLinearityCorrectiveGain)(VL53L0_DEV Dev,
-				int16_t LinearityCorrectiveGain);
-	int8_t (*GetLinearityCorrectiveGain)(VL53L0_DEV Dev,
-				uint16_t *pLinearityCorrectiveGain);
-	int8_t (*SetGroupParamHold)(VL53L0_DEV Dev,
-				uint8_t GroupParamHold);
-	int8_t (*GetUpperLimitMilliMeter)(VL53L0_DEV Dev,
-				uint16_t *pUpperLimitMilliMeter);
-	int8_t (*SetDeviceAddress)(VL53L0_DEV Dev,
-				uint8_t DeviceAddress);
-	int8_t (*DataInit)(VL53L0_DEV Dev);
-	int8_t (*SetTuningSettingBuffer)(VL53L0_DEV Dev,
-				uint8_t *pTuningSettingBuffer,
-				uint8_t UseInternalTuningSettings);
-	int8_t (*GetTuningSettingBuffer)(VL53L0_DEV Dev,
-				uint8_t **pTuningSettingBuffer,
-				uint8_t *pUseInternalTuningSettings);
-	int8_t (*StaticInit)(VL53L0_DEV Dev);
-	int8_t (*WaitDeviceBooted)(VL53L0_DEV Dev);
-	int8_t (*ResetDevice)(VL53L0_DEV Dev);
-	int8_t (*SetDeviceParameters)(VL53L0_DEV Dev,
-			const VL53L0_DeviceParameters_t *pDeviceParameters);
-	int8_t (*GetDeviceParameters)(VL53L0_DEV Dev,
-				VL53L0_DeviceParameters_t *pDeviceParameters);
-	int8_t (*SetDeviceMode)(VL53L0_DEV Dev,
-				VL53L0_DeviceModes DeviceMode);
-	int8_t (*GetDeviceMode)(VL53L0_DEV Dev,
-				VL53L0_DeviceModes *pDeviceMode);
-	int8_t (*SetHistogramMode)(VL53L0_DEV Dev,
-				VL53L0_HistogramModes HistogramMode);
-	int8_t (*GetHistogramMode)(VL53L0_DEV Dev,
-				VL53L0_HistogramModes *pHistogramMode);
-	int8_t (*SetMeasurementTimingBudgetMicroSeconds)(VL53L0_DEV Dev,
-				uint32_t  MeasurementTimingBudgetMicroSeconds);
-	int8_t (*GetMeasurementTimingBudgetMicroSeconds)(
-				VL53L0_DEV Dev,
-				uint32_t *pMeasurementTimingBudgetMicroSeconds);
-	int8_t (*GetVcselPulsePeriod)(VL53L0_DEV Dev,
-				VL53L0_VcselPeriod VcselPeriodType,
-				uint8_t	*pVCSELPulsePeriod);
-	int8_t (*SetVcselPulsePeriod)(VL53L0_DEV Dev,
-				VL53L0_VcselPeriod VcselPeriodType,
-				uint8_t VCSELPulsePeriod);
-	int8_t (*SetSequenceStepEnable)(VL53L0_DEV Dev,
-				VL53L0_SequenceStepId SequenceStepId,
-				uint8_t SequenceStepEnabled);
-	int8_t (*GetSequenceStepEnable)(VL53L0_DEV Dev,
-				VL53L0_SequenceStepId SequenceStepId,
-				uint8_t *pSequenceStepEnabled);
-	int8_t (*GetSequenceStepEnables)(VL53L0_DEV Dev,
-		VL53L0_SchedulerSequenceSteps_t *pSchedulerSequenceSteps);
-	int8_t (*SetSequenceStepTimeout)(VL53L0_DEV Dev,
-				VL53L0_SequenceStepId SequenceStepId,
-				FixPoint1616_t TimeOutMilliSecs);
-	int8_t (*GetSequenceStepTimeout)(VL53L0_DEV Dev,
-				VL53L0_SequenceStepId SequenceStepId,
-				FixPoint1616_t *pTimeOutMilliSecs);
-	int8_t (*GetNumberOfSequenceSteps)(VL53L0_DEV Dev,
-				uint8_t *pNumberOfSequenceSteps);
-	int8_t (*GetSequenceStepsInfo)(
-				VL53L0_SequenceStepId SequenceStepId,
-				char *pSequenceStepsString);
-	int8_t (*SetInterMeasurementPeriodMilliSeconds)(
-				VL53L0_DEV Dev,
-				uint32_t InterMeasurementPeriodMilliSeconds);
-	int8_t (*GetInterMeasurementPeriodMilliSeconds)(
-				VL53L0_DEV Dev,
-				uint32_t *pInterMeasurementPeriodMilliSeconds);
-	int8_t (*SetXTalkCompensationEnable)(VL53L0_DEV Dev,
-				uint8_t XTalkCompensationEnable);
-	int8_t (*GetXTalkCompensationEnable)(VL53L0_DEV Dev,
-				uint8_t *pXTalkCompensationEnable);
-	int8_t (*SetXTalkCompensationRateMegaCps)(
-				VL53L0_DEV Dev,
-				FixPoint1616_t XTalkCompensationRateMegaCps);
-	int8_t (*GetXTalkCompensationRateMegaCps)(
-				VL53L0_DEV Dev,
-				FixPoint1616_t *pXTalkCompensationRateMegaCps);
-	int8_t (*GetNumberOfLimitCheck)(
-				uint16_t *pNumberOfLimitCheck);
-	int8_t (*GetLimitCheckInfo)(VL53L0_DEV Dev,
-				uint16_t LimitCheckId, char *pLimitCheckString);
-	int8_t (*SetLimitCheckEnable)(VL53L0_DEV Dev,
-				uint16_t LimitCheckId,
-				uint8_t LimitCheckEnable);
-	int8_t (*GetLimitCheckEnable)(VL53L0_DEV Dev,
-		uint16_t LimitCheckId, uint8_t *pLimitCheckEnable);
-	int8_t (*SetLimitCheckValue)(VL53L0_DEV Dev,
-				uint16_t LimitCheckId,
-				FixPoint1616_t LimitCheckValue);
-	int8_t (*GetLimitCheckValue)(VL53L0_DEV Dev,
-				uint16_t LimitCheckId,
-				FixPoint1616_t *pLimitCheckValue);
-	int8_t (*GetLimitCheckCurrent)(VL53L0_DEV Dev,
-		uint16_t LimitCheckId, FixPoint1616_t *pLimitCheckCurrent);
-	int8_t (*SetWrapAroundCheckEnable)(VL53L0_DEV Dev,
-				uint8_t WrapAroundCheckEnable);
-	int8_t (*GetWrapAroundCheckEnable)(VL53L0_DEV Dev,
-				uint8_t *pWrapAroundCheckEnable);
-	int8_t (*PerformSingleMeasurement)(VL53L0_DEV Dev);
-	int8_t (*PerformRefCalibration)(VL53L0_DEV Dev,
-				uint8_t *pVhvSettings, uint8_t *pPhaseCal);
-	int8_t (*SetRefCalibration)(VL53L0_DEV Dev,
-			uint8_t VhvSettings,
-			uint8_t PhaseCal);
-	int8_t (*GetRefCalibration)(VL53L0_DEV Dev,
-			uint8_t *pVhvSettings,
-			uint8_t *pPhaseCal);
-	int8_t (*PerformXTalkCalibration)(VL53L0_DEV Dev,
-				FixPoint1616_t XTalkCalDistance,
-				FixPoint1616_t *pXTalkCompensationRateMegaCps);
-	int8_t (*PerformOffsetCalibration)(VL53L0_DEV Dev,
-				FixPoint1616_t CalDistanceMilliMeter,
-				int32_t *pOffsetMicroMeter);
-	int8_t (*StartMeasurement)(VL53L0_DEV Dev);
-	int8_t (*StopMeasurement)(VL53L0_DEV Dev);
-	int8_t (*GetMeasurementDataReady)(VL53L0_DEV Dev,
-				uint8_t *pMeasurementDataReady);
-	int8_t (*WaitDeviceReadyForNewMeasurement)(VL53L0_DEV Dev,
-				uint32_t MaxLoop);
-	int8_t (*GetRangingMeasurementData)(VL53L0_DEV Dev,
-		VL53L0_RangingMeasurementData_t *pRangingMeasurementData);
-	int8_t (*GetHistogramMeasurementData)(VL53L0_DEV Dev,
-		VL53L0_HistogramMeasurementData_t *pHistogramMeasurementData);
-	int8_t (*PerformSingleRangingMeasurement)(VL53L0_DEV Dev,
-		VL53L0_RangingMeasurementData_t *pRangingMeasurementData);
-	int8_t (*PerformSingleHistogramMeasurement)(VL53L0_DEV Dev,
-		VL53L0_HistogramMeasurementData_t *pHistogramMeasurementData);
-	int8_t (*SetNumberOfROIZones)(VL53L0_DEV Dev,
-				uint8_t NumberOfROIZones);
-	int8_t (*GetNumberOfROIZones)(VL53L0_DEV Dev,
-				uint8_t *pNumberOfROIZones);
-	int8_t (*GetMaxNumberOfROIZones)(VL53L0_DEV Dev,
-				uint8_t *pMaxNumberOfROIZones);
-	int8_t (*SetGpioConfig)(VL53L0_DEV Dev,
-				uint8_t Pin,
-				VL53L0_DeviceModes DeviceMode,
-				VL53L0_GpioFunctionality Functionality,
-				VL53L0_InterruptPolarity Polarity);
-	int8_t (*GetGpioConfig)(VL53L0_DEV Dev,
-				uint8_t Pin,
-				VL53L0_DeviceModes *pDeviceMode,
-				VL53L0_GpioFunctionality *pFunctionality,
-				VL53L0_InterruptPolarity *pPolarity);
-	int8_t (*SetInterruptThresholds)(VL53L0_DEV Dev,
-				VL53L0_DeviceModes DeviceMode,
-				FixPoint1616_t ThresholdLow,
-				FixPoint1616_t ThresholdHigh);
-	int8_t (*GetInterruptThresholds)(VL53L0_DEV Dev,
-				VL53L0_DeviceModes DeviceMode,
-				FixPoint1616_t *pThresholdLow,
-				FixPoint1616_t *pThresholdHigh);
-	int8_t (*ClearInterruptMask)(VL53L0_DEV Dev,
-				uint32_t InterruptMask);
-	int8_t (*GetInterruptMaskStatus)(VL53L0_DEV Dev,
-				uint32_t *pInterruptMaskStatus);
-	int8_t (*EnableInterruptMask)(VL53L0_DEV Dev, uint32_t InterruptMask);
-	int8_t (*SetSpadAmbientDamperThreshold)(VL53L0_DEV Dev,
-				uint16_t SpadAmbientDamperThreshold);
-	int8_t (*GetSpadAmbientDamperThreshold)(VL53L0_DEV Dev,
-				uint16_t *pSpadAmbientDamperThreshold);
-	int8_t (*SetSpadAmbientDamperFactor)(VL53L0_DEV Dev,
-				uint16_t SpadAmbientDamperFactor);
-	int8_t (*GetSpadAmbientDamperFactor)(VL53L0_DEV Dev,
-				uint16_t *pSpadAmbientDamperFactor);
-	int8_t (*PerformRefSpadManagement)(VL53L0_DEV Dev,
-		uint32_t *refSpadCount, uint8_t *isApertureSpads);
-	int8_t (*SetReferenceSpads)(VL53L0_DEV Dev,
-			 uint32_t count, uint8_t isApertureSpads);
-	int8_t (*GetReferenceSpads)(VL53L0_DEV Dev,
-			uint32_t *pSpadCount, uint8_t *pIsApertureSpads);
-	int8_t (*GetStopCompletedStatus)(VL53L0_DEV Dev,
-					 uint32_t *pStopStatus);
-};
-
+#ifndef USE_MINIMAL_API
 static struct stmvl53l0_api_fn_t stmvl53l0_api_func_tbl = {
 	.GetVersion = VL53L0_GetVersion,
 	.GetPalSpecVersion = VL53L0_GetPalSpecVersion,
@@ -373,6 +183,7 @@ static struct stmvl53l0_api_fn_t stmvl53l0_api_func_tbl = {
 
 };
 struct stmvl53l0_api_fn_t *papi_func_tbl;
+#endif
 
 /*
  * IOCTL definitions
@@ -393,6 +204,16 @@ struct stmvl53l0_api_fn_t *papi_func_tbl;
 			_IOWR('p', 0x0c, struct stmvl53l0_register)
 #define VL53L0_IOCTL_PARAMETER \
 			_IOWR('p', 0x0d, struct stmvl53l0_parameter)
+#define VL53L0_IOCTL_HISTO_START	_IOW('p', 0x0e, uint8_t)
+#define VL53L0_IOCTL_HISTO_STOP		_IO('p', 0x0f)
+#define VL53L0_IOCTL_SET_PROXIMITY \
+			_IOW('p', 0x10, struct stmvl53l0_proximity)
+#define VL53L0_IOCTL_REGISTER_BULK \
+			_IOWR('p', 0x11, struct stmvl53l0_register_bulk)
+#define VL53L0_IOCTL_PARAMETER_VEC \
+			_IOWR('p', 0x12, struct stmvl53l0_parameter_vec)
+#define VL53L0_IOCTL_GETDATAS_BATCH \
+			_IOWR('p', 0x13, struct stmvl53l0_getdatas_batch)
 
 
 /* Mask fields to indicate Offset and Xtalk Comp
@@ -401,33 +222,21 @@ struct stmvl53l0_api_fn_t *papi_func_tbl;
 #define SET_OFFSET_CALIB_DATA_MICROMETER_MASK 0x1
 #define SET_XTALK_COMP_RATE_MCPS_MASK         0x2
 
-/* Macros used across different functions */
-#define USE_CASE_LONG_DISTANCE	1
-#define USE_CASE_HIGH_ACCURACY	2
-#define USE_CASE_HIGH_SPEED		3
-#define USE_CASE_CUSTOM			4
-
-#define LONG_DISTANCE_TIMING_BUDGET			26000
-#define LONG_DISTANCE_SIGNAL_RATE_LIMIT		(65536 / 10) /* 0.1 * 65536  */
-#define LONG_DISTANCE_SIGMA_LIMIT			(60*65536)
-#define LONG_DISTANCE_PRE_RANGE_PULSE_PERIOD	18
-#define LONG_DISTANCE_FINAL_RANGE_PULSE_PERIOD	14
-
-
-
-#define HIGH_ACCURACY_TIMING_BUDGET				200000
-#define HIGH_ACCURACY_SIGNAL_RATE_LIMIT	 (25 * 65536 / 100) /* 0.25 * 65536 */
-#define HIGH_ACCURACY_SIGMA_LIMIT				(18*65536)
-#define HIGH_ACCURACY_PRE_RANGE_PULSE_PERIOD	14
-#define HIGH_ACCURACY_FINAL_RANGE_PULSE_PERIOD	10
-
+/* Timing budgets the governor steps through, in us */
+static const uint32_t governor_budgets[] = {
+	HIGH_SPEED_TIMING_BUDGET,
+	LONG_DISTANCE_TIMING_BUDGET,
+	50000,
+	100000,
+	HIGH_ACCURACY_TIMING_BUDGET
+};
 
+/* host time per sample on top of the timing budget */
+#define AUTO_BUDGET_MARGIN_US	2000
 
-#define HIGH_SPEED_TIMING_BUDGET				20000
-#define HIGH_SPEED_SIGNAL_RATE_LIMIT	(25 * 65536 / 100) /* 0.25 * 65536 */
-#define HIGH_SPEED_SIGMA_LIMIT					(32*65536)
-#define HIGH_SPEED_PRE_RANGE_PULSE_PERIOD		14
-#define HIGH_SPEED_FINAL_RANGE_PULSE_PERIOD		10
+/* consecutive samples needed before stepping the budget */
+#define GOVERNOR_UP_SAMPLES		2
+#define GOVERNOR_DOWN_SAMPLES	8
 
 
 
@@ -442,6 +251,10 @@ static int stmvl53l0_start(struct stmvl53l0_data *data, uint8_t scaling,
 			init_mode_e mode);
 static int stmvl53l0_stop(struct stmvl53l0_data *data);
 static int stmvl53l0_config_use_case(struct stmvl53l0_data *data);
+static void stmvl53l0_cfg_mirror_update(struct stmvl53l0_data *data);
+static int stmvl53l0_histo_start(struct stmvl53l0_data *data,
+			VL53L0_HistogramModes histoMode);
+static int stmvl53l0_histo_stop(struct stmvl53l0_data *data);
 
 #ifdef DEBUG_TIME_LOG
 static void stmvl53l0_DebugTimeGet(struct timeval *ptv)
@@ -475,6 +288,7 @@ static void stmvl53l0_setupAPIFunctions(struct stmvl53l0_data *data)
 	if (revision == 1) {
 		/*cut 1.1*/
 		vl53l0_dbgmsg("to setup API cut 1.1\n");
+#ifndef USE_MINIMAL_API
 		papi_func_tbl->GetVersion = VL53L0_GetVersion;
 		papi_func_tbl->GetPalSpecVersion = VL53L0_GetPalSpecVersion;
 		papi_func_tbl->GetProductRevision = VL53L0_GetProductRevision;
@@ -633,6 +447,7 @@ static void stmvl53l0_setupAPIFunctions(struct stmvl53l0_data *data)
 			 VL53L0_PerformRefSpadManagement;
 		papi_func_tbl->SetReferenceSpads = VL53L0_SetReferenceSpads;
 		papi_func_tbl->GetReferenceSpads = VL53L0_GetReferenceSpads;
+#endif
 	} else if (revision == 0) {
 		/*cut 1.0*/
 		vl53l0_errmsg("API cut 1.0 NOT SUPPORTED\n");
@@ -640,22 +455,569 @@ static void stmvl53l0_setupAPIFunctions(struct stmvl53l0_data *data)
 
 }
 
-static void stmvl53l0_ps_read_measurement(struct stmvl53l0_data *data)
+/*
+ * Configure the proximity mode, applied on the next start. The mode,
+ * period and interrupt fields are live while ranging, so the change
+ * is refused until ranging is stopped.
+ * Called with work_mutex held.
+ */
+static int stmvl53l0_set_proximity(struct stmvl53l0_data *data,
+				const struct stmvl53l0_proximity *proximity)
+{
+	if (data->enable_ps_sensor || data->histoCapture)
+		return -EBUSY;
+
+	if (proximity->nearMm == 0 && proximity->farMm == 0) {
+		/* back to the default measurement ready mode */
+		memset(&data->proximity, 0, sizeof(data->proximity));
+		data->deviceMode = VL53L0_DEVICEMODE_SINGLE_RANGING;
+		data->gpio_function = VL53L0_GPIOFUNCTIONALITY_NEW_MEASURE_READY;
+		return 0;
+	}
+
+	if (proximity->nearMm == 0 ||
+		proximity->nearMm >= proximity->farMm ||
+		proximity->farMm > STMVL53L0_PROXIMITY_MAX_MM ||
+		proximity->interMeasurementMs == 0) {
+		vl53l0_errmsg("invalid window near:%u far:%u period:%u\n",
+			proximity->nearMm, proximity->farMm,
+			proximity->interMeasurementMs);
+		return -EINVAL;
+	}
+
+	data->proximity = *proximity;
+	data->deviceMode = VL53L0_DEVICEMODE_CONTINUOUS_TIMED_RANGING;
+	data->interMeasurems = proximity->interMeasurementMs;
+	data->gpio_function = VL53L0_GPIOFUNCTIONALITY_THRESHOLD_CROSSED_OUT;
+	data->low_threshold = proximity->nearMm << 16;
+	data->high_threshold = proximity->farMm << 16;
+
+	return 0;
+}
+
+/*
+ * Update the near/far state from the measurement which raised the
+ * threshold interrupt, and arm the interrupt for the opposite crossing
+ * so that the host is not woken up while the target stays on the same
+ * side. Returns 1 when the state changed and has to be reported.
+ */
+static int stmvl53l0_proximity_event(struct stmvl53l0_data *data)
+{
+	VL53L0_DEV vl53l0_dev = data;
+	VL53L0_Error Status = VL53L0_ERROR_NONE;
+	VL53L0_GpioFunctionality gpioFunction;
+	uint8_t state;
+
+	if (data->rangeData.RangeStatus == 0 &&
+		data->rangeData.RangeMilliMeter < data->proximity.nearMm)
+		state = STMVL53L0_PROXIMITY_NEAR;
+	else if (data->rangeData.RangeStatus != 0 ||
+		data->rangeData.RangeMilliMeter > data->proximity.farMm)
+		state = STMVL53L0_PROXIMITY_FAR;
+	else
+		return 0; /* inside the window */
+
+	if (state == data->proximityState)
+		return 0;
+
+	if (state == STMVL53L0_PROXIMITY_NEAR)
+		gpioFunction = VL53L0_GPIOFUNCTIONALITY_THRESHOLD_CROSSED_HIGH;
+	else
+		gpioFunction = VL53L0_GPIOFUNCTIONALITY_THRESHOLD_CROSSED_LOW;
+
+	Status = PAPI(SetGpioConfig)(vl53l0_dev, 0, 0,
+		gpioFunction, VL53L0_INTERRUPTPOLARITY_LOW);
+	if (Status == VL53L0_ERROR_NONE)
+		data->gpio_function = gpioFunction;
+	else
+		vl53l0_errmsg("Failed to SetGpioConfig. Error = %d\n", Status);
+
+	vl53l0_dbgmsg("proximity %s, range:%d\n",
+		state == STMVL53L0_PROXIMITY_NEAR ? "near" : "far",
+		data->rangeData.RangeMilliMeter);
+	data->proximityState = state;
+
+	return 1;
+}
+
+/*
+ * Derive the largest timing budget and inter-measurement period which
+ * still meet the sampling period requested through delay_ms.
+ * Called with work_mutex held.
+ */
+static void stmvl53l0_auto_budget_update(struct stmvl53l0_data *data)
+{
+	uint32_t periodUs = data->delay_ms * 1000;
+	uint32_t budget = 0;
+
+	if (!data->autoBudget ||
+		data->useCase == USE_CASE_ULTRA_HIGH_SPEED)
+		return;
+
+	if (periodUs > AUTO_BUDGET_MARGIN_US)
+		budget = periodUs - AUTO_BUDGET_MARGIN_US;
+	budget = clamp_t(uint32_t, budget, HIGH_SPEED_TIMING_BUDGET,
+			HIGH_ACCURACY_TIMING_BUDGET);
+
+	vl53l0_dbgmsg("delay_ms:%u -> timingBudget:%u\n", data->delay_ms,
+		budget);
+	data->autoBudgetMax = budget;
+	data->timingBudget = budget;
+	/* the proximity mode has its own measurement period */
+	if (data->proximity.farMm == 0)
+		data->interMeasurems = data->delay_ms;
+
+	/* applied together by the work handler or on the next start */
+	if (data->enable_ps_sensor)
+		data->updateUseCase = 1;
+}
+
+/* Track the interval between samples, averaged over ~8 samples */
+static void stmvl53l0_rate_update(struct stmvl53l0_data *data)
+{
+	ktime_t now = ktime_get();
+	uint32_t intervalUs;
+
+	if (ktime_to_ns(data->lastSampleTime) != 0) {
+		intervalUs = (uint32_t)ktime_us_delta(now,
+				data->lastSampleTime);
+		if (data->sampleIntervalUs == 0)
+			data->sampleIntervalUs = intervalUs;
+		else
+			data->sampleIntervalUs = data->sampleIntervalUs -
+				(data->sampleIntervalUs >> 3) + (intervalUs >> 3);
+	}
+	data->lastSampleTime = now;
+}
+
+/* Latency histogram bucket of the time elapsed since a timestamp */
+static int stmvl53l0_stats_bucket(ktime_t since)
+{
+	s64 us = ktime_us_delta(ktime_get(), since);
+	int bucket = 0;
+
+	if (us > 0)
+		bucket = fls64(us);
+	if (bucket >= STMVL53L0_STATS_HIST_BUCKETS)
+		bucket = STMVL53L0_STATS_HIST_BUCKETS - 1;
+
+	return bucket;
+}
+
+/*
+ * Energy accounting, see struct stmvl53l0_energy. The regulator on-time
+ * is counted around the power_up/power_down calls, the ranging time per
+ * sample at the programmed timing budget.
+ */
+static void stmvl53l0_energy_off(struct stmvl53l0_energy_count *count)
+{
+	if (ktime_to_ns(count->onSince) != 0)
+		count->onUs += ktime_us_delta(ktime_get(), count->onSince);
+	count->onSince = ktime_set(0, 0);
+}
+
+static int stmvl53l0_power_up(struct stmvl53l0_data *data)
+{
+	int rc = pmodule_func_tbl->power_up(data->client_object, &data->reset);
+
+	if (rc == 0 && ktime_to_ns(data->energy.device.onSince) == 0)
+		data->energy.device.onSince = ktime_get();
+	return rc;
+}
+
+static int stmvl53l0_power_down(struct stmvl53l0_data *data)
+{
+	stmvl53l0_energy_off(&data->energy.device);
+	stmvl53l0_energy_off(&data->energy.session);
+	return pmodule_func_tbl->power_down(data->client_object);
+}
+
+static void stmvl53l0_energy_sample(struct stmvl53l0_data *data)
+{
+	data->energy.device.samples++;
+	data->energy.device.activeUs += data->timingBudget;
+	data->energy.session.samples++;
+	data->energy.session.activeUs += data->timingBudget;
+}
+
+/*
+ * Shortest sample period, in ms, keeping the average current under the
+ * cap at the programmed timing budget, 0 without a cap.
+ */
+static uint32_t stmvl53l0_energy_cap_period(struct stmvl53l0_data *data)
+{
+	uint32_t capUa = data->energy.capUa;
+	u64 periodUs;
+
+	if (capUa == 0)
+		return 0;
+	periodUs = div_u64((u64)data->timingBudget *
+			(STMVL53L0_RANGING_UA - STMVL53L0_IDLE_UA),
+			capUa - STMVL53L0_IDLE_UA);
+	return DIV_ROUND_UP_ULL(periodUs, 1000);
+}
+
+/* Undo what the cap changed, unless it was reconfigured since */
+static void stmvl53l0_energy_cap_restore(struct stmvl53l0_data *data)
+{
+	struct stmvl53l0_energy *energy = &data->energy;
+
+	if (energy->capPeriodMs == 0)
+		return;
+	if (data->deviceMode == VL53L0_DEVICEMODE_CONTINUOUS_TIMED_RANGING &&
+		data->interMeasurems == energy->capPeriodMs) {
+		data->deviceMode = energy->capSavedMode;
+		data->interMeasurems = energy->capSavedInterMs;
+	}
+	energy->capPeriodMs = 0;
+}
+
+/*
+ * Lower the sample rate to meet the power cap: when the configured mode
+ * would sample faster, ranging runs timed at the capped period until
+ * the next stop.
+ */
+static void stmvl53l0_energy_cap_apply(struct stmvl53l0_data *data)
+{
+	struct stmvl53l0_energy *energy = &data->energy;
+	uint32_t capMs, periodMs;
+
+	stmvl53l0_energy_cap_restore(data);
+	capMs = stmvl53l0_energy_cap_period(data);
+	periodMs = DIV_ROUND_UP(data->timingBudget, 1000);
+	if (data->deviceMode == VL53L0_DEVICEMODE_CONTINUOUS_TIMED_RANGING)
+		periodMs = max(periodMs, data->interMeasurems);
+#ifndef USE_INT
+	/* single ranging restarts once per poll */
+	if (data->deviceMode == VL53L0_DEVICEMODE_SINGLE_RANGING)
+		periodMs = max(periodMs, data->delay_ms);
+#endif
+	if (capMs <= periodMs)
+		return;
+
+	energy->capSavedMode = data->deviceMode;
+	energy->capSavedInterMs = data->interMeasurems;
+	energy->capPeriodMs = capMs;
+	data->deviceMode = VL53L0_DEVICEMODE_CONTINUOUS_TIMED_RANGING;
+	data->interMeasurems = capMs;
+	vl53l0_dbgmsg("power cap %u uA, period %u ms\n", energy->capUa, capMs);
+}
+
+/* Account a decoded sample. Called with work_mutex held */
+static void stmvl53l0_stats_sample(struct stmvl53l0_data *data)
+{
+	uint8_t rangeStatus = data->rangeData.RangeStatus;
+	int bucket;
+
+	if (rangeStatus >= STMVL53L0_STATS_RANGE_STATUS)
+		rangeStatus = STMVL53L0_STATS_RANGE_STATUS - 1;
+	STMVL53L0_STAT_INC(data, samples);
+	STMVL53L0_STAT_INC(data, rangeStatus[rangeStatus]);
+
+	if (ktime_to_ns(data->enableTime) != 0) {
+		bucket = stmvl53l0_stats_bucket(data->enableTime);
+		STMVL53L0_STAT_INC(data, enableLatency[bucket]);
+		data->enableTime = ktime_set(0, 0);
+	}
+	stmvl53l0_energy_sample(data);
+}
+
+/*
+ * In-kernel range consumers, see stmvl53l0-consumer.h. The latest
+ * sample is under a seqlock so readers never wait on the work handler.
+ */
+static BLOCKING_NOTIFIER_HEAD(stmvl53l0_range_chain);
+static DEFINE_SEQLOCK(stmvl53l0_range_lock);
+static struct stmvl53l0_range_sample stmvl53l0_range_last;
+
+int stmvl53l0_register_range_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_register(&stmvl53l0_range_chain, nb);
+}
+EXPORT_SYMBOL_GPL(stmvl53l0_register_range_notifier);
+
+int stmvl53l0_unregister_range_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_unregister(&stmvl53l0_range_chain,
+						nb);
+}
+EXPORT_SYMBOL_GPL(stmvl53l0_unregister_range_notifier);
+
+int stmvl53l0_get_last_range(struct stmvl53l0_range_sample *sample)
+{
+	unsigned int seq;
+
+	do {
+		seq = read_seqbegin(&stmvl53l0_range_lock);
+		*sample = stmvl53l0_range_last;
+	} while (read_seqretry(&stmvl53l0_range_lock, seq));
+
+	return sample->seq ? 0 : -ENODATA;
+}
+EXPORT_SYMBOL_GPL(stmvl53l0_get_last_range);
+
+/* Publish a decoded sample. Called with work_mutex held */
+static void stmvl53l0_range_publish(struct stmvl53l0_data *data)
+{
+	struct stmvl53l0_range_sample sample;
+	struct stmvl53l0_sample *slot;
+	struct timeval tv;
+	unsigned long flags;
+
+	do_gettimeofday(&tv);
+	spin_lock(&data->sampleLock);
+	data->sampleSeq++;
+	slot = &data->sampleRing[data->sampleSeq %
+		STMVL53L0_SAMPLE_RING_SLOTS];
+	slot->seq = data->sampleSeq;
+	slot->tv_sec = tv.tv_sec;
+	slot->tv_usec = tv.tv_usec;
+	slot->rangeData = data->rangeData;
+	spin_unlock(&data->sampleLock);
+	wake_up_interruptible(&data->sampleWq);
+
+	sample.timestamp = ktime_get();
+	sample.rangeMm = data->rangeData.RangeMilliMeter;
+	sample.rangeStatus = data->rangeData.RangeStatus;
+	sample.signalRateRtnMegaCps = data->rangeData.SignalRateRtnMegaCps;
+	sample.ambientRateRtnMegaCps = data->rangeData.AmbientRateRtnMegaCps;
+	sample.measurementTimeUsec = data->rangeData.MeasurementTimeUsec;
+
+	/* readers may interrupt us, from hardirq included */
+	write_seqlock_irqsave(&stmvl53l0_range_lock, flags);
+	sample.seq = stmvl53l0_range_last.seq + 1;
+	if (sample.seq == 0)
+		sample.seq = 1;
+	stmvl53l0_range_last = sample;
+	write_sequnlock_irqrestore(&stmvl53l0_range_lock, flags);
+
+	blocking_notifier_call_chain(&stmvl53l0_range_chain,
+				STMVL53L0_RANGE_UPDATE, &sample);
+}
+
+/* Drop the latest sample once ranging stopped, readers get -ENODATA */
+static void stmvl53l0_range_clear(void)
+{
+	unsigned long flags;
+
+	write_seqlock_irqsave(&stmvl53l0_range_lock, flags);
+	stmvl53l0_range_last.seq = 0;
+	write_sequnlock_irqrestore(&stmvl53l0_range_lock, flags);
+}
+
+/*
+ * Pick the timing budget of the next single ranging measurement from
+ * the last one. The sigma estimate scales with 1/sqrt(timing budget), so
+ * the sigma expected at the next lower budget is predicted from the
+ * current one, with a 1/8 margin as hysteresis.
+ * Called with work_mutex held.
+ */
+static void stmvl53l0_governor_update(struct stmvl53l0_data *data)
+{
+	struct stmvl53l0_governor *governor = &data->governor;
+	VL53L0_RangingMeasurementData_t *rangeData = &data->rangeData;
+	FixPoint1616_t sigmaEstimate = 0;
+	uint64_t sigmaSqr;
+	uint64_t targetSqr;
+	uint32_t budget = data->timingBudget;
+	int levels = ARRAY_SIZE(governor_budgets);
+	int level;
+	int weak;
+	int strong = 0;
+
+	if (!governor->enable || data->updateUseCase ||
+		data->useCase == USE_CASE_ULTRA_HIGH_SPEED ||
+		data->deviceMode != VL53L0_DEVICEMODE_SINGLE_RANGING)
+		return;
+
+	for (level = 0; level < levels - 1; level++)
+		if (governor_budgets[level] >= budget)
+			break;
+
+	PAPI(GetLimitCheckCurrent)(data,
+		VL53L0_CHECKENABLE_SIGMA_FINAL_RANGE, &sigmaEstimate);
+
+	/* in 1/16 mm */
+	sigmaSqr = sigmaEstimate >> 12;
+	sigmaSqr *= sigmaSqr;
+	targetSqr = governor->targetSigmaMm << 4;
+	targetSqr *= targetSqr;
+
+	/* sigma or signal fail, or target close to the maximum distance */
+	weak = rangeData->RangeStatus == 1 || rangeData->RangeStatus == 2 ||
+		(rangeData->RangeStatus == 0 && (sigmaSqr > targetSqr ||
+		(rangeData->RangeDMaxMilliMeter != 0 &&
+		rangeData->RangeMilliMeter * 5 >
+			rangeData->RangeDMaxMilliMeter * 4)));
+
+	if (!weak && rangeData->RangeStatus == 0 && level > 0 &&
+		rangeData->SignalRateRtnMegaCps >
+			rangeData->AmbientRateRtnMegaCps)
+		strong = sigmaSqr * budget * 64 <=
+			targetSqr * governor_budgets[level - 1] * 49;
+
+	if (weak) {
+		governor->downCount = 0;
+		if (level == levels - 1 || (data->autoBudget &&
+			governor_budgets[level + 1] > data->autoBudgetMax) ||
+			++governor->upCount < GOVERNOR_UP_SAMPLES)
+			return;
+		level++;
+		governor->stepsUp++;
+	} else if (strong) {
+		governor->upCount = 0;
+		if (++governor->downCount < GOVERNOR_DOWN_SAMPLES)
+			return;
+		level--;
+		governor->stepsDown++;
+	} else {
+		governor->upCount = 0;
+		governor->downCount = 0;
+		return;
+	}
+
+	governor->upCount = 0;
+	governor->downCount = 0;
+	vl53l0_dbgmsg("timing budget %u -> %u, sigma:%u, range:%d\n",
+		budget, governor_budgets[level], sigmaEstimate >> 16,
+		rangeData->RangeMilliMeter);
+	/* applied before the next measurement is started */
+	data->timingBudget = governor_budgets[level];
+	data->updateUseCase = 1;
+}
+
+static void stmvl53l0_filter_reset(struct stmvl53l0_filter *filter)
+{
+	filter->windowCount = 0;
+	filter->windowIdx = 0;
+	filter->abValid = 0;
+	filter->lastValid = 0;
+}
+
+static uint16_t stmvl53l0_filter_median(struct stmvl53l0_filter *filter,
+				uint16_t range)
+{
+	uint16_t sorted[STMVL53L0_FILTER_MEDIAN_MAX];
+	uint16_t value;
+	int i, j;
+
+	filter->window[filter->windowIdx] = range;
+	filter->windowIdx = (filter->windowIdx + 1) % filter->medianLen;
+	if (filter->windowCount < filter->medianLen)
+		filter->windowCount++;
+
+	/* insertion sort, the window is at most 7 samples */
+	for (i = 0; i < filter->windowCount; i++) {
+		value = filter->window[i];
+		for (j = i; j > 0 && sorted[j - 1] > value; j--)
+			sorted[j] = sorted[j - 1];
+		sorted[j] = value;
+	}
+
+	return sorted[filter->windowCount / 2];
+}
+
+static uint16_t stmvl53l0_filter_alpha_beta(struct stmvl53l0_filter *filter,
+				uint16_t range)
+{
+	int32_t measured = (int32_t)range << 8;
+	int32_t predicted;
+	int32_t residual;
+
+	if (!filter->abValid) {
+		filter->abRange = measured;
+		filter->abRate = 0;
+		filter->abValid = 1;
+		return range;
+	}
+
+	predicted = filter->abRange + filter->abRate;
+	residual = measured - predicted;
+	filter->abRange = predicted + ((residual * filter->alpha) >> 8);
+	filter->abRate += (residual * filter->beta) >> 8;
+
+	if (filter->abRange < 0)
+		return 0;
+	return (uint16_t)((filter->abRange + 128) >> 8);
+}
+
+/*
+ * Run the sample through the filter stage. With force set, the sample
+ * is smoothed but never rejected nor suppressed, as for a proximity
+ * transition which is not reported again.
+ * Returns 1 if it has to be reported, with *range set to the filtered
+ * range, 0 if it is dropped.
+ */
+static int stmvl53l0_filter_sample(struct stmvl53l0_data *data,
+				uint16_t *range, int force)
+{
+	struct stmvl53l0_filter *filter = &data->filter;
+	uint8_t rangeStatus = data->rangeData.RangeStatus;
+	uint16_t filtered = data->rangeData.RangeMilliMeter;
+	uint16_t delta;
+
+	filter->samples++;
+
+	if (!force && rangeStatus < 32 &&
+		(filter->rejectMask & (1U << rangeStatus))) {
+		filter->rejected++;
+		return 0;
+	}
+
+	if (filter->mode == STMVL53L0_FILTER_MEDIAN)
+		filtered = stmvl53l0_filter_median(filter, filtered);
+	else if (filter->mode == STMVL53L0_FILTER_ALPHA_BETA)
+		filtered = stmvl53l0_filter_alpha_beta(filter, filtered);
+
+	*range = filtered;
+
+	/* report on significant change, status change or heartbeat */
+	if (!force && filter->lastValid && filter->deadbandMm != 0 &&
+		rangeStatus == filter->lastStatus) {
+		delta = (filtered > filter->lastRange) ?
+			filtered - filter->lastRange :
+			filter->lastRange - filtered;
+		if (delta < filter->deadbandMm &&
+			(filter->heartbeatMs == 0 ||
+			time_before(jiffies, filter->lastReport +
+				msecs_to_jiffies(filter->heartbeatMs)))) {
+			filter->suppressed++;
+			return 0;
+		}
+	}
+
+	filter->lastValid = 1;
+	filter->lastRange = filtered;
+	filter->lastStatus = rangeStatus;
+	filter->lastReport = jiffies;
+	filter->reported++;
+
+	return 1;
+}
+
+static void stmvl53l0_ps_read_measurement(struct stmvl53l0_data *data,
+				int force)
 {
 	struct timeval tv;
 	VL53L0_DEV vl53l0_dev = data;
 	VL53L0_Error Status = VL53L0_ERROR_NONE;
 	FixPoint1616_t LimitCheckCurrent;
+	uint16_t range;
+
+	if (!stmvl53l0_filter_sample(data, &range, force)) {
+		trace_stmvl53l0_input_report(data->rangeData.RangeMilliMeter,
+			data->ps_data, 0, 0);
+		return;
+	}
 
 	do_gettimeofday(&tv);
 
-	data->ps_data = data->rangeData.RangeMilliMeter;
+	data->ps_data = range;
 	input_report_abs(data->input_dev_ps, ABS_DISTANCE,
 		(int)(data->ps_data + 5) / 10);
 	input_report_abs(data->input_dev_ps, ABS_HAT0X, tv.tv_sec);
 	input_report_abs(data->input_dev_ps, ABS_HAT0Y, tv.tv_usec);
-	input_report_abs(data->input_dev_ps, ABS_HAT1X,
-		data->rangeData.RangeMilliMeter);
+	input_report_abs(data->input_dev_ps, ABS_HAT1X, range);
 	input_report_abs(data->input_dev_ps, ABS_HAT1Y,
 		data->rangeData.RangeStatus);
 	input_report_abs(data->input_dev_ps, ABS_HAT2X,
@@ -666,7 +1028,8 @@ static void stmvl53l0_ps_read_measurement(struct stmvl53l0_data *data)
 		data->rangeData.MeasurementTimeUsec);
 	input_report_abs(data->input_dev_ps, ABS_HAT3Y,
 		data->rangeData.RangeDMaxMilliMeter);
-	Status = papi_func_tbl->GetLimitCheckCurrent(vl53l0_dev,
+	LimitCheckCurrent = 0;
+	Status = PAPI(GetLimitCheckCurrent)(vl53l0_dev,
 					VL53L0_CHECKENABLE_SIGMA_FINAL_RANGE,
 					&LimitCheckCurrent);
 	if (Status == VL53L0_ERROR_NONE) {
@@ -677,20 +1040,8 @@ static void stmvl53l0_ps_read_measurement(struct stmvl53l0_data *data)
 		data->rangeData.EffectiveSpadRtnCount);
 	input_sync(data->input_dev_ps);
 
-	if (data->enableDebug)
-		vl53l0_errmsg(
-"range:%d, RtnRateMcps:%d,err:0x%x,Dmax:%d,rtnambr:%d,time:%d,Spad:%d,SigmaLimit:%d\n",
-			data->rangeData.RangeMilliMeter,
-			data->rangeData.SignalRateRtnMegaCps,
-			data->rangeData.RangeStatus,
-			data->rangeData.RangeDMaxMilliMeter,
-			data->rangeData.AmbientRateRtnMegaCps,
-			data->rangeData.MeasurementTimeUsec,
-			data->rangeData.EffectiveSpadRtnCount,
-			LimitCheckCurrent
-			);
-
-
+	trace_stmvl53l0_input_report(data->rangeData.RangeMilliMeter, range,
+		LimitCheckCurrent, 1);
 }
 
 static void stmvl53l0_cancel_handler(struct stmvl53l0_data *data)
@@ -721,6 +1072,8 @@ void stmvl53l0_schedule_handler(struct stmvl53l0_data *data)
 	 * change the scheduled time that's why we have to cancel it first.
 	 */
 	cancel_delayed_work(&data->dwork);
+	data->scheduleTime = ktime_get();
+	stmvl53l0_iio_data_ready(data);
 	schedule_delayed_work(&data->dwork, 0);
 	spin_unlock_irqrestore(&data->update_lock.wait_lock, flags);
 
@@ -735,6 +1088,9 @@ static irqreturn_t stmvl53l0_interrupt_handler(int vec, void *info)
 
 	if (data->irq == vec) {
 		data->interrupt_received = 1;
+		trace_stmvl53l0_data_ready(0, 1);
+		data->scheduleTime = ktime_get();
+		stmvl53l0_iio_data_ready(data);
 		schedule_delayed_work(&data->dwork, 0);
 	}
 	return IRQ_HANDLED;
@@ -748,6 +1104,7 @@ int stmvl53l0_poll_thread(void *data)
 	VL53L0_Error Status = VL53L0_ERROR_NONE;
 	uint32_t sleep_time = 0;
 	uint32_t interruptStatus = 0;
+	uint32_t watchdogMs;
 
 	pr_err("%s(%d) : Starting Polling thread\n", __func__, __LINE__);
 
@@ -773,31 +1130,41 @@ int stmvl53l0_poll_thread(void *data)
 			interruptStatus != vl53l0_dev->interruptStatus) {
 			vl53l0_dev->interruptStatus = interruptStatus;
 			vl53l0_dev->noInterruptCount = 0;
+			trace_stmvl53l0_data_ready(interruptStatus, 0);
 			stmvl53l0_schedule_handler(vl53l0_dev);
 		} else {
 			vl53l0_dev->noInterruptCount++;
 		}
 
 		/*Force Clear interrupt mask and restart if
-		 *no interrupt after twice the timingBudget
+		 *no interrupt after twice the timingBudget,
+		 *or twice the period in timed mode (power cap included),
+		 *threshold interrupts are expected to be rare
 		 */
-		if ((vl53l0_dev->noInterruptCount * vl53l0_dev->delay_ms) >
-			 (vl53l0_dev->timingBudget * 2)) {
-			pr_err("No interrupt after (%u) msec(TimingBudget = %u) . Clear Interrupt Mask and restart\n",
-				(vl53l0_dev->noInterruptCount *
-					 vl53l0_dev->delay_ms),
-					vl53l0_dev->timingBudget);
-			Status = papi_func_tbl->ClearInterruptMask(vl53l0_dev,
+		watchdogMs = vl53l0_dev->timingBudget * 2;
+		if (vl53l0_dev->deviceMode ==
+			VL53L0_DEVICEMODE_CONTINUOUS_TIMED_RANGING)
+			watchdogMs = max(watchdogMs,
+				vl53l0_dev->interMeasurems * 2);
+		if (vl53l0_dev->proximity.farMm == 0 &&
+			(vl53l0_dev->noInterruptCount * vl53l0_dev->delay_ms) >
+			 watchdogMs) {
+			STMVL53L0_STAT_INC(vl53l0_dev, watchdogRestarts);
+			Status = PAPI(ClearInterruptMask)(vl53l0_dev,
 								   0);
 			if (vl53l0_dev->deviceMode ==
 			 VL53L0_DEVICEMODE_SINGLE_RANGING) {
-				Status = papi_func_tbl->StartMeasurement(
+				Status = PAPI(StartMeasurement)(
 							vl53l0_dev);
 				if (Status != VL53L0_ERROR_NONE) {
-					pr_err("%s(%d) : Status = %d\n",
+					pr_err_ratelimited(
+						"%s(%d) : Status = %d\n",
 						 __func__, __LINE__, Status);
 				}
 			}
+			/* recurring in a slow mode, traced, not logged */
+			trace_stmvl53l0_watchdog(vl53l0_dev->noInterruptCount *
+				vl53l0_dev->delay_ms, watchdogMs, Status);
 		}
 		mutex_unlock(&vl53l0_dev->work_mutex);
 		/* Sleep for delay_ms milliseconds */
@@ -816,6 +1183,13 @@ static void stmvl53l0_work_handler(struct work_struct *work)
 	VL53L0_DEV vl53l0_dev = data;
 
 	VL53L0_Error Status = VL53L0_ERROR_NONE;
+	int bucket;
+
+	if (ktime_to_ns(data->scheduleTime) != 0) {
+		bucket = stmvl53l0_stats_bucket(data->scheduleTime);
+		STMVL53L0_STAT_INC(data, queueDelay[bucket]);
+		data->scheduleTime = ktime_set(0, 0);
+	}
 
 	mutex_lock(&data->work_mutex);
 	/* vl53l0_dbgmsg("Enter\n"); */
@@ -828,46 +1202,45 @@ static void stmvl53l0_work_handler(struct work_struct *work)
 #endif
 		/* Check if ISR has scheduled this function */
 		if (vl53l0_dev->interrupt_received == 1) {
-			Status = papi_func_tbl->GetInterruptMaskStatus(
+			Status = PAPI(GetInterruptMaskStatus)(
 					vl53l0_dev,
 					&vl53l0_dev->interruptStatus);
 			if (Status != VL53L0_ERROR_NONE)
-				pr_err("%s(%d) : Status = %d\n",
-						 __func__, __LINE__, Status);
+				vl53l0_errmsg("%d, Status = %d\n",
+						__LINE__, Status);
 			vl53l0_dev->interrupt_received = 0;
 		}
-		if (data->enableDebug)
-			pr_err("interruptStatus:0x%x, interrupt_received:%d\n",
-				vl53l0_dev->interruptStatus,
-				vl53l0_dev->interrupt_received);
-
-		vl53l0_dbgmsg("before interruptStatus==gpio_function\n");
 
 		if (vl53l0_dev->interruptStatus == vl53l0_dev->gpio_function) {
-			vl53l0_dbgmsg("before GetRangingMeasurementData\n");
 			Status =
-				papi_func_tbl->GetRangingMeasurementData(
+				PAPI(GetRangingMeasurementData)(
 						vl53l0_dev,
 						&(data->rangeData));
+			trace_stmvl53l0_range_result(Status, &data->rangeData);
 			/* to push the measurement */
 			if (Status == VL53L0_ERROR_NONE) {
-				stmvl53l0_ps_read_measurement(data);
-				pr_err("after GetRangingMeasurementData OK\n");
+				stmvl53l0_stats_sample(data);
+				stmvl53l0_range_publish(data);
+				stmvl53l0_iio_push(data);
+				stmvl53l0_rate_update(data);
+				/* a proximity transition is always reported */
+				if (data->proximity.farMm == 0)
+					stmvl53l0_ps_read_measurement(data, 0);
+				else if (stmvl53l0_proximity_event(data))
+					stmvl53l0_ps_read_measurement(data, 1);
+				stmvl53l0_governor_update(data);
 			} else {
-				pr_err("%s(%d) : Status = %d\n",
-						__func__, __LINE__, Status);
-				pr_err("after GetRangingMeasurementData NG\n");
+				STMVL53L0_STAT_INC(data, rangeErrors);
+				vl53l0_errmsg(
+				"GetRangingMeasurementData failed, Status = %d\n",
+					Status);
 			}
 
-			/*if (data->enableDebug)*/
-				vl53l0_dbgmsg("Measured range:%d\n",
-					data->rangeData.RangeMilliMeter);
-
-			Status = papi_func_tbl->ClearInterruptMask(
+			Status = PAPI(ClearInterruptMask)(
 					vl53l0_dev, 0);
 			if (Status != VL53L0_ERROR_NONE) {
-				pr_err("%s(%d) : Status = %d\n",
-						__func__, __LINE__, Status);
+				vl53l0_errmsg("%d, Status = %d\n",
+						__LINE__, Status);
 			}
 
 			if (data->deviceMode ==
@@ -888,7 +1261,7 @@ static void stmvl53l0_work_handler(struct work_struct *work)
 					}
 				}
 				Status =
-					papi_func_tbl->StartMeasurement(
+					PAPI(StartMeasurement)(
 							vl53l0_dev);
 			}
 		}
@@ -905,6 +1278,57 @@ static void stmvl53l0_work_handler(struct work_struct *work)
 
 }
 
+/* histogram capture work handler */
+static void stmvl53l0_histo_work_handler(struct work_struct *work)
+{
+	struct stmvl53l0_data *data = container_of(work, struct stmvl53l0_data,
+				histo_work.work);
+	VL53L0_DEV vl53l0_dev = data;
+	struct stmvl53l0_histo_ring *ring = data->histoRing;
+	struct stmvl53l0_histo_slot *slot;
+	struct timeval tv;
+	uint32_t head;
+
+	mutex_lock(&data->work_mutex);
+
+	if (data->histoCapture == 0) {
+		mutex_unlock(&data->work_mutex);
+		return;
+	}
+
+	head = ring->head;
+	/* the reader did not release the oldest slot, overwrite it */
+	if ((head - ACCESS_ONCE(ring->tail)) >= STMVL53L0_HISTO_RING_SLOTS)
+		ring->overrun++;
+
+	/* bins are read by the PAL straight into the shared slot */
+	slot = &ring->slot[head % STMVL53L0_HISTO_RING_SLOTS];
+	slot->seq = 0;
+	smp_wmb();
+	slot->histo.BufferSize = VL53L0_HISTOGRAM_BUFFER_SIZE;
+	slot->status = PAPI(PerformSingleHistogramMeasurement)(
+			vl53l0_dev, &slot->histo);
+	do_gettimeofday(&tv);
+	slot->tv_sec = tv.tv_sec;
+	slot->tv_usec = tv.tv_usec;
+	smp_wmb();
+	slot->seq = head + 1;
+	smp_wmb();
+	ring->head = head + 1;
+
+	if (slot->status != VL53L0_ERROR_NONE) {
+		vl53l0_errmsg("histogram measurement failed, Status = %d\n",
+			slot->status);
+		/* back off before retrying a failing device */
+		schedule_delayed_work(&data->histo_work,
+			msecs_to_jiffies(data->delay_ms));
+	} else {
+		schedule_delayed_work(&data->histo_work, 0);
+	}
+
+	mutex_unlock(&data->work_mutex);
+}
+
 
 /*
  * SysFS support
@@ -1025,6 +1449,7 @@ static ssize_t stmvl53l0_store_set_delay_ms(struct device *dev,
 	}
 	mutex_lock(&data->work_mutex);
 	data->delay_ms = delay_ms;
+	stmvl53l0_auto_budget_update(data);
 	mutex_unlock(&data->work_mutex);
 
 	return count;
@@ -1084,6 +1509,8 @@ static ssize_t stmvl53l0_show_use_case(struct device *dev,
 		return snprintf(buf, 20, "High Accuracy\n");
 	case USE_CASE_HIGH_SPEED:
 		return snprintf(buf, 20, "High Speed\n");
+	case USE_CASE_ULTRA_HIGH_SPEED:
+		return snprintf(buf, 20, "Ultra High Speed\n");
 	default:
 		break;
 	}
@@ -1111,6 +1538,8 @@ static ssize_t stmvl53l0_store_set_use_case(struct device *dev,
 		data->timingBudget = HIGH_SPEED_TIMING_BUDGET;
 	} else if (useCase == USE_CASE_HIGH_ACCURACY) {
 		data->timingBudget = HIGH_ACCURACY_TIMING_BUDGET;
+	} else if (useCase == USE_CASE_ULTRA_HIGH_SPEED) {
+		data->timingBudget = ULTRA_HIGH_SPEED_TIMING_BUDGET;
 	} else {
 		count = -EINVAL;
 		mutex_unlock(&data->work_mutex);
@@ -1118,6 +1547,7 @@ static ssize_t stmvl53l0_store_set_use_case(struct device *dev,
 	}
 
 	data->useCase = useCase;
+	stmvl53l0_auto_budget_update(data);
 	mutex_unlock(&data->work_mutex);
 
 	return count;
@@ -1129,235 +1559,561 @@ static DEVICE_ATTR(set_use_case, 0660/*S_IWUGO | S_IRUGO*/,
 					stmvl53l0_store_set_use_case);
 
 
-/* Get Current configuration info */
-static ssize_t stmvl53l0_show_current_configuration(struct device *dev,
-				struct device_attribute *attr, char *buf)
+/* Read the current configuration from the device */
+static VL53L0_Error stmvl53l0_cfg_mirror_read(struct stmvl53l0_data *data,
+				struct stmvl53l0_cfg_mirror *cfg)
 {
-	struct stmvl53l0_data *vl53l0_dev = dev_get_drvdata(dev);
+	VL53L0_DEV vl53l0_dev = data;
 	VL53L0_Error Status = VL53L0_ERROR_NONE;
-	int ret = -1;
-	FixPoint1616_t	LimitValue = 0;
-	uint8_t LimitEnable = 0;
-	uint32_t refSpadCount = 0;
-	uint8_t isApertureSpads = 0;
-	uint8_t VhvSettings = 0;
-	uint8_t PhaseCal = 0;
-	uint8_t pulsePeriod = 0;
-	uint32_t timingBudget = 0;
-	int32_t offsetCalibrationDataMicroMeter = -1;
-	uint8_t XTalkCompensationEnable = 0;
-	FixPoint1616_t xTalkCompensationRateMegaCps = 0;
+	uint16_t check;
 
+	memset(cfg, 0, sizeof(*cfg));
 
-	ret = scnprintf(buf, PAGE_SIZE, "VL53L0 current configuration:\n");
+	for (check = 0; check < STMVL53L0_CFG_LIMIT_CHECKS; check++) {
+		if (Status == VL53L0_ERROR_NONE)
+			Status = PAPI(GetLimitCheckValue)(vl53l0_dev,
+					check, &cfg->limitValue[check]);
+		if (Status == VL53L0_ERROR_NONE)
+			Status = PAPI(GetLimitCheckEnable)(vl53l0_dev,
+					check, &cfg->limitEnable[check]);
+	}
 
-	mutex_lock(&vl53l0_dev->work_mutex);
-	pr_err("Driver Config:UseCase:%d, offsetCalDistance:%u,xtalkCalDistance:%u,setCalibratedValue:0x%X\n",
-			vl53l0_dev->useCase, vl53l0_dev->offsetCalDistance,
-			vl53l0_dev->xtalkCalDistance,
-			vl53l0_dev->setCalibratedValue);
+	if (Status == VL53L0_ERROR_NONE)
+		Status = PAPI(GetRefCalibration)(vl53l0_dev,
+				&cfg->vhvSettings, &cfg->phaseCal);
 
-	ret += scnprintf(buf + ret, PAGE_SIZE - ret,
-			"Driver Config:UseCase:%d, offsetCalDistance:%u,xtalkCalDistance:%u,setCalibratedValue:0x%X\n",
-			vl53l0_dev->useCase,
-			vl53l0_dev->offsetCalDistance,
-			vl53l0_dev->xtalkCalDistance,
-			vl53l0_dev->setCalibratedValue);
-
-	if (vl53l0_dev->useCase == USE_CASE_CUSTOM) {
-		pr_err("CustomUseCase : Sigma=%u :Signal=%u: Pre=%u :Final=%u\n",
-					vl53l0_dev->sigmaLimit,
-					vl53l0_dev->signalRateLimit,
-					vl53l0_dev->preRangePulsePeriod,
-					vl53l0_dev->finalRangePulsePeriod);
+	if (Status == VL53L0_ERROR_NONE)
+		Status = PAPI(GetReferenceSpads)(vl53l0_dev,
+				&cfg->refSpadCount, &cfg->isApertureSpads);
 
-		ret += scnprintf(buf + ret, PAGE_SIZE - ret,
-				"CustomUseCase : Sigma=%u :Signal=%u: Pre=%u :Final=%u\n",
-					vl53l0_dev->sigmaLimit,
-					vl53l0_dev->signalRateLimit,
-					vl53l0_dev->preRangePulsePeriod,
-					vl53l0_dev->finalRangePulsePeriod);
-	}
+	if (Status == VL53L0_ERROR_NONE)
+		Status = PAPI(GetMeasurementTimingBudgetMicroSeconds)(
+				vl53l0_dev, &cfg->timingBudget);
 
+	if (Status == VL53L0_ERROR_NONE)
+		Status = PAPI(GetVcselPulsePeriod)(vl53l0_dev,
+				VL53L0_VCSEL_PERIOD_PRE_RANGE,
+				&cfg->preRangePulsePeriod);
 
-	Status = papi_func_tbl->GetLimitCheckValue(vl53l0_dev,
-					VL53L0_CHECKENABLE_SIGMA_FINAL_RANGE,
-					&LimitValue);
+	if (Status == VL53L0_ERROR_NONE)
+		Status = PAPI(GetVcselPulsePeriod)(vl53l0_dev,
+				VL53L0_VCSEL_PERIOD_FINAL_RANGE,
+				&cfg->finalRangePulsePeriod);
 
-	if (Status == VL53L0_ERROR_NONE) {
-		Status = papi_func_tbl->GetLimitCheckEnable(vl53l0_dev,
-					VL53L0_CHECKENABLE_SIGMA_FINAL_RANGE,
-					&LimitEnable);
-	}
+	if (Status == VL53L0_ERROR_NONE)
+		Status = PAPI(GetOffsetCalibrationDataMicroMeter)(
+				vl53l0_dev, &cfg->offsetMicroMeter);
 
-	if (Status == VL53L0_ERROR_NONE) {
-		pr_err("Get LimitCheckValue SIGMA_FINAL_RANGE as:%d,Enable:%d\n",
-				(LimitValue>>16), LimitEnable);
-		ret	+= scnprintf(buf + ret, PAGE_SIZE - ret,
-					 "Sigma Limit:%u, Enable:%u\n",
-					(LimitValue>>16),
-					 LimitEnable);
-		Status = papi_func_tbl->GetLimitCheckValue(vl53l0_dev,
-				VL53L0_CHECKENABLE_SIGNAL_RATE_FINAL_RANGE,
-				&LimitValue);
-		Status = papi_func_tbl->GetLimitCheckEnable(vl53l0_dev,
-				VL53L0_CHECKENABLE_SIGNAL_RATE_FINAL_RANGE,
-				&LimitEnable);
-	}
+	if (Status == VL53L0_ERROR_NONE)
+		Status = PAPI(GetXTalkCompensationEnable)(vl53l0_dev,
+				&cfg->xtalkEnable);
 
-	if (Status == VL53L0_ERROR_NONE) {
-		pr_err("Get LimitCheckValue SIGNAL_FINAL_RANGE as:%d(Fix1616),Enable:%d\n",
-				(LimitValue), LimitEnable);
-		ret += scnprintf(buf + ret, PAGE_SIZE - ret,
-							 "SIGNAL Limit:%u, Enable:%u\n",
-							LimitValue,
-							LimitEnable);
+	if (Status == VL53L0_ERROR_NONE)
+		Status = PAPI(GetXTalkCompensationRateMegaCps)(
+				vl53l0_dev, &cfg->xtalkRateMegaCps);
 
-		Status = papi_func_tbl->GetLimitCheckValue(vl53l0_dev,
-				VL53L0_CHECKENABLE_SIGNAL_REF_CLIP,
-				&LimitValue);
-		Status = papi_func_tbl->GetLimitCheckEnable(vl53l0_dev,
-				VL53L0_CHECKENABLE_SIGNAL_REF_CLIP,
-				&LimitEnable);
+	cfg->status = Status;
+	cfg->valid = (Status == VL53L0_ERROR_NONE);
 
-	}
+	return Status;
+}
 
-	if (Status == VL53L0_ERROR_NONE) {
-		pr_err("Get LimitCheckValue SIGNAL_REF_CLIP as:%d(fix1616),Enable:%d\n",
-				(LimitValue), LimitEnable);
-		ret += scnprintf(buf + ret, PAGE_SIZE - ret,
-					"RefClipLimit:%u, Enable:%u\n",
-					LimitValue,
-					LimitEnable);
+/*
+ * Read the whole configuration mirror back, with work_mutex held. The
+ * Set paths record what they write instead; this is only needed when
+ * the mirror is stale, after an initialization, a calibration or a raw
+ * register write.
+ */
+static void stmvl53l0_cfg_mirror_update(struct stmvl53l0_data *data)
+{
+	struct stmvl53l0_cfg_mirror cfg;
 
-		Status = papi_func_tbl->GetLimitCheckValue(vl53l0_dev,
-				VL53L0_CHECKENABLE_RANGE_IGNORE_THRESHOLD,
-				&LimitValue);
-		Status = papi_func_tbl->GetLimitCheckEnable(vl53l0_dev,
-				VL53L0_CHECKENABLE_RANGE_IGNORE_THRESHOLD,
-				&LimitEnable);
-	}
+	if (stmvl53l0_cfg_mirror_read(data, &cfg) == VL53L0_ERROR_NONE)
+		data->cfgMirror = cfg;
+	else
+		data->cfgMirror.status = cfg.status;
 
-	if (Status == VL53L0_ERROR_NONE) {
-		pr_err(
-	"Get LimitCheckValue RANGE_IGNORE_THRESHOLDas:%d(fix1616),Enable:%d\n",
-				(LimitValue),
-				LimitEnable);
-		ret += scnprintf(buf + ret, PAGE_SIZE - ret,
-				 "RngIgnoreThresh:%u, Enable:%u\n",
-				LimitValue,
-				LimitEnable);
+	vl53l0_dbgmsg("cfg mirror refreshed, status %d\n", cfg.status);
+}
 
-		Status = papi_func_tbl->GetRefCalibration(vl53l0_dev,
-				&VhvSettings, &PhaseCal); /* Ref calibration */
+static int stmvl53l0_cfg_mirror_print(const struct stmvl53l0_cfg_mirror *cfg,
+				char *buf, int ret)
+{
+	ret += scnprintf(buf + ret, PAGE_SIZE - ret,
+			"Sigma Limit:%u, Enable:%u\n",
+			cfg->limitValue[VL53L0_CHECKENABLE_SIGMA_FINAL_RANGE]
+				>> 16,
+			cfg->limitEnable[VL53L0_CHECKENABLE_SIGMA_FINAL_RANGE]);
+	ret += scnprintf(buf + ret, PAGE_SIZE - ret,
+			"SIGNAL Limit:%u, Enable:%u\n",
+		cfg->limitValue[VL53L0_CHECKENABLE_SIGNAL_RATE_FINAL_RANGE],
+		cfg->limitEnable[VL53L0_CHECKENABLE_SIGNAL_RATE_FINAL_RANGE]);
+	ret += scnprintf(buf + ret, PAGE_SIZE - ret,
+			"RefClipLimit:%u, Enable:%u\n",
+			cfg->limitValue[VL53L0_CHECKENABLE_SIGNAL_REF_CLIP],
+			cfg->limitEnable[VL53L0_CHECKENABLE_SIGNAL_REF_CLIP]);
+	ret += scnprintf(buf + ret, PAGE_SIZE - ret,
+			"RngIgnoreThresh:%u, Enable:%u\n",
+		cfg->limitValue[VL53L0_CHECKENABLE_RANGE_IGNORE_THRESHOLD],
+		cfg->limitEnable[VL53L0_CHECKENABLE_RANGE_IGNORE_THRESHOLD]);
+	ret += scnprintf(buf + ret, PAGE_SIZE - ret, "Vhv:%u, PhCal:%u\n",
+			cfg->vhvSettings, cfg->phaseCal);
+	ret += scnprintf(buf + ret, PAGE_SIZE - ret,
+			"SpadCount:%u, IsAperture:%u\n",
+			cfg->refSpadCount, cfg->isApertureSpads);
+	ret += scnprintf(buf + ret, PAGE_SIZE - ret, "TimBudget:%u\n",
+			cfg->timingBudget);
+	ret += scnprintf(buf + ret, PAGE_SIZE - ret, "PulsePreRange:%u\n",
+			cfg->preRangePulsePeriod);
+	ret += scnprintf(buf + ret, PAGE_SIZE - ret, "PulseFinalRange:%u\n",
+			cfg->finalRangePulsePeriod);
+	ret += scnprintf(buf + ret, PAGE_SIZE - ret, "Offset:%d\n",
+			cfg->offsetMicroMeter);
+	ret += scnprintf(buf + ret, PAGE_SIZE - ret, "XtalkEnable:%u\n",
+			cfg->xtalkEnable);
+	ret += scnprintf(buf + ret, PAGE_SIZE - ret, "XtalkMcps:%u\n",
+			cfg->xtalkRateMegaCps);
 
+	return ret;
+}
 
-	}
+#define CFG_VERIFY(field) \
+	do { \
+		if (mirror->field != live->field) \
+			ret += scnprintf(buf + ret, PAGE_SIZE - ret, \
+				"Verify:" #field " mirror:%d live:%d\n", \
+				(int)mirror->field, (int)live->field); \
+	} while (0)
+
+static int stmvl53l0_cfg_mirror_verify(const struct stmvl53l0_cfg_mirror *mirror,
+				const struct stmvl53l0_cfg_mirror *live,
+				char *buf, int ret)
+{
+	int start = ret;
+	int i;
 
-	if (Status == VL53L0_ERROR_NONE) {
-		pr_err("GetRefCalibration - Vhv = %u, PhaseCal = %u\n",
-						VhvSettings, PhaseCal);
-		ret += scnprintf(buf + ret, PAGE_SIZE - ret,
-					"Vhv:%u, PhCal:%u\n",
-					VhvSettings,
-					PhaseCal);
+	if (live->status != VL53L0_ERROR_NONE)
+		return ret + scnprintf(buf + ret, PAGE_SIZE - ret,
+				"Verify:Error:%d\n", live->status);
 
-		/* Ref Spad Management */
-		Status = papi_func_tbl->GetReferenceSpads(vl53l0_dev,
-			&refSpadCount, &isApertureSpads);
+	for (i = 0; i < STMVL53L0_CFG_LIMIT_CHECKS; i++) {
+		CFG_VERIFY(limitValue[i]);
+		CFG_VERIFY(limitEnable[i]);
 	}
+	CFG_VERIFY(vhvSettings);
+	CFG_VERIFY(phaseCal);
+	CFG_VERIFY(refSpadCount);
+	CFG_VERIFY(isApertureSpads);
+	CFG_VERIFY(timingBudget);
+	CFG_VERIFY(preRangePulsePeriod);
+	CFG_VERIFY(finalRangePulsePeriod);
+	CFG_VERIFY(offsetMicroMeter);
+	CFG_VERIFY(xtalkEnable);
+	CFG_VERIFY(xtalkRateMegaCps);
+
+	if (ret == start)
+		ret += scnprintf(buf + ret, PAGE_SIZE - ret, "Verify:OK\n");
 
-	if (Status == VL53L0_ERROR_NONE) {
-		pr_err("GetSpads - Count = %u, IsAperture = %u\n",
-						refSpadCount, isApertureSpads);
-		ret += scnprintf(buf + ret, PAGE_SIZE - ret,
-						"SpadCount:%u, IsAperture:%u\n",
-						refSpadCount,
-						isApertureSpads);
+	return ret;
+}
 
-		Status = papi_func_tbl->GetMeasurementTimingBudgetMicroSeconds(
-					vl53l0_dev,
-					&timingBudget);
-	}
+#undef CFG_VERIFY
 
-	if (Status == VL53L0_ERROR_NONE) {
-		pr_err("TimingBudget = %u\n", timingBudget);
-		ret += scnprintf(buf + ret, PAGE_SIZE - ret, "TimBudget:%u\n",
-								timingBudget);
-		Status = papi_func_tbl->GetVcselPulsePeriod(vl53l0_dev,
-					VL53L0_VCSEL_PERIOD_PRE_RANGE,
-					&pulsePeriod);
-	}
+/* Get Current configuration info */
+static ssize_t stmvl53l0_show_current_configuration(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct stmvl53l0_data *vl53l0_dev = dev_get_drvdata(dev);
+	struct stmvl53l0_cfg_mirror cfg;
+	struct stmvl53l0_cfg_mirror live;
+	uint8_t useCase, verify;
+	unsigned int offsetCalDistance, xtalkCalDistance;
+	unsigned int setCalibratedValue;
+	struct stmvl53l0_custom_use_case custom;
+	int ret = -1;
 
-	if (Status == VL53L0_ERROR_NONE) {
-		pr_err("GetVcselPulsePeriod - PRE_RANGE = %u\n",
-						pulsePeriod);
-		ret += scnprintf(buf + ret, PAGE_SIZE - ret,
-					 "PulsePreRange:%u\n",
-					pulsePeriod);
+	/*
+	 * Served from the mirror, the device is only accessed in verify
+	 * mode or to refresh a stale mirror. The lock is only held to take
+	 * a consistent snapshot.
+	 */
+	mutex_lock(&vl53l0_dev->work_mutex);
+	if (vl53l0_dev->cfgMirror.stale)
+		stmvl53l0_cfg_mirror_update(vl53l0_dev);
+	cfg = vl53l0_dev->cfgMirror;
+	useCase = vl53l0_dev->useCase;
+	offsetCalDistance = vl53l0_dev->offsetCalDistance;
+	xtalkCalDistance = vl53l0_dev->xtalkCalDistance;
+	setCalibratedValue = vl53l0_dev->setCalibratedValue;
+	custom.sigmaLimit = vl53l0_dev->sigmaLimit;
+	custom.signalRateLimit = vl53l0_dev->signalRateLimit;
+	custom.preRangePulsePeriod = vl53l0_dev->preRangePulsePeriod;
+	custom.finalRangePulsePeriod = vl53l0_dev->finalRangePulsePeriod;
+	verify = vl53l0_dev->cfgVerify;
+	if (verify)
+		stmvl53l0_cfg_mirror_read(vl53l0_dev, &live);
+	mutex_unlock(&vl53l0_dev->work_mutex);
 
-		Status = papi_func_tbl->GetVcselPulsePeriod(vl53l0_dev,
-					VL53L0_VCSEL_PERIOD_FINAL_RANGE,
-					&pulsePeriod);
-	}
+	ret = scnprintf(buf, PAGE_SIZE, "VL53L0 current configuration:\n");
 
-	if (Status == VL53L0_ERROR_NONE) {
-		pr_err("GetVcselPulsePeriod - FINAL_RANGE = %u\n",
-						pulsePeriod);
+	ret += scnprintf(buf + ret, PAGE_SIZE - ret,
+			"Driver Config:UseCase:%d, offsetCalDistance:%u,xtalkCalDistance:%u,setCalibratedValue:0x%X\n",
+			useCase,
+			offsetCalDistance,
+			xtalkCalDistance,
+			setCalibratedValue);
+
+	if (useCase == USE_CASE_CUSTOM) {
 		ret += scnprintf(buf + ret, PAGE_SIZE - ret,
-				 "PulseFinalRange:%u\n",
-				pulsePeriod);
+				"CustomUseCase : Sigma=%u :Signal=%u: Pre=%u :Final=%u\n",
+					custom.sigmaLimit,
+					custom.signalRateLimit,
+					custom.preRangePulsePeriod,
+					custom.finalRangePulsePeriod);
+	}
 
-		Status = papi_func_tbl->GetOffsetCalibrationDataMicroMeter(
-				vl53l0_dev,
-				&offsetCalibrationDataMicroMeter);
+	if (cfg.valid)
+		ret = stmvl53l0_cfg_mirror_print(&cfg, buf, ret);
+
+	if (cfg.status != VL53L0_ERROR_NONE || !cfg.valid)
+		ret += scnprintf(buf + ret, PAGE_SIZE - ret, "Error:%d\n",
+					cfg.status);
+
+	if (verify)
+		ret = stmvl53l0_cfg_mirror_verify(&cfg, &live, buf, ret);
+
+	vl53l0_dbgmsg("Total Bytes returned = %d\n", ret);
+
+	return ret;
+}
+
+/* Writing 1 enables the comparison of the mirror with the device */
+static ssize_t stmvl53l0_store_current_configuration(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t count)
+{
+	struct stmvl53l0_data *data = dev_get_drvdata(dev);
+	unsigned long verify = 0;
+	int ret = kstrtoul(buf, 10, &verify);
+
+	if (ret != 0)
+		return ret;
+	if (verify > 1) {
+		vl53l0_errmsg("verify=%lu, should be 0 or 1\n", verify);
+		return -EINVAL;
 	}
 
-	if (Status == VL53L0_ERROR_NONE) {
-		pr_err("OffsetCalibrationDataMicroMeter = %d\n",
-				 offsetCalibrationDataMicroMeter);
-		ret += scnprintf(buf + ret, PAGE_SIZE - ret, "Offset:%d\n",
-					offsetCalibrationDataMicroMeter);
+	mutex_lock(&data->work_mutex);
+	data->cfgVerify = verify;
+	mutex_unlock(&data->work_mutex);
 
-		Status = papi_func_tbl->GetXTalkCompensationEnable(vl53l0_dev,
-					&XTalkCompensationEnable);
+	return count;
+}
+
+/* DEVICE_ATTR(name,mode,show,store) */
+static DEVICE_ATTR(show_current_configuration, 0660/*S_IWUGO | S_IRUGO*/,
+				   stmvl53l0_show_current_configuration,
+					stmvl53l0_store_current_configuration);
+
+/* Range filter: mode medianLen alpha beta rejectMask deadbandMm heartbeatMs */
+static ssize_t stmvl53l0_show_filter(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct stmvl53l0_data *data = dev_get_drvdata(dev);
+	struct stmvl53l0_filter filter;
+
+	mutex_lock(&data->work_mutex);
+	filter = data->filter;
+	mutex_unlock(&data->work_mutex);
+
+	return scnprintf(buf, PAGE_SIZE,
+			"%u %u %u %u 0x%x %u %u\nsamples:%u rejected:%u suppressed:%u reported:%u\n",
+			filter.mode, filter.medianLen,
+			filter.alpha, filter.beta,
+			filter.rejectMask, filter.deadbandMm,
+			filter.heartbeatMs,
+			filter.samples, filter.rejected,
+			filter.suppressed, filter.reported);
+}
+
+static ssize_t stmvl53l0_store_set_filter(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t count)
+{
+	struct stmvl53l0_data *data = dev_get_drvdata(dev);
+	unsigned int mode, medianLen, alpha, beta;
+	unsigned int rejectMask, deadbandMm, heartbeatMs;
+
+	if (sscanf(buf, "%u %u %u %u %x %u %u", &mode, &medianLen,
+			&alpha, &beta, &rejectMask, &deadbandMm,
+			&heartbeatMs) != 7) {
+		vl53l0_errmsg("invalid format\n");
+		return -EINVAL;
+	}
+	if (mode > STMVL53L0_FILTER_ALPHA_BETA ||
+		medianLen == 0 || medianLen > STMVL53L0_FILTER_MEDIAN_MAX ||
+		(medianLen & 1) == 0 || alpha > 256 || beta > 256 ||
+		deadbandMm > 0xFFFF) {
+		vl53l0_errmsg("invalid filter configuration\n");
+		return -EINVAL;
 	}
 
-	if (Status == VL53L0_ERROR_NONE) {
-		pr_err("Xtalk Enable = %u\n", XTalkCompensationEnable);
-		ret += scnprintf(buf + ret, PAGE_SIZE - ret, "XtalkEnable:%u\n",
-					XTalkCompensationEnable);
+	mutex_lock(&data->work_mutex);
+	data->filter.mode = mode;
+	data->filter.medianLen = medianLen;
+	data->filter.alpha = alpha;
+	data->filter.beta = beta;
+	data->filter.rejectMask = rejectMask;
+	data->filter.deadbandMm = deadbandMm;
+	data->filter.heartbeatMs = heartbeatMs;
+	stmvl53l0_filter_reset(&data->filter);
+	mutex_unlock(&data->work_mutex);
 
-		Status = papi_func_tbl->GetXTalkCompensationRateMegaCps(
-					vl53l0_dev,
-					&xTalkCompensationRateMegaCps);
+	return count;
+}
+
+/* DEVICE_ATTR(name,mode,show,store) */
+static DEVICE_ATTR(set_filter, 0660/*S_IWUGO | S_IRUGO*/,
+				   stmvl53l0_show_filter,
+					stmvl53l0_store_set_filter);
+
+/* Proximity mode: nearMm farMm interMeasurementMs, "0 0 0" disables */
+static ssize_t stmvl53l0_show_proximity(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct stmvl53l0_data *data = dev_get_drvdata(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%u %u %u\nstate:%u\n",
+			data->proximity.nearMm, data->proximity.farMm,
+			data->proximity.interMeasurementMs,
+			data->proximityState);
+}
+
+static ssize_t stmvl53l0_store_set_proximity(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t count)
+{
+	struct stmvl53l0_data *data = dev_get_drvdata(dev);
+	struct stmvl53l0_proximity proximity;
+	int ret;
+
+	if (sscanf(buf, "%u %u %u", &proximity.nearMm, &proximity.farMm,
+			&proximity.interMeasurementMs) != 3) {
+		vl53l0_errmsg("invalid format\n");
+		return -EINVAL;
 	}
 
+	mutex_lock(&data->work_mutex);
+	ret = stmvl53l0_set_proximity(data, &proximity);
+	mutex_unlock(&data->work_mutex);
 
-	if (Status == VL53L0_ERROR_NONE) {
-		pr_err("XtalkComp MCPS = %u\n", xTalkCompensationRateMegaCps);
-		ret += scnprintf(buf + ret, PAGE_SIZE - ret, "XtalkMcps:%u\n",
-					xTalkCompensationRateMegaCps);
+	return ret ? ret : count;
+}
 
-	} else {
-		pr_err("Error = %d\n", Status);
-		ret += scnprintf(buf + ret, PAGE_SIZE - ret, "Error:%d\n",
-					Status);
+/* DEVICE_ATTR(name,mode,show,store) */
+static DEVICE_ATTR(set_proximity, 0660/*S_IWUGO | S_IRUGO*/,
+				   stmvl53l0_show_proximity,
+					stmvl53l0_store_set_proximity);
+
+/* Timing budget derived from set_delay_ms: 0 or 1 */
+static ssize_t stmvl53l0_show_auto_budget(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct stmvl53l0_data *data = dev_get_drvdata(dev);
+	uint32_t periodUs;
+
+	/* a sample takes at least the budget plus the host overhead */
+	periodUs = max_t(uint32_t, data->delay_ms * 1000,
+			data->timingBudget + AUTO_BUDGET_MARGIN_US);
 
+	return scnprintf(buf, PAGE_SIZE,
+			"%u\nTimBudget:%u InterMeasurement:%u ms Rate:%u Hz\n",
+			data->autoBudget, data->timingBudget,
+			data->interMeasurems, 1000000 / periodUs);
+}
+
+static ssize_t stmvl53l0_store_set_auto_budget(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t count)
+{
+	struct stmvl53l0_data *data = dev_get_drvdata(dev);
+	unsigned long on = 0;
+	int ret = kstrtoul(buf, 10, &on);
+
+	if (ret != 0)
+		return ret;
+	if (on > 1) {
+		vl53l0_errmsg("set auto budget=%lu\n", on);
+		return -EINVAL;
 	}
 
-	pr_err("Total Bytes returned = %d\n", ret);
+	mutex_lock(&data->work_mutex);
+	data->autoBudget = on;
+	stmvl53l0_auto_budget_update(data);
+	mutex_unlock(&data->work_mutex);
 
-	mutex_unlock(&vl53l0_dev->work_mutex);
+	return count;
+}
 
+/* DEVICE_ATTR(name,mode,show,store) */
+static DEVICE_ATTR(set_auto_budget, 0660/*S_IWUGO | S_IRUGO*/,
+				   stmvl53l0_show_auto_budget,
+					stmvl53l0_store_set_auto_budget);
 
-	return ret;
+/* Output rate measured over the last samples */
+static ssize_t stmvl53l0_show_measured_rate(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct stmvl53l0_data *data = dev_get_drvdata(dev);
+	uint32_t intervalUs = data->sampleIntervalUs;
+	uint32_t rateCentiHz = 0;
+
+	if (intervalUs != 0)
+		rateCentiHz = 100000000 / intervalUs;
+
+	return scnprintf(buf, PAGE_SIZE, "%u.%02u Hz, interval:%u us\n",
+			rateCentiHz / 100, rateCentiHz % 100, intervalUs);
 }
 
 /* DEVICE_ATTR(name,mode,show,store) */
-static DEVICE_ATTR(show_current_configuration, 0660/*S_IWUGO | S_IRUGO*/,
-				   stmvl53l0_show_current_configuration,
+static DEVICE_ATTR(measured_rate, 0440/*S_IRUGO*/,
+				   stmvl53l0_show_measured_rate,
+					NULL);
+
+/* Timing budget governor: enable [targetSigmaMm] */
+static ssize_t stmvl53l0_show_governor(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct stmvl53l0_data *data = dev_get_drvdata(dev);
+
+	return scnprintf(buf, PAGE_SIZE,
+			"%u %u\nTimBudget:%u stepsDown:%u stepsUp:%u\n",
+			data->governor.enable, data->governor.targetSigmaMm,
+			data->timingBudget, data->governor.stepsDown,
+			data->governor.stepsUp);
+}
+
+static ssize_t stmvl53l0_store_set_governor(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t count)
+{
+	struct stmvl53l0_data *data = dev_get_drvdata(dev);
+	unsigned int enable;
+	unsigned int targetSigmaMm = data->governor.targetSigmaMm;
+
+	if (sscanf(buf, "%u %u", &enable, &targetSigmaMm) < 1 ||
+		enable > 1 || targetSigmaMm == 0 ||
+		targetSigmaMm > STMVL53L0_GOVERNOR_SIGMA_MAX) {
+		vl53l0_errmsg("invalid governor configuration\n");
+		return -EINVAL;
+	}
+
+	mutex_lock(&data->work_mutex);
+	data->governor.enable = enable;
+	data->governor.targetSigmaMm = targetSigmaMm;
+	data->governor.upCount = 0;
+	data->governor.downCount = 0;
+	mutex_unlock(&data->work_mutex);
+
+	return count;
+}
+
+/* DEVICE_ATTR(name,mode,show,store) */
+static DEVICE_ATTR(set_governor, 0660/*S_IWUGO | S_IRUGO*/,
+				   stmvl53l0_show_governor,
+					stmvl53l0_store_set_governor);
+/* Energy estimate, per device and for the current or last session */
+static ssize_t stmvl53l0_energy_show_count(struct stmvl53l0_energy_count *count,
+				const char *name, char *buf, size_t size)
+{
+	u64 onUs = count->onUs;
+	u64 chargePc, energyUj;
+	uint32_t avgUa = 0, dutyBp = 0, sampleUj = 0;
+
+	/* include the on period in progress */
+	if (ktime_to_ns(count->onSince) != 0)
+		onUs += ktime_us_delta(ktime_get(), count->onSince);
+
+	chargePc = count->activeUs * STMVL53L0_RANGING_UA;
+	if (onUs > count->activeUs)
+		chargePc += (onUs - count->activeUs) * STMVL53L0_IDLE_UA;
+	energyUj = div_u64(div_u64(chargePc, 1000) * STMVL53L0_SUPPLY_MV,
+			1000000);
+	if (onUs != 0) {
+		avgUa = div64_u64(chargePc, onUs);
+		dutyBp = div64_u64(min(count->activeUs, onUs) * 10000, onUs);
+	}
+	if (count->samples != 0)
+		sampleUj = div_u64(energyUj, count->samples);
+
+	return scnprintf(buf, size,
+		"%s: samples:%u energy:%llu uJ perSample:%u uJ avg:%u uA duty:%u.%02u%% on:%llu ms\n",
+		name, count->samples, energyUj, sampleUj, avgUa,
+		dutyBp / 100, dutyBp % 100, div_u64(onUs, 1000));
+}
+
+static ssize_t stmvl53l0_show_energy(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct stmvl53l0_data *data = dev_get_drvdata(dev);
+	ssize_t len;
+
+	mutex_lock(&data->work_mutex);
+	len = stmvl53l0_energy_show_count(&data->energy.device, "device",
+			buf, PAGE_SIZE);
+	len += stmvl53l0_energy_show_count(&data->energy.session, "session",
+			buf + len, PAGE_SIZE - len);
+	len += scnprintf(buf + len, PAGE_SIZE - len,
+		"TimBudget:%u us VcselPeriod pre:%u final:%u cap:%u uA capPeriod:%u ms\n",
+		data->timingBudget, data->cfgMirror.preRangePulsePeriod,
+		data->cfgMirror.finalRangePulsePeriod, data->energy.capUa,
+		data->energy.capPeriodMs);
+	mutex_unlock(&data->work_mutex);
+
+	return len;
+}
+
+/* DEVICE_ATTR(name,mode,show,store) */
+static DEVICE_ATTR(energy, 0440/*S_IRUGO*/,
+				   stmvl53l0_show_energy,
 					NULL);
+
+/* Average current cap in uA, 0 for none, applied on the next start */
+static ssize_t stmvl53l0_show_power_cap(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct stmvl53l0_data *data = dev_get_drvdata(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n", data->energy.capUa);
+}
+
+static ssize_t stmvl53l0_store_set_power_cap(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t count)
+{
+	struct stmvl53l0_data *data = dev_get_drvdata(dev);
+	unsigned long capUa = 0;
+	int ret = kstrtoul(buf, 10, &capUa);
+
+	if (ret != 0)
+		return ret;
+	if (capUa != 0 && (capUa <= STMVL53L0_IDLE_UA ||
+		capUa > STMVL53L0_RANGING_UA)) {
+		vl53l0_errmsg("set power cap=%lu\n", capUa);
+		return -EINVAL;
+	}
+
+	mutex_lock(&data->work_mutex);
+	data->energy.capUa = capUa;
+	mutex_unlock(&data->work_mutex);
+
+	return count;
+}
+
+/* DEVICE_ATTR(name,mode,show,store) */
+static DEVICE_ATTR(set_power_cap, 0660/*S_IWUGO | S_IRUGO*/,
+				   stmvl53l0_show_power_cap,
+					stmvl53l0_store_set_power_cap);
 /* for work handler scheduler time */
 static ssize_t stmvl53l0_do_flush(struct device *dev,
 					struct device_attribute *attr,
@@ -1390,6 +2146,13 @@ static struct attribute *stmvl53l0_attributes[] = {
 	&dev_attr_set_use_case.attr,
 	&dev_attr_do_flush.attr,
 	&dev_attr_show_current_configuration.attr,
+	&dev_attr_set_filter.attr,
+	&dev_attr_set_proximity.attr,
+	&dev_attr_set_governor.attr,
+	&dev_attr_measured_rate.attr,
+	&dev_attr_set_auto_budget.attr,
+	&dev_attr_energy.attr,
+	&dev_attr_set_power_cap.attr,
 	NULL
 };
 
@@ -1398,6 +2161,561 @@ static const struct attribute_group stmvl53l0_attr_group = {
 	.attrs = stmvl53l0_attributes,
 };
 
+/*
+ * Get or set one parameter, with work_mutex held. The PAL status is
+ * returned in parameter->status.
+ */
+static void stmvl53l0_parameter_access(struct stmvl53l0_data *data,
+				struct stmvl53l0_parameter *parameter)
+{
+	VL53L0_DEV vl53l0_dev = data;
+	VL53L0_DeviceModes deviceMode;
+	VL53L0_Error Status = VL53L0_ERROR_NONE;
+
+	parameter->status = 0;
+	switch (parameter->name) {
+	case (OFFSET_PAR):
+		if (parameter->is_read)
+			parameter->status =
+		    PAPI(GetOffsetCalibrationDataMicroMeter)(
+					vl53l0_dev, &parameter->value);
+		else {
+			parameter->status =
+		    PAPI(SetOffsetCalibrationDataMicroMeter)(
+					vl53l0_dev, parameter->value);
+			  data->OffsetMicroMeter = parameter->value;
+			  data->setCalibratedValue
+		       |= SET_OFFSET_CALIB_DATA_MICROMETER_MASK;
+			if (parameter->status == VL53L0_ERROR_NONE)
+				data->cfgMirror.offsetMicroMeter =
+					parameter->value;
+
+		}
+		vl53l0_dbgmsg("get parameter value as %d\n",
+			 parameter->value);
+		break;
+
+	case (REFERENCESPADS_PAR):
+		if (parameter->is_read) {
+			parameter->status =
+			  PAPI(GetReferenceSpads)(vl53l0_dev,
+					(uint32_t *)&(parameter->value),
+			    (uint8_t *)&(parameter->value2));
+			if (data->enableDebug)
+				vl53l0_dbgmsg(
+					"Get RefSpad : Count:%u, Type:%u\n",
+					parameter->value,
+					(uint8_t)parameter->value2);
+		} else {
+			if (data->enableDebug)
+				vl53l0_dbgmsg(
+				"Set RefSpad : Count:%u, Type:%u\n",
+				parameter->value,
+				(uint8_t)parameter->value2);
+
+			parameter->status =
+			  PAPI(SetReferenceSpads)(vl53l0_dev,
+			(uint32_t)(parameter->value),
+			(uint8_t)(parameter->value2));
+
+			data->refSpadCount = parameter->value;
+			data->isApertureSpads =
+				(uint8_t)(parameter->value2);
+			if (parameter->status == VL53L0_ERROR_NONE) {
+				data->cfgMirror.refSpadCount =
+					data->refSpadCount;
+				data->cfgMirror.isApertureSpads =
+					data->isApertureSpads;
+			}
+		}
+		break;
+
+	case (REFCALIBRATION_PAR):
+		if (parameter->is_read) {
+			parameter->status =
+		     PAPI(GetRefCalibration)(vl53l0_dev,
+		     (uint8_t *)&(parameter->value),
+		     (uint8_t *)&(parameter->value2));
+				if (data->enableDebug)
+					vl53l0_dbgmsg(
+					"Get Ref : Vhv:%u, PhaseCal:%u\n",
+					(uint8_t)parameter->value,
+					(uint8_t)parameter->value2);
+		} else {
+			if (data->enableDebug)
+				vl53l0_dbgmsg(
+				"Set Ref : Vhv:%u, PhaseCal:%u\n",
+				(uint8_t)parameter->value,
+				(uint8_t)parameter->value2);
+				parameter->status =
+				    PAPI(SetRefCalibration)(
+				    vl53l0_dev,
+				    (uint8_t)(parameter->value),
+				    (uint8_t)(parameter->value2));
+			data->VhvSettings = (uint8_t)parameter->value;
+			data->PhaseCal    = (uint8_t)(parameter->value2);
+			if (parameter->status == VL53L0_ERROR_NONE) {
+				data->cfgMirror.vhvSettings =
+					data->VhvSettings;
+				data->cfgMirror.phaseCal = data->PhaseCal;
+			}
+		}
+		break;
+	case (XTALKRATE_PAR):
+		if (parameter->is_read)
+			parameter->status =
+			PAPI(GetXTalkCompensationRateMegaCps)(
+			    vl53l0_dev,
+			    (FixPoint1616_t *)
+			    &parameter->value);
+		else {
+			/* Range Ignore Threshold value */
+			FixPoint1616_t ritValue = 0;
+
+			parameter->status =
+		PAPI(SetXTalkCompensationRateMegaCps)(
+					vl53l0_dev,
+					(FixPoint1616_t)
+						parameter->value);
+			data->XTalkCompensationRateMegaCps =
+				 parameter->value;
+			data->setCalibratedValue |=
+				 SET_XTALK_COMP_RATE_MCPS_MASK;
+
+
+			/*0.7 KCps converted to MCps */
+			if (data->XTalkCompensationRateMegaCps <
+					 7*65536/10000) {
+				ritValue = 15 * 7 * 65536/100000;
+			} else {
+				ritValue = 15 *
+				vl53l0_dev->XTalkCompensationRateMegaCps
+						 /10;
+			}
+
+			if (PAPI_AVAILABLE(SetLimitCheckEnable)) {
+				Status =
+				PAPI(SetLimitCheckEnable)(
+				vl53l0_dev,
+			VL53L0_CHECKENABLE_RANGE_IGNORE_THRESHOLD,
+				1);
+			}
+
+			if ((Status == VL53L0_ERROR_NONE)  &&
+				(PAPI_AVAILABLE(SetLimitCheckValue))) {
+				vl53l0_dbgmsg(
+				"Set RIT - %u\n", ritValue);
+				Status =
+			PAPI(SetLimitCheckValue)(
+			vl53l0_dev,
+			VL53L0_CHECKENABLE_RANGE_IGNORE_THRESHOLD,
+			ritValue);
+			}
+
+			if (parameter->status == VL53L0_ERROR_NONE)
+				data->cfgMirror.xtalkRateMegaCps =
+					parameter->value;
+			if (Status == VL53L0_ERROR_NONE) {
+				data->cfgMirror.limitEnable[
+				VL53L0_CHECKENABLE_RANGE_IGNORE_THRESHOLD] = 1;
+				data->cfgMirror.limitValue[
+				VL53L0_CHECKENABLE_RANGE_IGNORE_THRESHOLD] =
+					ritValue;
+			}
+		}
+		break;
+	case (XTALKENABLE_PAR):
+		if (parameter->is_read)
+			parameter->status =
+			PAPI(GetXTalkCompensationEnable)(
+				vl53l0_dev,
+				(uint8_t *) &parameter->value);
+		else {
+			parameter->status =
+			PAPI(SetXTalkCompensationEnable)(
+			vl53l0_dev,
+			(uint8_t) parameter->value);
+			if (parameter->status == VL53L0_ERROR_NONE)
+				data->cfgMirror.xtalkEnable =
+					(uint8_t)parameter->value;
+		}
+		break;
+	case (GPIOFUNC_PAR):
+		if (parameter->is_read) {
+			parameter->status =
+			PAPI(GetGpioConfig)(
+				vl53l0_dev,
+				0,
+				&deviceMode,
+				&data->gpio_function,
+				&data->gpio_polarity);
+			parameter->value =
+				 data->gpio_function;
+		} else {
+			data->gpio_function = parameter->value;
+			parameter->status =
+			  PAPI(SetGpioConfig)(
+				vl53l0_dev,
+				 0,
+				 0,
+				data->gpio_function,
+				data->gpio_polarity);
+		}
+		break;
+	case (LOWTHRESH_PAR):
+		if (parameter->is_read) {
+			parameter->status =
+			  PAPI(GetInterruptThresholds)(
+				vl53l0_dev,
+				 0,
+				&(data->low_threshold),
+				&(data->high_threshold));
+			parameter->value =
+				 data->low_threshold >> 16;
+		} else {
+			data->low_threshold = parameter->value << 16;
+			parameter->status =
+			  PAPI(SetInterruptThresholds)(
+				vl53l0_dev,
+				 0,
+				data->low_threshold,
+				 data->high_threshold);
+		}
+		break;
+	case (HIGHTHRESH_PAR):
+		if (parameter->is_read) {
+			parameter->status =
+			  PAPI(GetInterruptThresholds)(
+				vl53l0_dev,
+				 0,
+				&(data->low_threshold),
+				 &(data->high_threshold));
+			parameter->value =
+				data->high_threshold >> 16;
+		} else {
+			data->high_threshold =
+				 parameter->value << 16;
+			parameter->status =
+			  PAPI(SetInterruptThresholds)(
+				vl53l0_dev,
+				 0,
+				data->low_threshold,
+				 data->high_threshold);
+		}
+		break;
+	case (DEVICEMODE_PAR):
+		if (parameter->is_read) {
+			parameter->status =
+				PAPI(GetDeviceMode)(
+				vl53l0_dev,
+			 (VL53L0_DeviceModes *)&(parameter->value));
+		} else {
+			parameter->status =
+			  PAPI(SetDeviceMode)(
+				vl53l0_dev,
+				(VL53L0_DeviceModes)(parameter->value));
+			data->deviceMode =
+				(VL53L0_DeviceModes)(parameter->value);
+		}
+		break;
+	case (INTERMEASUREMENT_PAR):
+		if (parameter->is_read) {
+			parameter->status =
+		   PAPI(GetInterMeasurementPeriodMilliSeconds)(
+				vl53l0_dev,
+				(uint32_t *)&(parameter->value));
+		} else {
+			parameter->status =
+		  PAPI(SetInterMeasurementPeriodMilliSeconds)(
+				vl53l0_dev,
+				(uint32_t)(parameter->value));
+			data->interMeasurems = parameter->value;
+		}
+		break;
+	}
+}
+
+static int stmvl53l0_parameter_vec_check(
+				const struct stmvl53l0_parameter_vec *vec)
+{
+	const struct stmvl53l0_parameter *parameter;
+	int32_t low = -1, high = -1;
+	uint32_t written = 0;
+	uint32_t i;
+
+	if (vec->count == 0 || vec->count > STMVL53L0_PARAMETER_VEC_MAX)
+		return -EINVAL;
+
+	for (i = 0; i < vec->count; i++) {
+		parameter = &vec->param[i];
+		if ((uint32_t)parameter->name > REFCALIBRATION_PAR)
+			return -EINVAL;
+		if (parameter->is_read)
+			continue;
+		/* a parameter set twice has no defined final value */
+		if (written & BIT(parameter->name))
+			return -EINVAL;
+		written |= BIT(parameter->name);
+
+		switch (parameter->name) {
+		case (XTALKENABLE_PAR):
+			if (parameter->value != 0 && parameter->value != 1)
+				return -EINVAL;
+			break;
+		case (GPIOFUNC_PAR):
+			if (parameter->value < 0 || parameter->value >
+				VL53L0_GPIOFUNCTIONALITY_NEW_MEASURE_READY)
+				return -EINVAL;
+			break;
+		case (LOWTHRESH_PAR):
+		case (HIGHTHRESH_PAR):
+			if (parameter->value < 0 ||
+				parameter->value > STMVL53L0_PROXIMITY_MAX_MM)
+				return -EINVAL;
+			if (parameter->name == LOWTHRESH_PAR)
+				low = parameter->value;
+			else
+				high = parameter->value;
+			break;
+		case (DEVICEMODE_PAR):
+			if (parameter->value < 0 || parameter->value >
+				VL53L0_DEVICEMODE_CONTINUOUS_TIMED_RANGING)
+				return -EINVAL;
+			break;
+		case (INTERMEASUREMENT_PAR):
+			if (parameter->value < 0)
+				return -EINVAL;
+			break;
+		case (REFERENCESPADS_PAR):
+			if (parameter->value < 0 ||
+				(parameter->value2 != 0 && parameter->value2 != 1))
+				return -EINVAL;
+			break;
+		case (REFCALIBRATION_PAR):
+			if ((uint32_t)parameter->value > 0xff ||
+				(uint32_t)parameter->value2 > 0xff)
+				return -EINVAL;
+			break;
+		default:
+			break;
+		}
+	}
+	if (low >= 0 && high >= 0 && low > high)
+		return -EINVAL;
+
+	return 0;
+}
+
+/*
+ * Value a parameter has now, for a rollback, from the driver state and
+ * the configuration mirror rather than from the device.
+ */
+static void stmvl53l0_parameter_saved(struct stmvl53l0_data *data,
+				struct stmvl53l0_parameter *saved)
+{
+	const struct stmvl53l0_cfg_mirror *cfg = &data->cfgMirror;
+
+	saved->value2 = 0;
+	switch (saved->name) {
+	case (OFFSET_PAR):
+		saved->value = cfg->offsetMicroMeter;
+		break;
+	case (XTALKRATE_PAR):
+		saved->value = cfg->xtalkRateMegaCps;
+		break;
+	case (XTALKENABLE_PAR):
+		saved->value = cfg->xtalkEnable;
+		break;
+	case (GPIOFUNC_PAR):
+		saved->value = data->gpio_function;
+		break;
+	case (LOWTHRESH_PAR):
+		saved->value = data->low_threshold >> 16;
+		break;
+	case (HIGHTHRESH_PAR):
+		saved->value = data->high_threshold >> 16;
+		break;
+	case (DEVICEMODE_PAR):
+		saved->value = data->deviceMode;
+		break;
+	case (INTERMEASUREMENT_PAR):
+		saved->value = data->interMeasurems;
+		break;
+	case (REFERENCESPADS_PAR):
+		saved->value = cfg->refSpadCount;
+		saved->value2 = cfg->isApertureSpads;
+		break;
+	case (REFCALIBRATION_PAR):
+		saved->value = cfg->vhvSettings;
+		saved->value2 = cfg->phaseCal;
+		break;
+	}
+}
+
+/*
+ * Apply a parameter vector, with work_mutex held. See struct
+ * stmvl53l0_parameter_vec.
+ */
+static int stmvl53l0_parameter_vec(struct stmvl53l0_data *data,
+				struct stmvl53l0_parameter_vec *vec)
+{
+	struct stmvl53l0_parameter *saved, *parameter;
+	uint8_t setCalibratedValue = data->setCalibratedValue;
+	FixPoint1616_t lowThreshold, highThreshold;
+	VL53L0_Error Status;
+	int threshold = -1;
+	int i, j, rc;
+
+	rc = stmvl53l0_parameter_vec_check(vec);
+	if (rc)
+		return rc;
+
+	saved = kcalloc(vec->count, sizeof(*saved), GFP_KERNEL);
+	if (!saved)
+		return -ENOMEM;
+
+	vec->status = VL53L0_ERROR_NONE;
+	for (i = 0; i < vec->count; i++)
+		vec->param[i].status = VL53L0_ERROR_NONE;
+
+	/* the rollback values come from the mirror, up to date first */
+	if (data->cfgMirror.stale || !data->cfgMirror.valid) {
+		stmvl53l0_cfg_mirror_update(data);
+		if (data->cfgMirror.status != VL53L0_ERROR_NONE) {
+			vec->status = data->cfgMirror.status;
+			goto out;
+		}
+	}
+	for (i = 0; i < vec->count; i++) {
+		if (vec->param[i].is_read)
+			continue;
+		saved[i].name = vec->param[i].name;
+		stmvl53l0_parameter_saved(data, &saved[i]);
+	}
+
+	/*
+	 * both thresholds go out in a single SetInterruptThresholds(), the
+	 * pair is staged now and put back on any failure
+	 */
+	lowThreshold = data->low_threshold;
+	highThreshold = data->high_threshold;
+	for (i = 0; i < vec->count; i++) {
+		parameter = &vec->param[i];
+		if (parameter->is_read)
+			continue;
+		if (parameter->name == LOWTHRESH_PAR)
+			data->low_threshold = parameter->value << 16;
+		else if (parameter->name == HIGHTHRESH_PAR)
+			data->high_threshold = parameter->value << 16;
+	}
+
+	for (i = 0; i < vec->count; i++) {
+		parameter = &vec->param[i];
+		if (!parameter->is_read && (parameter->name == LOWTHRESH_PAR ||
+			parameter->name == HIGHTHRESH_PAR)) {
+			if (threshold >= 0) {
+				parameter->status =
+					vec->param[threshold].status;
+				continue;
+			}
+			threshold = i;
+		}
+		stmvl53l0_parameter_access(data, parameter);
+		if (parameter->status != VL53L0_ERROR_NONE) {
+			vec->status = parameter->status;
+			break;
+		}
+	}
+	if (vec->status == VL53L0_ERROR_NONE)
+		goto out;
+
+	vl53l0_errmsg("parameter %d failed, status %d, rolling back\n",
+		i, vec->status);
+	data->low_threshold = lowThreshold;
+	data->high_threshold = highThreshold;
+	for (j = i; j >= 0; j--) {
+		if (vec->param[j].is_read ||
+			vec->param[j].name == LOWTHRESH_PAR ||
+			vec->param[j].name == HIGHTHRESH_PAR)
+			continue;
+		saved[j].is_read = 0;
+		stmvl53l0_parameter_access(data, &saved[j]);
+		if (saved[j].status != VL53L0_ERROR_NONE)
+			vl53l0_errmsg("restoring parameter %d failed, %d\n",
+				j, saved[j].status);
+	}
+	/* the staged pair, at full precision */
+	if (threshold >= 0) {
+		Status = PAPI(SetInterruptThresholds)(data, 0,
+			data->low_threshold, data->high_threshold);
+		if (Status != VL53L0_ERROR_NONE)
+			vl53l0_errmsg("restoring thresholds failed, %d\n",
+				Status);
+	}
+	data->setCalibratedValue = setCalibratedValue;
+
+out:
+	kfree(saved);
+
+	return 0;
+}
+
+/*
+ * Bulk register access, with work_mutex held. Ranges go out in
+ * transfers of at most VL53L0_MAX_I2C_XFER_SIZE - 1 data bytes, the
+ * index byte taking the remaining one.
+ */
+static VL53L0_Error stmvl53l0_register_bulk(struct stmvl53l0_data *data,
+				struct stmvl53l0_register_bulk *bulk)
+{
+	VL53L0_DEV vl53l0_dev = data;
+	VL53L0_Error Status = VL53L0_ERROR_NONE;
+	VL53L0_Error pageStatus;
+	uint32_t i, chunk;
+
+	if (bulk->reg_count == 0 ||
+		bulk->reg_count > STMVL53L0_REG_BULK_MAX ||
+		bulk->page > 0xff ||
+		(!bulk->scatter && bulk->reg_index + bulk->reg_count > 0x100))
+		return VL53L0_ERROR_INVALID_PARAMS;
+
+	if (bulk->page != 0)
+		Status = VL53L0_WrByte(vl53l0_dev, 0xFF, (uint8_t)bulk->page);
+
+	for (i = 0; Status == VL53L0_ERROR_NONE && i < bulk->reg_count;
+		i += chunk) {
+		if (bulk->scatter) {
+			chunk = 1;
+			if (bulk->is_read)
+				Status = VL53L0_RdByte(vl53l0_dev,
+					bulk->reg_list[i], &bulk->reg_data[i]);
+			else
+				Status = VL53L0_WrByte(vl53l0_dev,
+					bulk->reg_list[i], bulk->reg_data[i]);
+			continue;
+		}
+		chunk = min_t(uint32_t, bulk->reg_count - i,
+			VL53L0_MAX_I2C_XFER_SIZE - 1);
+		if (bulk->is_read)
+			Status = VL53L0_ReadMulti(vl53l0_dev,
+				(uint8_t)(bulk->reg_index + i),
+				&bulk->reg_data[i], chunk);
+		else
+			Status = VL53L0_WriteMulti(vl53l0_dev,
+				(uint8_t)(bulk->reg_index + i),
+				&bulk->reg_data[i], chunk);
+	}
+
+	/* always go back to page 0, the PAL assumes it */
+	if (bulk->page != 0) {
+		pageStatus = VL53L0_WrByte(vl53l0_dev, 0xFF, 0);
+		if (Status == VL53L0_ERROR_NONE)
+			Status = pageStatus;
+	}
+
+	return Status;
+}
+
 /*
  * misc device file operation functions
  */
@@ -1411,14 +2729,18 @@ static int stmvl53l0_ioctl_handler(struct file *file,
 	int8_t offsetint = 0;
 	uint8_t useCase = 0;
 	struct stmvl53l0_custom_use_case customUseCase;
+	struct stmvl53l0_proximity proximity;
 	struct stmvl53l0_data *data =
 			container_of(file->private_data,
 				struct stmvl53l0_data, miscdev);
 	struct stmvl53l0_register reg;
+	struct stmvl53l0_register_bulk bulk;
 	struct stmvl53l0_parameter parameter;
+	struct stmvl53l0_parameter_vec *parameterVec;
 	VL53L0_DEV vl53l0_dev = data;
 	VL53L0_DeviceModes deviceMode;
 	uint8_t page_num = 0;
+	uint8_t histoMode = 0;
 	VL53L0_Error Status = VL53L0_ERROR_NONE;
 
 	if (!data)
@@ -1529,6 +2851,10 @@ static int stmvl53l0_ioctl_handler(struct file *file,
 			data->timingBudget = HIGH_SPEED_TIMING_BUDGET;
 			break;
 
+		case USE_CASE_ULTRA_HIGH_SPEED:
+			data->timingBudget = ULTRA_HIGH_SPEED_TIMING_BUDGET;
+			break;
+
 		default:
 			vl53l0_errmsg("%d, Unknown Use case = %u\n", __LINE__,
 				 useCase);
@@ -1537,6 +2863,7 @@ static int stmvl53l0_ioctl_handler(struct file *file,
 		vl53l0_dbgmsg("useCase as %d\n", useCase);
 		/* record the use case */
 		data->useCase = useCase;
+		stmvl53l0_auto_budget_update(data);
 
 		/* If ranging is in progress, let the work handler
 		 * update the use case
@@ -1616,6 +2943,10 @@ static int stmvl53l0_ioctl_handler(struct file *file,
 		if (page_num != 0)
 			reg.status = VL53L0_WrByte(vl53l0_dev, 0xFF, page_num);
 
+		/* raw writes bypass the PAL register mirrors */
+		if (!reg.is_read)
+			PALDevDataSet(vl53l0_dev, TimingMirrorValid, 0);
+
 		switch (reg.reg_bytes) {
 		case(4):
 			if (reg.is_read)
@@ -1653,7 +2984,8 @@ static int stmvl53l0_ioctl_handler(struct file *file,
 		}
 		if (page_num != 0)
 			reg.status = VL53L0_WrByte(vl53l0_dev, 0xFF, 0);
-
+		if (!reg.is_read)
+			data->cfgMirror.stale = 1;
 
 		if (copy_to_user((struct stmvl53l0_register *)p, &reg,
 				sizeof(struct stmvl53l0_register))) {
@@ -1661,6 +2993,30 @@ static int stmvl53l0_ioctl_handler(struct file *file,
 			return -EFAULT;
 		}
 		break;
+	case VL53L0_IOCTL_REGISTER_BULK:
+		vl53l0_dbgmsg("VL53L0_IOCTL_REGISTER_BULK\n");
+		if (copy_from_user(&bulk, (struct stmvl53l0_register_bulk *)p,
+			sizeof(struct stmvl53l0_register_bulk))) {
+			vl53l0_errmsg("%d, fail\n", __LINE__);
+			return -EFAULT;
+		}
+		vl53l0_dbgmsg("page %u index 0x%x count %u scatter %u\n",
+			bulk.page, bulk.reg_index, bulk.reg_count,
+			bulk.scatter);
+
+		/* raw writes bypass the PAL register mirrors */
+		if (!bulk.is_read)
+			PALDevDataSet(vl53l0_dev, TimingMirrorValid, 0);
+		bulk.status = stmvl53l0_register_bulk(data, &bulk);
+		if (!bulk.is_read)
+			data->cfgMirror.stale = 1;
+
+		if (copy_to_user((struct stmvl53l0_register_bulk *)p, &bulk,
+				sizeof(struct stmvl53l0_register_bulk))) {
+			vl53l0_errmsg("%d, fail\n", __LINE__);
+			return -EFAULT;
+		}
+		break;
 	/* parameter access */
 	case VL53L0_IOCTL_PARAMETER:
 		vl53l0_dbgmsg("VL53L0_IOCTL_PARAMETER\n");
@@ -1669,248 +3025,10 @@ static int stmvl53l0_ioctl_handler(struct file *file,
 			vl53l0_errmsg("%d, fail\n", __LINE__);
 			return -EFAULT;
 		}
-		parameter.status = 0;
 		if (data->enableDebug)
 			vl53l0_dbgmsg(
 			"VL53L0_IOCTL_PARAMETER Name = %d\n", parameter.name);
-		switch (parameter.name) {
-		case (OFFSET_PAR):
-			if (parameter.is_read)
-				parameter.status =
-			    papi_func_tbl->GetOffsetCalibrationDataMicroMeter(
-						vl53l0_dev, &parameter.value);
-			else {
-				parameter.status =
-			    papi_func_tbl->SetOffsetCalibrationDataMicroMeter(
-						vl53l0_dev, parameter.value);
-				  data->OffsetMicroMeter = parameter.value;
-				  data->setCalibratedValue
-			       |= SET_OFFSET_CALIB_DATA_MICROMETER_MASK;
-
-			}
-			vl53l0_dbgmsg("get parameter value as %d\n",
-				 parameter.value);
-			break;
-
-		case (REFERENCESPADS_PAR):
-			if (parameter.is_read) {
-				parameter.status =
-				  papi_func_tbl->GetReferenceSpads(vl53l0_dev,
-						(uint32_t *)&(parameter.value),
-				    (uint8_t *)&(parameter.value2));
-				if (data->enableDebug)
-					vl53l0_dbgmsg(
-						"Get RefSpad : Count:%u, Type:%u\n",
-						parameter.value,
-						(uint8_t)parameter.value2);
-			} else {
-				if (data->enableDebug)
-					vl53l0_dbgmsg(
-					"Set RefSpad : Count:%u, Type:%u\n",
-					parameter.value,
-					(uint8_t)parameter.value2);
-
-				parameter.status =
-				  papi_func_tbl->SetReferenceSpads(vl53l0_dev,
-				(uint32_t)(parameter.value),
-				(uint8_t)(parameter.value2));
-
-				data->refSpadCount = parameter.value;
-				data->isApertureSpads =
-					(uint8_t)(parameter.value2);
-			}
-			break;
-
-		case (REFCALIBRATION_PAR):
-			if (parameter.is_read) {
-				parameter.status =
-			     papi_func_tbl->GetRefCalibration(vl53l0_dev,
-			     (uint8_t *)&(parameter.value),
-			     (uint8_t *)&(parameter.value2));
-					if (data->enableDebug)
-						vl53l0_dbgmsg(
-						"Get Ref : Vhv:%u, PhaseCal:%u\n",
-						(uint8_t)parameter.value,
-						(uint8_t)parameter.value2);
-			} else {
-				if (data->enableDebug)
-					vl53l0_dbgmsg(
-					"Set Ref : Vhv:%u, PhaseCal:%u\n",
-					(uint8_t)parameter.value,
-					(uint8_t)parameter.value2);
-					parameter.status =
-					    papi_func_tbl->SetRefCalibration(
-					    vl53l0_dev,
-					    (uint8_t)(parameter.value),
-					    (uint8_t)(parameter.value2));
-				data->VhvSettings = (uint8_t)parameter.value;
-				data->PhaseCal    = (uint8_t)(parameter.value2);
-			}
-			break;
-		case (XTALKRATE_PAR):
-			if (parameter.is_read)
-				parameter.status =
-				papi_func_tbl->GetXTalkCompensationRateMegaCps(
-				    vl53l0_dev,
-				    (FixPoint1616_t *)
-				    &parameter.value);
-			else {
-				/* Range Ignore Threshold value */
-				FixPoint1616_t ritValue = 0;
-
-				parameter.status =
-			papi_func_tbl->SetXTalkCompensationRateMegaCps(
-						vl53l0_dev,
-						(FixPoint1616_t)
-							parameter.value);
-				data->XTalkCompensationRateMegaCps =
-					 parameter.value;
-				data->setCalibratedValue |=
-					 SET_XTALK_COMP_RATE_MCPS_MASK;
-
-
-				/*0.7 KCps converted to MCps */
-				if (data->XTalkCompensationRateMegaCps <
-						 7*65536/10000) {
-					ritValue = 15 * 7 * 65536/100000;
-				} else {
-					ritValue = 15 *
-					vl53l0_dev->XTalkCompensationRateMegaCps
-							 /10;
-				}
-
-				if (papi_func_tbl->SetLimitCheckEnable
-					!= NULL) {
-					Status =
-					papi_func_tbl->SetLimitCheckEnable(
-					vl53l0_dev,
-				VL53L0_CHECKENABLE_RANGE_IGNORE_THRESHOLD,
-					1);
-				}
-
-				if ((Status == VL53L0_ERROR_NONE)  &&
-					(papi_func_tbl->SetLimitCheckValue
-						 != NULL)) {
-					vl53l0_dbgmsg(
-					"Set RIT - %u\n", ritValue);
-					Status =
-				papi_func_tbl->SetLimitCheckValue(
-				vl53l0_dev,
-				VL53L0_CHECKENABLE_RANGE_IGNORE_THRESHOLD,
-				ritValue);
-				}
-
-			}
-			break;
-		case (XTALKENABLE_PAR):
-			if (parameter.is_read)
-				parameter.status =
-				papi_func_tbl->GetXTalkCompensationEnable(
-					vl53l0_dev,
-					(uint8_t *) &parameter.value);
-			else
-				parameter.status =
-				papi_func_tbl->SetXTalkCompensationEnable(
-				vl53l0_dev,
-				(uint8_t) parameter.value);
-			break;
-		case (GPIOFUNC_PAR):
-			if (parameter.is_read) {
-				parameter.status =
-				papi_func_tbl->GetGpioConfig(
-					vl53l0_dev,
-					0,
-					&deviceMode,
-					&data->gpio_function,
-					&data->gpio_polarity);
-				parameter.value =
-					 data->gpio_function;
-			} else {
-				data->gpio_function = parameter.value;
-				parameter.status =
-				  papi_func_tbl->SetGpioConfig(
-					vl53l0_dev,
-					 0,
-					 0,
-					data->gpio_function,
-					data->gpio_polarity);
-			}
-			break;
-		case (LOWTHRESH_PAR):
-			if (parameter.is_read) {
-				parameter.status =
-				  papi_func_tbl->GetInterruptThresholds(
-					vl53l0_dev,
-					 0,
-					&(data->low_threshold),
-					&(data->high_threshold));
-				parameter.value =
-					 data->low_threshold >> 16;
-			} else {
-				data->low_threshold = parameter.value << 16;
-				parameter.status =
-				  papi_func_tbl->SetInterruptThresholds(
-					vl53l0_dev,
-					 0,
-					data->low_threshold,
-					 data->high_threshold);
-			}
-			break;
-		case (HIGHTHRESH_PAR):
-			if (parameter.is_read) {
-				parameter.status =
-				  papi_func_tbl->GetInterruptThresholds(
-					vl53l0_dev,
-					 0,
-					&(data->low_threshold),
-					 &(data->high_threshold));
-				parameter.value =
-					data->high_threshold >> 16;
-			} else {
-				data->high_threshold =
-					 parameter.value << 16;
-				parameter.status =
-				  papi_func_tbl->SetInterruptThresholds(
-					vl53l0_dev,
-					 0,
-					data->low_threshold,
-					 data->high_threshold);
-			}
-			break;
-		case (DEVICEMODE_PAR):
-			if (parameter.is_read) {
-				parameter.status =
-					papi_func_tbl->GetDeviceMode(
-					vl53l0_dev,
-				 (VL53L0_DeviceModes *)&(parameter.value));
-			} else {
-				parameter.status =
-				  papi_func_tbl->SetDeviceMode(
-					vl53l0_dev,
-					(VL53L0_DeviceModes)(parameter.value));
-				data->deviceMode =
-					(VL53L0_DeviceModes)(parameter.value);
-			}
-			break;
-
-
-
-		case (INTERMEASUREMENT_PAR):
-			if (parameter.is_read) {
-				parameter.status =
-			   papi_func_tbl->GetInterMeasurementPeriodMilliSeconds(
-					vl53l0_dev,
-					(uint32_t *)&(parameter.value));
-			} else {
-				parameter.status =
-			  papi_func_tbl->SetInterMeasurementPeriodMilliSeconds(
-					vl53l0_dev,
-					(uint32_t)(parameter.value));
-				data->interMeasurems = parameter.value;
-			}
-			break;
-
-		}
+		stmvl53l0_parameter_access(data, &parameter);
 
 		if (copy_to_user((struct stmvl53l0_parameter *)p, &parameter,
 				sizeof(struct stmvl53l0_parameter))) {
@@ -1918,16 +3036,112 @@ static int stmvl53l0_ioctl_handler(struct file *file,
 			return -EFAULT;
 		}
 		break;
+	/* several parameters, applied all or none */
+	case VL53L0_IOCTL_PARAMETER_VEC:
+		vl53l0_dbgmsg("VL53L0_IOCTL_PARAMETER_VEC\n");
+		parameterVec = kmalloc(sizeof(*parameterVec), GFP_KERNEL);
+		if (!parameterVec)
+			return -ENOMEM;
+		if (copy_from_user(parameterVec,
+				(struct stmvl53l0_parameter_vec *)p,
+				sizeof(struct stmvl53l0_parameter_vec))) {
+			vl53l0_errmsg("%d, fail\n", __LINE__);
+			kfree(parameterVec);
+			return -EFAULT;
+		}
+		rc = stmvl53l0_parameter_vec(data, parameterVec);
+		if (!rc && copy_to_user((struct stmvl53l0_parameter_vec *)p,
+				parameterVec,
+				sizeof(struct stmvl53l0_parameter_vec))) {
+			vl53l0_errmsg("%d, fail\n", __LINE__);
+			rc = -EFAULT;
+		}
+		kfree(parameterVec);
+		break;
+	/* start streaming histograms into the mmap ring */
+	case VL53L0_IOCTL_HISTO_START:
+		vl53l0_dbgmsg("VL53L0_IOCTL_HISTO_START\n");
+		if (copy_from_user(&histoMode, (uint8_t *)p, sizeof(uint8_t))) {
+			vl53l0_errmsg("%d, fail\n", __LINE__);
+			return -EFAULT;
+		}
+		rc = stmvl53l0_histo_start(data, histoMode);
+		break;
+	/* stop histogram capture */
+	case VL53L0_IOCTL_HISTO_STOP:
+		vl53l0_dbgmsg("VL53L0_IOCTL_HISTO_STOP\n");
+		if (data->histoCapture)
+			rc = stmvl53l0_histo_stop(data);
+		break;
+	/* near/far event mode, applied on the next start, -EBUSY if running */
+	case VL53L0_IOCTL_SET_PROXIMITY:
+		vl53l0_dbgmsg("VL53L0_IOCTL_SET_PROXIMITY\n");
+		if (copy_from_user(&proximity,
+				(struct stmvl53l0_proximity *)p,
+				sizeof(struct stmvl53l0_proximity))) {
+			vl53l0_errmsg("%d, fail\n", __LINE__);
+			return -EFAULT;
+		}
+		rc = stmvl53l0_set_proximity(data, &proximity);
+		break;
 	default:
 		rc = -EINVAL;
 		break;
 	}
 
-	return rc;
+	return rc;
+}
+
+/*
+ * Set up what only a user of the device needs, on first open or enable,
+ * so that probing stays off the boot critical path: the XSHUT reset,
+ * the polling thread and the histogram ring. Called with work_mutex
+ * held.
+ */
+static void stmvl53l0_late_init(struct stmvl53l0_data *data)
+{
+	ktime_t start;
+
+	if (data->lateInitDone)
+		return;
+	data->lateInitDone = 1;
+	start = ktime_get();
+
+	gpio_direction_output(XSHUT_GPIO, 0);
+	usleep_range(2950, 3000);
+	gpio_direction_output(XSHUT_GPIO, 1);
+	usleep_range(2950, 3000);
+
+#ifndef USE_INT
+	data->poll_thread = kthread_run(&stmvl53l0_poll_thread,
+							(void *)data,
+							"STM-VL53L0");
+	if (IS_ERR(data->poll_thread)) {
+		vl53l0_errmsg("%d, failed to create polling thread\n",
+			__LINE__);
+		data->poll_thread = NULL;
+	}
+#endif
+
+	/* histogram capture ring, mapped by userspace */
+	data->histoRing = vmalloc_user(
+			PAGE_ALIGN(sizeof(struct stmvl53l0_histo_ring)));
+	if (!data->histoRing)
+		vl53l0_errmsg("%d, histogram ring not available\n", __LINE__);
+
+	pr_info("stmvl53l0: late init took %lldus\n",
+		ktime_us_delta(ktime_get(), start));
 }
 
 static int stmvl53l0_open(struct inode *inode, struct file *file)
 {
+	struct stmvl53l0_data *data = container_of(file->private_data,
+					struct stmvl53l0_data, miscdev);
+
+	mutex_lock(&data->work_mutex);
+	stmvl53l0_late_init(data);
+	mutex_unlock(&data->work_mutex);
+
 	return 0;
 }
 
@@ -1949,12 +3163,111 @@ static int stmvl53l0_flush(struct file *file, fl_owner_t id)
 			/* to stop */
 			stmvl53l0_stop(data);
 		}
+		if (data->histoCapture)
+			stmvl53l0_histo_stop(data);
 	}
 	mutex_unlock(&data->work_mutex);
 
 	return 0;
 }
 
+/* Map the histogram capture ring */
+static int stmvl53l0_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct stmvl53l0_data *data = container_of(file->private_data,
+					struct stmvl53l0_data, miscdev);
+	unsigned long size = vma->vm_end - vma->vm_start;
+
+	if (!data->histoRing)
+		return -ENODEV;
+
+	if (vma->vm_pgoff != 0 ||
+		size > PAGE_ALIGN(sizeof(struct stmvl53l0_histo_ring)))
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, data->histoRing, 0);
+}
+
+/* samples newer than since, overwritten ones included */
+static uint32_t stmvl53l0_samples_pending(struct stmvl53l0_data *data,
+				uint32_t since)
+{
+	uint32_t head = READ_ONCE(data->sampleSeq);
+
+	/* a sequence ahead of the driver is from before a reload */
+	if (since == 0 || (int32_t)(head - since) < 0)
+		return min_t(uint32_t, head, STMVL53L0_SAMPLE_RING_SLOTS);
+	return head - since;
+}
+
+/*
+ * VL53L0_IOCTL_GETDATAS_BATCH. Runs without work_mutex, which the work
+ * handler needs to produce the samples waited for.
+ */
+static long stmvl53l0_getdatas_batch(struct stmvl53l0_data *data,
+				void __user *p)
+{
+	struct stmvl53l0_getdatas_batch *batch;
+	uint32_t pending, first, i;
+	long ret = 0;
+
+	batch = kmalloc(sizeof(*batch), GFP_KERNEL);
+	if (!batch)
+		return -ENOMEM;
+	if (copy_from_user(batch, p,
+			offsetof(struct stmvl53l0_getdatas_batch, sample))) {
+		vl53l0_errmsg("%d, fail\n", __LINE__);
+		ret = -EFAULT;
+		goto out;
+	}
+	if (batch->count == 0 ||
+		batch->count > STMVL53L0_SAMPLE_RING_SLOTS ||
+		batch->minCount > batch->count) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	if (batch->minCount && batch->timeoutMs) {
+		ret = wait_event_interruptible_timeout(data->sampleWq,
+			stmvl53l0_samples_pending(data, batch->sinceSeq) >=
+				batch->minCount,
+			msecs_to_jiffies(batch->timeoutMs));
+		if (ret < 0)
+			goto out;
+		ret = 0; /* on timeout, return what is there */
+	} else if (batch->minCount) {
+		ret = wait_event_interruptible(data->sampleWq,
+			stmvl53l0_samples_pending(data, batch->sinceSeq) >=
+				batch->minCount);
+		if (ret)
+			goto out;
+	}
+
+	spin_lock(&data->sampleLock);
+	pending = stmvl53l0_samples_pending(data, batch->sinceSeq);
+	batch->lost = 0;
+	if (pending > STMVL53L0_SAMPLE_RING_SLOTS) {
+		batch->lost = pending - STMVL53L0_SAMPLE_RING_SLOTS;
+		pending = STMVL53L0_SAMPLE_RING_SLOTS;
+	}
+	batch->count = min(batch->count, pending);
+	first = data->sampleSeq - pending + 1;
+	for (i = 0; i < batch->count; i++)
+		batch->sample[i] = data->sampleRing[(first + i) %
+			STMVL53L0_SAMPLE_RING_SLOTS];
+	spin_unlock(&data->sampleLock);
+
+	if (copy_to_user(p, batch,
+			offsetof(struct stmvl53l0_getdatas_batch, sample) +
+			batch->count * sizeof(struct stmvl53l0_sample))) {
+		vl53l0_errmsg("%d, fail\n", __LINE__);
+		ret = -EFAULT;
+	}
+out:
+	kfree(batch);
+	return ret;
+}
+
 static long stmvl53l0_ioctl(struct file *file,
 				unsigned int cmd, unsigned long arg)
 {
@@ -1962,9 +3275,16 @@ static long stmvl53l0_ioctl(struct file *file,
 	struct stmvl53l0_data *data =
 			container_of(file->private_data,
 					struct stmvl53l0_data, miscdev);
-	mutex_lock(&data->work_mutex);
-	ret = stmvl53l0_ioctl_handler(file, cmd, arg, (void __user *)arg);
-	mutex_unlock(&data->work_mutex);
+	trace_stmvl53l0_ioctl_enter(cmd);
+	if (cmd == VL53L0_IOCTL_GETDATAS_BATCH) {
+		ret = stmvl53l0_getdatas_batch(data, (void __user *)arg);
+	} else {
+		mutex_lock(&data->work_mutex);
+		ret = stmvl53l0_ioctl_handler(file, cmd, arg,
+			(void __user *)arg);
+		mutex_unlock(&data->work_mutex);
+	}
+	trace_stmvl53l0_ioctl_exit(cmd, ret);
 
 	return ret;
 }
@@ -1986,6 +3306,9 @@ static int stmvl53l0_init_client(struct stmvl53l0_data *data)
 
 	vl53l0_dbgmsg("Enter\n");
 
+	/* read back in full once the use case is configured */
+	data->cfgMirror.stale = 1;
+
 	data->I2cDevAddr      = 0x52;
 	data->comms_type      = 1;
 	data->comms_speed_khz = 400;
@@ -2001,17 +3324,19 @@ static int stmvl53l0_init_client(struct stmvl53l0_data *data)
 	if (data->reset) {
 		pr_err("Call of VL53L0_DataInit\n");
 		/* Data initialization */
-		Status = papi_func_tbl->DataInit(vl53l0_dev);
+		Status = PAPI(DataInit)(vl53l0_dev);
 		/* data->reset = 0; */
 		if (Status != VL53L0_ERROR_NONE) {
 			vl53l0_errmsg(
 			 "%d- error status %d\n", __LINE__, Status);
 			return Status;
 		}
+		/* sequence steps are back to their defaults */
+		data->uhsActive = 0;
 	}
 
 	vl53l0_dbgmsg("VL53L0_GetDeviceInfo:\n");
-	Status = papi_func_tbl->GetDeviceInfo(vl53l0_dev, &DeviceInfo);
+	Status = PAPI(GetDeviceInfo)(vl53l0_dev, &DeviceInfo);
 	if (Status == VL53L0_ERROR_NONE) {
 		vl53l0_dbgmsg("Device Name : %s\n", DeviceInfo.Name);
 		vl53l0_dbgmsg("Device Type : %s\n", DeviceInfo.Type);
@@ -2024,7 +3349,7 @@ static int stmvl53l0_init_client(struct stmvl53l0_data *data)
 	}
 		/* Device Initialization */
 	vl53l0_dbgmsg("Call of VL53L0_StaticInit\n");
-	Status = papi_func_tbl->StaticInit(vl53l0_dev);
+	Status = PAPI(StaticInit)(vl53l0_dev);
 	if (Status != VL53L0_ERROR_NONE) {
 		vl53l0_errmsg("%d- error status %d\n", __LINE__, Status);
 		return Status;
@@ -2034,9 +3359,9 @@ static int stmvl53l0_init_client(struct stmvl53l0_data *data)
 
 
 
-	if (papi_func_tbl->PerformRefCalibration != NULL && data->reset) {
+	if (PAPI_AVAILABLE(PerformRefCalibration) && data->reset) {
 		vl53l0_dbgmsg("Call of VL53L0_PerformRefCalibration\n");
-		Status = papi_func_tbl->PerformRefCalibration(vl53l0_dev,
+		Status = PAPI(PerformRefCalibration)(vl53l0_dev,
 				&VhvSettings, &PhaseCal); /* Ref calibration */
 		if (Status !=
 			 VL53L0_ERROR_NONE) {
@@ -2049,10 +3374,10 @@ static int stmvl53l0_init_client(struct stmvl53l0_data *data)
 	vl53l0_dev->VhvSettings = VhvSettings;
 	vl53l0_dev->PhaseCal = PhaseCal;
 
-	if (papi_func_tbl->PerformRefSpadManagement != NULL && data->reset) {
+	if (PAPI_AVAILABLE(PerformRefSpadManagement) && data->reset) {
 		vl53l0_dbgmsg(
 			"Call of VL53L0_PerformRefSpadManagement\n");
-		Status = papi_func_tbl->PerformRefSpadManagement(vl53l0_dev,
+		Status = PAPI(PerformRefSpadManagement)(vl53l0_dev,
 				&refSpadCount,
 				&isApertureSpads); /* Ref Spad Management */
 		if (Status != VL53L0_ERROR_NONE) {
@@ -2072,13 +3397,13 @@ static int stmvl53l0_init_client(struct stmvl53l0_data *data)
 
 
 	if (Status == VL53L0_ERROR_NONE && data->reset) {
-		if ((papi_func_tbl->SetOffsetCalibrationDataMicroMeter != NULL)
+		if ((PAPI_AVAILABLE(SetOffsetCalibrationDataMicroMeter))
 		    && (vl53l0_dev->setCalibratedValue &
 			SET_OFFSET_CALIB_DATA_MICROMETER_MASK)) {
 			vl53l0_dbgmsg(
 			"Call of SetOffsetCalibrationDataMicroMeter\n");
 			Status =
-			papi_func_tbl->SetOffsetCalibrationDataMicroMeter(
+			PAPI(SetOffsetCalibrationDataMicroMeter)(
 				vl53l0_dev,
 				vl53l0_dev->OffsetMicroMeter);
 			if (Status != VL53L0_ERROR_NONE) {
@@ -2092,12 +3417,12 @@ static int stmvl53l0_init_client(struct stmvl53l0_data *data)
 
 
 	if (data->reset) {
-		if ((papi_func_tbl->SetXTalkCompensationRateMegaCps != NULL) &&
+		if ((PAPI_AVAILABLE(SetXTalkCompensationRateMegaCps)) &&
 		(vl53l0_dev->setCalibratedValue &
 			SET_XTALK_COMP_RATE_MCPS_MASK)) {
 			vl53l0_dbgmsg(
 			"Call of SetXTalkCompensationRateMegaCps\n");
-			Status = papi_func_tbl->SetXTalkCompensationRateMegaCps(
+			Status = PAPI(SetXTalkCompensationRateMegaCps)(
 				vl53l0_dev,
 				vl53l0_dev->XTalkCompensationRateMegaCps);
 			if (Status != VL53L0_ERROR_NONE) {
@@ -2125,8 +3450,8 @@ static int stmvl53l0_init_client(struct stmvl53l0_data *data)
 				 vl53l0_dev->XTalkCompensationRateMegaCps/10;
 			}
 
-			if (papi_func_tbl->SetLimitCheckEnable != NULL) {
-				Status = papi_func_tbl->SetLimitCheckEnable(
+			if (PAPI_AVAILABLE(SetLimitCheckEnable)) {
+				Status = PAPI(SetLimitCheckEnable)(
 				vl53l0_dev,
 				VL53L0_CHECKENABLE_RANGE_IGNORE_THRESHOLD,
 				1);
@@ -2138,9 +3463,9 @@ static int stmvl53l0_init_client(struct stmvl53l0_data *data)
 				}
 			}
 
-			if (papi_func_tbl->SetLimitCheckValue != NULL) {
+			if (PAPI_AVAILABLE(SetLimitCheckValue)) {
 				vl53l0_dbgmsg("Set RIT - %u\n", ritValue);
-				Status = papi_func_tbl->SetLimitCheckValue(
+				Status = PAPI(SetLimitCheckValue)(
 				vl53l0_dev,
 				VL53L0_CHECKENABLE_RANGE_IGNORE_THRESHOLD,
 				ritValue);
@@ -2158,7 +3483,7 @@ static int stmvl53l0_init_client(struct stmvl53l0_data *data)
 	/* Setup in single ranging mode */
 
 		pr_err("Call of VL53L0_SetDeviceMode\n");
-	Status = papi_func_tbl->SetDeviceMode(vl53l0_dev,
+	Status = PAPI(SetDeviceMode)(vl53l0_dev,
 					VL53L0_DEVICEMODE_SINGLE_RANGING);
 	if (Status != VL53L0_ERROR_NONE) {
 		vl53l0_errmsg("%d- error status %d\n", __LINE__, Status);
@@ -2166,7 +3491,7 @@ static int stmvl53l0_init_client(struct stmvl53l0_data *data)
 	}
 
 
-	Status = papi_func_tbl->SetWrapAroundCheckEnable(vl53l0_dev, 1);
+	Status = PAPI(SetWrapAroundCheckEnable)(vl53l0_dev, 1);
 	if (Status != VL53L0_ERROR_NONE) {
 		vl53l0_errmsg("%d- error status %d\n", __LINE__, Status);
 		return Status;
@@ -2179,6 +3504,78 @@ static int stmvl53l0_init_client(struct stmvl53l0_data *data)
 }
 
 
+/* Skip the optional sequence steps for the ultra high speed use case */
+static VL53L0_Error stmvl53l0_prune_sequence(struct stmvl53l0_data *data)
+{
+	VL53L0_DEV vl53l0_dev = data;
+	VL53L0_Error Status = VL53L0_ERROR_NONE;
+
+	if (data->uhsActive)
+		return Status;
+
+	Status = PAPI(GetSequenceStepEnables)(vl53l0_dev,
+			&data->uhsSavedSteps);
+	if (Status == VL53L0_ERROR_NONE)
+		Status = PAPI(GetSequenceStepTimeout)(vl53l0_dev,
+				VL53L0_SEQUENCESTEP_MSRC,
+				&data->uhsSavedMsrcTimeout);
+
+	if (Status == VL53L0_ERROR_NONE)
+		Status = PAPI(SetSequenceStepEnable)(vl53l0_dev,
+				VL53L0_SEQUENCESTEP_TCC, 0);
+	if (Status == VL53L0_ERROR_NONE)
+		Status = PAPI(SetSequenceStepEnable)(vl53l0_dev,
+				VL53L0_SEQUENCESTEP_MSRC, 0);
+	if (Status == VL53L0_ERROR_NONE)
+		Status = PAPI(SetSequenceStepEnable)(vl53l0_dev,
+				VL53L0_SEQUENCESTEP_PRE_RANGE, 0);
+	/* MSRC and DSS share the same timeout */
+	if (Status == VL53L0_ERROR_NONE)
+		Status = PAPI(SetSequenceStepTimeout)(vl53l0_dev,
+				VL53L0_SEQUENCESTEP_MSRC,
+				ULTRA_HIGH_SPEED_MSRC_TIMEOUT);
+
+	if (Status == VL53L0_ERROR_NONE)
+		data->uhsActive = 1;
+	else
+		vl53l0_errmsg("Failed to prune sequence steps. Error = %d\n",
+			Status);
+
+	return Status;
+}
+
+static VL53L0_Error stmvl53l0_restore_sequence(struct stmvl53l0_data *data)
+{
+	VL53L0_DEV vl53l0_dev = data;
+	VL53L0_Error Status = VL53L0_ERROR_NONE;
+
+	if (!data->uhsActive)
+		return Status;
+
+	Status = PAPI(SetSequenceStepTimeout)(vl53l0_dev,
+			VL53L0_SEQUENCESTEP_MSRC, data->uhsSavedMsrcTimeout);
+	if (Status == VL53L0_ERROR_NONE)
+		Status = PAPI(SetSequenceStepEnable)(vl53l0_dev,
+				VL53L0_SEQUENCESTEP_TCC,
+				data->uhsSavedSteps.TccOn);
+	if (Status == VL53L0_ERROR_NONE)
+		Status = PAPI(SetSequenceStepEnable)(vl53l0_dev,
+				VL53L0_SEQUENCESTEP_MSRC,
+				data->uhsSavedSteps.MsrcOn);
+	if (Status == VL53L0_ERROR_NONE)
+		Status = PAPI(SetSequenceStepEnable)(vl53l0_dev,
+				VL53L0_SEQUENCESTEP_PRE_RANGE,
+				data->uhsSavedSteps.PreRangeOn);
+
+	if (Status == VL53L0_ERROR_NONE)
+		data->uhsActive = 0;
+	else
+		vl53l0_errmsg("Failed to restore sequence steps. Error = %d\n",
+			Status);
+
+	return Status;
+}
+
 static int stmvl53l0_config_use_case(struct stmvl53l0_data *data)
 {
 	VL53L0_DEV		vl53l0_dev = data;
@@ -2187,6 +3584,8 @@ static int stmvl53l0_config_use_case(struct stmvl53l0_data *data)
 	FixPoint1616_t	sigmaLimit;
 	uint32_t		preRangePulsePeriod;
 	uint32_t		finalRangePulsePeriod;
+	struct stmvl53l0_cfg_mirror *cfg;
+	VL53L0_Error	mirrorStatus;
 
 	vl53l0_dbgmsg("Enter\n");
 
@@ -2213,6 +3612,14 @@ static int stmvl53l0_config_use_case(struct stmvl53l0_data *data)
 		finalRangePulsePeriod = HIGH_SPEED_FINAL_RANGE_PULSE_PERIOD;
 		break;
 
+	case USE_CASE_ULTRA_HIGH_SPEED:
+		sigmaLimit		= ULTRA_HIGH_SPEED_SIGMA_LIMIT;
+		signalRateLimit	= ULTRA_HIGH_SPEED_SIGNAL_RATE_LIMIT;
+		preRangePulsePeriod	= ULTRA_HIGH_SPEED_PRE_RANGE_PULSE_PERIOD;
+		finalRangePulsePeriod =
+			ULTRA_HIGH_SPEED_FINAL_RANGE_PULSE_PERIOD;
+		break;
+
 	case USE_CASE_CUSTOM:
 		/* Set by application through IOCTL interface */
 		sigmaLimit			= vl53l0_dev->sigmaLimit;
@@ -2237,15 +3644,15 @@ static int stmvl53l0_config_use_case(struct stmvl53l0_data *data)
 					finalRangePulsePeriod,
 					vl53l0_dev->timingBudget);
 
-	if (papi_func_tbl->SetLimitCheckEnable != NULL) {
-		Status = papi_func_tbl->SetLimitCheckEnable(
+	if (PAPI_AVAILABLE(SetLimitCheckEnable)) {
+		Status = PAPI(SetLimitCheckEnable)(
 			vl53l0_dev,
 			VL53L0_CHECKENABLE_SIGMA_FINAL_RANGE,
 			 1);
 	}
 
 	if (Status == VL53L0_ERROR_NONE) {
-		Status = papi_func_tbl->SetLimitCheckEnable(
+		Status = PAPI(SetLimitCheckEnable)(
 			vl53l0_dev,
 			VL53L0_CHECKENABLE_SIGNAL_RATE_FINAL_RANGE,
 			 1);
@@ -2257,7 +3664,7 @@ static int stmvl53l0_config_use_case(struct stmvl53l0_data *data)
 
 
 	if (Status == VL53L0_ERROR_NONE) {
-		Status = papi_func_tbl->SetLimitCheckValue(
+		Status = PAPI(SetLimitCheckValue)(
 				vl53l0_dev,
 				VL53L0_CHECKENABLE_SIGNAL_RATE_FINAL_RANGE,
 				signalRateLimit);
@@ -2268,7 +3675,7 @@ static int stmvl53l0_config_use_case(struct stmvl53l0_data *data)
 	}
 
 	if (Status == VL53L0_ERROR_NONE) {
-		Status = papi_func_tbl->SetLimitCheckValue(vl53l0_dev,
+		Status = PAPI(SetLimitCheckValue)(vl53l0_dev,
 					VL53L0_CHECKENABLE_SIGMA_FINAL_RANGE,
 					sigmaLimit);
 	} else {
@@ -2277,9 +3684,14 @@ static int stmvl53l0_config_use_case(struct stmvl53l0_data *data)
 			 Status);
 	}
 
+	/* steps are pruned before the budget is shrunk */
+	if (Status == VL53L0_ERROR_NONE &&
+		vl53l0_dev->useCase == USE_CASE_ULTRA_HIGH_SPEED)
+		Status = stmvl53l0_prune_sequence(vl53l0_dev);
+
 	if (Status == VL53L0_ERROR_NONE) {
 		Status =
-		papi_func_tbl->SetMeasurementTimingBudgetMicroSeconds(
+		PAPI(SetMeasurementTimingBudgetMicroSeconds)(
 				vl53l0_dev,
 				vl53l0_dev->timingBudget);
 	} else {
@@ -2288,9 +3700,14 @@ static int stmvl53l0_config_use_case(struct stmvl53l0_data *data)
 			 Status);
 	}
 
+	/* and restored once the budget has grown again */
+	if (Status == VL53L0_ERROR_NONE &&
+		vl53l0_dev->useCase != USE_CASE_ULTRA_HIGH_SPEED)
+		Status = stmvl53l0_restore_sequence(vl53l0_dev);
+
 
 	if (Status == VL53L0_ERROR_NONE) {
-		Status = papi_func_tbl->SetVcselPulsePeriod(vl53l0_dev,
+		Status = PAPI(SetVcselPulsePeriod)(vl53l0_dev,
 					VL53L0_VCSEL_PERIOD_PRE_RANGE,
 					preRangePulsePeriod);
 	} else {
@@ -2300,7 +3717,7 @@ static int stmvl53l0_config_use_case(struct stmvl53l0_data *data)
 	}
 
 	if (Status == VL53L0_ERROR_NONE) {
-		Status = papi_func_tbl->SetVcselPulsePeriod(vl53l0_dev,
+		Status = PAPI(SetVcselPulsePeriod)(vl53l0_dev,
 			VL53L0_VCSEL_PERIOD_FINAL_RANGE,
 			finalRangePulsePeriod);
 	} else
@@ -2308,14 +3725,47 @@ static int stmvl53l0_config_use_case(struct stmvl53l0_data *data)
 		"SetVcselPulsePeriod(PRE) failed with errcode = %d\n", Status);
 
 
-	if (Status != VL53L0_ERROR_NONE)
+	if (Status != VL53L0_ERROR_NONE) {
 		vl53l0_dbgmsg(
 		"SetVcselPulsePeriod(FINAL)failed with errcode = %d\n", Status);
+		/* partly applied */
+		data->cfgMirror.stale = 1;
+	} else if (data->cfgMirror.stale) {
+		stmvl53l0_cfg_mirror_update(data);
+	} else {
+		/*
+		 * Record what was just written, as the device holds it: the
+		 * signal limit goes through a Fix9.7 register, the budget
+		 * and periods come from the PAL timing mirror, off the bus.
+		 */
+		cfg = &data->cfgMirror;
+		cfg->limitEnable[VL53L0_CHECKENABLE_SIGMA_FINAL_RANGE] = 1;
+		cfg->limitValue[VL53L0_CHECKENABLE_SIGMA_FINAL_RANGE] =
+			sigmaLimit;
+		cfg->limitEnable[VL53L0_CHECKENABLE_SIGNAL_RATE_FINAL_RANGE] =
+			1;
+		cfg->limitValue[VL53L0_CHECKENABLE_SIGNAL_RATE_FINAL_RANGE] =
+			VL53L0_FIXPOINT97TOFIXPOINT1616(
+			VL53L0_FIXPOINT1616TOFIXPOINT97(signalRateLimit));
+		mirrorStatus = PAPI(GetMeasurementTimingBudgetMicroSeconds)(
+				vl53l0_dev, &cfg->timingBudget);
+		if (mirrorStatus == VL53L0_ERROR_NONE)
+			mirrorStatus = PAPI(GetVcselPulsePeriod)(vl53l0_dev,
+					VL53L0_VCSEL_PERIOD_PRE_RANGE,
+					&cfg->preRangePulsePeriod);
+		if (mirrorStatus == VL53L0_ERROR_NONE)
+			mirrorStatus = PAPI(GetVcselPulsePeriod)(vl53l0_dev,
+					VL53L0_VCSEL_PERIOD_FINAL_RANGE,
+					&cfg->finalRangePulsePeriod);
+		if (mirrorStatus != VL53L0_ERROR_NONE)
+			cfg->stale = 1;
+	}
 
 	vl53l0_dbgmsg("End\n");
 	return Status;
 }
-static int stmvl53l0_start(struct stmvl53l0_data *data, uint8_t scaling,
+
+static int stmvl53l0_do_start(struct stmvl53l0_data *data, uint8_t scaling,
 	init_mode_e mode)
 {
 	int rc = 0;
@@ -2324,36 +3774,46 @@ static int stmvl53l0_start(struct stmvl53l0_data *data, uint8_t scaling,
 
 	vl53l0_dbgmsg("Enter\n");
 
+	if (data->histoCapture) {
+		vl53l0_errmsg("histogram capture in progress\n");
+		return -EBUSY;
+	}
+
+	stmvl53l0_late_init(data);
+
 	/* Power up */
-	rc = pmodule_func_tbl->power_up(data->client_object, &data->reset);
+	rc = stmvl53l0_power_up(data);
 	if (rc) {
 		vl53l0_errmsg("%d,error rc %d\n", __LINE__, rc);
 		return rc;
 	}
+	memset(&data->energy.session, 0, sizeof(data->energy.session));
+	data->energy.session.onSince = ktime_get();
 
 	/* init */
 	rc = stmvl53l0_init_client(data);
 	if (rc) {
 		vl53l0_errmsg("%d, error rc %d\n", __LINE__, rc);
-		pmodule_func_tbl->power_down(data->client_object);
+		stmvl53l0_power_down(data);
 		return -EINVAL;
 	}
 
 	/* check mode */
 	if (mode != NORMAL_MODE)
-		papi_func_tbl->SetXTalkCompensationEnable(vl53l0_dev, 1);
+		PAPI(SetXTalkCompensationEnable)(vl53l0_dev, 1);
 
 	if (mode == OFFSETCALIB_MODE) {
 		/*VL53L0_SetOffsetCalibrationDataMicroMeter(vl53l0_dev, 0);*/
 		FixPoint1616_t OffsetMicroMeter;
 
-		papi_func_tbl->PerformOffsetCalibration(vl53l0_dev,
+		PAPI(PerformOffsetCalibration)(vl53l0_dev,
 			(data->offsetCalDistance<<16),
 			&OffsetMicroMeter);
 		pr_err("Offset calibration:%u\n", OffsetMicroMeter);
 		vl53l0_dev->OffsetMicroMeter = OffsetMicroMeter;
 		vl53l0_dev->setCalibratedValue |=
 		 SET_OFFSET_CALIB_DATA_MICROMETER_MASK;
+		data->cfgMirror.stale = 1;
 
 		return rc;
 	} else if (mode == XTALKCALIB_MODE) {
@@ -2361,7 +3821,7 @@ static int stmvl53l0_start(struct stmvl53l0_data *data, uint8_t scaling,
 		/*caltarget distance : 100mm and convert to
 		* fixed point 16 16 format
 		*/
-		papi_func_tbl->PerformXTalkCalibration(vl53l0_dev,
+		PAPI(PerformXTalkCalibration)(vl53l0_dev,
 			(data->xtalkCalDistance<<16),
 			&XTalkCompensationRateMegaCps);
 		pr_err("Xtalk calibration:%u\n",
@@ -2370,14 +3830,22 @@ static int stmvl53l0_start(struct stmvl53l0_data *data, uint8_t scaling,
 				 XTalkCompensationRateMegaCps;
 		vl53l0_dev->setCalibratedValue |=
 			 SET_XTALK_COMP_RATE_MCPS_MASK;
+		data->cfgMirror.stale = 1;
 
 		return rc;
 	}
 	/* set up device parameters */
 	data->gpio_polarity = VL53L0_INTERRUPTPOLARITY_LOW;
 
+	/* first event on any side of the proximity window */
+	if (data->proximity.farMm != 0) {
+		data->gpio_function =
+			VL53L0_GPIOFUNCTIONALITY_THRESHOLD_CROSSED_OUT;
+		data->proximityState = STMVL53L0_PROXIMITY_UNKNOWN;
+	}
+
 	/* Following two calls are made from IOCTL as well */
-	Status = papi_func_tbl->SetGpioConfig(vl53l0_dev, 0, 0,
+	Status = PAPI(SetGpioConfig)(vl53l0_dev, 0, 0,
 		data->gpio_function,
 		VL53L0_INTERRUPTPOLARITY_LOW);
 	if (Status != VL53L0_ERROR_NONE) {
@@ -2386,7 +3854,7 @@ static int stmvl53l0_start(struct stmvl53l0_data *data, uint8_t scaling,
 	}
 
 
-	Status = papi_func_tbl->SetInterruptThresholds(vl53l0_dev, 0,
+	Status = PAPI(SetInterruptThresholds)(vl53l0_dev, 0,
 		data->low_threshold,
 		data->high_threshold);
 	if (Status != VL53L0_ERROR_NONE) {
@@ -2395,9 +3863,10 @@ static int stmvl53l0_start(struct stmvl53l0_data *data, uint8_t scaling,
 		return -EPERM;
 	}
 
+	stmvl53l0_energy_cap_apply(data);
 
 	if (data->deviceMode == VL53L0_DEVICEMODE_CONTINUOUS_TIMED_RANGING) {
-		Status = papi_func_tbl->SetInterMeasurementPeriodMilliSeconds(
+		Status = PAPI(SetInterMeasurementPeriodMilliSeconds)(
 			vl53l0_dev,
 			data->interMeasurems);
 		if (Status != VL53L0_ERROR_NONE) {
@@ -2415,7 +3884,7 @@ static int stmvl53l0_start(struct stmvl53l0_data *data, uint8_t scaling,
 	}
 
 
-	Status = papi_func_tbl->SetDeviceMode(
+	Status = PAPI(SetDeviceMode)(
 			vl53l0_dev,
 			data->deviceMode);
 	if (Status != VL53L0_ERROR_NONE) {
@@ -2423,7 +3892,7 @@ static int stmvl53l0_start(struct stmvl53l0_data *data, uint8_t scaling,
 		return -EPERM;
 	}
 
-	Status = papi_func_tbl->ClearInterruptMask(vl53l0_dev,
+	Status = PAPI(ClearInterruptMask)(vl53l0_dev,
 							0);
 	if (Status != VL53L0_ERROR_NONE) {
 		vl53l0_errmsg(
@@ -2441,8 +3910,14 @@ static int stmvl53l0_start(struct stmvl53l0_data *data, uint8_t scaling,
 		return -EPERM;
 	}
 
+	stmvl53l0_filter_reset(&data->filter);
+	data->lastSampleTime = ktime_set(0, 0);
+	data->sampleIntervalUs = 0;
+	data->enableTime = ktime_get();
+	STMVL53L0_STAT_INC(data, enables);
+
 	/* start the ranging */
-	Status = papi_func_tbl->StartMeasurement(vl53l0_dev);
+	Status = PAPI(StartMeasurement)(vl53l0_dev);
 	if (Status != VL53L0_ERROR_NONE) {
 		vl53l0_errmsg(
 			"Failed to StartMeasurement. Error = %d\n", Status);
@@ -2461,6 +3936,25 @@ static int stmvl53l0_start(struct stmvl53l0_data *data, uint8_t scaling,
 	return rc;
 }
 
+/*
+ * On a CCI bus, the byte writes of the init and configuration sequence
+ * are sent in as few CCI transactions as the reads and polling delays
+ * in between allow, leaving the bus to the camera sensor.
+ */
+static int stmvl53l0_start(struct stmvl53l0_data *data, uint8_t scaling,
+	init_mode_e mode)
+{
+	int rc, err;
+
+	VL53L0_I2CBatchBegin(data);
+	rc = stmvl53l0_do_start(data, scaling, mode);
+	err = VL53L0_I2CBatchEnd(data);
+	if (err)
+		vl53l0_errmsg("%d, error rc %d\n", __LINE__, err);
+
+	return rc ? rc : err;
+}
+
 
 VL53L0_Error WaitStopCompleted(VL53L0_DEV Dev)
 {
@@ -2476,7 +3970,7 @@ VL53L0_Error WaitStopCompleted(VL53L0_DEV Dev)
 	if (Status == VL53L0_ERROR_NONE) {
 		LoopNb = 0;
 		do {
-			Status = papi_func_tbl->GetStopCompletedStatus(Dev,
+			Status = PAPI(GetStopCompletedStatus)(Dev,
 							&StopCompleted);
 			if ((StopCompleted == 0x00) ||
 			    (Status != VL53L0_ERROR_NONE))
@@ -2505,21 +3999,132 @@ static int stmvl53l0_stop(struct stmvl53l0_data *data)
 	/* stop - if continuous mode */
 	if (data->deviceMode == VL53L0_DEVICEMODE_CONTINUOUS_RANGING ||
 		data->deviceMode == VL53L0_DEVICEMODE_CONTINUOUS_TIMED_RANGING)
-		papi_func_tbl->StopMeasurement(vl53l0_dev);
+		PAPI(StopMeasurement)(vl53l0_dev);
 
 	/* clean interrupt */
-	papi_func_tbl->ClearInterruptMask(vl53l0_dev, 0);
+	PAPI(ClearInterruptMask)(vl53l0_dev, 0);
 
 
 	WaitStopCompleted(vl53l0_dev);
 
 	/* cancel work handler */
 	stmvl53l0_cancel_handler(data);
+	stmvl53l0_range_clear();
 
 	/* Clear updateUseCase pending operation */
 	data->updateUseCase = 0;
+	stmvl53l0_energy_cap_restore(data);
 	/* power down */
-	rc = pmodule_func_tbl->power_down(data->client_object);
+	rc = stmvl53l0_power_down(data);
+	if (rc) {
+		vl53l0_errmsg("%d, error rc %d\n", __LINE__, rc);
+		return rc;
+	}
+	vl53l0_dbgmsg("End\n");
+
+	return rc;
+}
+
+/*
+ * Start or stop ranging on behalf of an in-kernel user (the IIO buffer),
+ * as enable_ps_sensor does. Returns 1 if the ranging state changed.
+ */
+int stmvl53l0_set_ranging(struct stmvl53l0_data *data, int on)
+{
+	int changed = 0;
+
+	mutex_lock(&data->work_mutex);
+	if (on && data->enable_ps_sensor == 0) {
+		stmvl53l0_start(data, 3, NORMAL_MODE);
+		changed = 1;
+	} else if (!on && data->enable_ps_sensor == 1) {
+		data->enable_ps_sensor = 0;
+		stmvl53l0_stop(data);
+		changed = 1;
+	}
+	mutex_unlock(&data->work_mutex);
+
+	return changed;
+}
+
+static int stmvl53l0_histo_start(struct stmvl53l0_data *data,
+	VL53L0_HistogramModes histoMode)
+{
+	int rc = 0;
+	VL53L0_DEV vl53l0_dev = data;
+	VL53L0_Error Status = VL53L0_ERROR_NONE;
+
+	vl53l0_dbgmsg("Enter\n");
+
+	if (data->enable_ps_sensor || data->histoCapture)
+		return -EBUSY;
+
+	if (!data->histoRing)
+		return -ENODEV;
+
+	if (histoMode != VL53L0_HISTOGRAMMODE_REFERENCE_ONLY &&
+		histoMode != VL53L0_HISTOGRAMMODE_RETURN_ONLY &&
+		histoMode != VL53L0_HISTOGRAMMODE_BOTH) {
+		vl53l0_errmsg("%d, Unknown histogram mode = %u\n", __LINE__,
+			histoMode);
+		return -EINVAL;
+	}
+
+	rc = stmvl53l0_power_up(data);
+	if (rc) {
+		vl53l0_errmsg("%d,error rc %d\n", __LINE__, rc);
+		return rc;
+	}
+
+	rc = stmvl53l0_init_client(data);
+	if (rc) {
+		vl53l0_errmsg("%d, error rc %d\n", __LINE__, rc);
+		stmvl53l0_power_down(data);
+		return -EINVAL;
+	}
+
+	Status = PAPI(SetDeviceMode)(vl53l0_dev,
+			VL53L0_DEVICEMODE_SINGLE_HISTOGRAM);
+	if (Status == VL53L0_ERROR_NONE)
+		Status = PAPI(SetHistogramMode)(vl53l0_dev,
+				histoMode);
+	if (Status != VL53L0_ERROR_NONE) {
+		vl53l0_errmsg(
+			"Failed to set histogram mode. Error = %d\n", Status);
+		stmvl53l0_power_down(data);
+		return -EPERM;
+	}
+
+	memset(data->histoRing, 0, sizeof(struct stmvl53l0_histo_ring));
+	data->histoRing->slot_count = STMVL53L0_HISTO_RING_SLOTS;
+	data->histoMode = histoMode;
+	data->histoCapture = 1;
+
+	schedule_delayed_work(&data->histo_work, 0);
+
+	vl53l0_dbgmsg("End\n");
+
+	return rc;
+}
+
+static int stmvl53l0_histo_stop(struct stmvl53l0_data *data)
+{
+	int rc = 0;
+	VL53L0_DEV vl53l0_dev = data;
+
+	vl53l0_dbgmsg("Enter\n");
+
+	/* a running handler sees the flag under work_mutex and bails */
+	data->histoCapture = 0;
+	cancel_delayed_work(&data->histo_work);
+
+	PAPI(ClearInterruptMask)(vl53l0_dev, 0);
+	PAPI(SetHistogramMode)(vl53l0_dev,
+		VL53L0_HISTOGRAMMODE_DISABLED);
+	PAPI(SetDeviceMode)(vl53l0_dev,
+		VL53L0_DEVICEMODE_SINGLE_RANGING);
+
+	rc = stmvl53l0_power_down(data);
 	if (rc) {
 		vl53l0_errmsg("%d, error rc %d\n", __LINE__, rc);
 		return rc;
@@ -2528,6 +4133,7 @@ static int stmvl53l0_stop(struct stmvl53l0_data *data)
 
 	return rc;
 }
+
 static void stmvl53l0_timer_fn(unsigned long data)
 {
 
@@ -2545,6 +4151,249 @@ static void stmvl53l0_timer_fn(unsigned long data)
 }
 
 
+/*
+ * debugfs statistics, reading "stats" sums the per-CPU counters and
+ * writing anything to it clears them
+ */
+static void stmvl53l0_stats_sum(struct stmvl53l0_data *data,
+				struct stmvl53l0_stats *sum)
+{
+	const uint32_t *src;
+	uint32_t *dst = (uint32_t *)sum;
+	int cpu;
+	int i;
+
+	memset(sum, 0, sizeof(*sum));
+	for_each_possible_cpu(cpu) {
+		src = (const uint32_t *)per_cpu_ptr(data->stats, cpu);
+		for (i = 0; i < sizeof(*sum) / sizeof(uint32_t); i++)
+			dst[i] += src[i];
+	}
+}
+
+static void stmvl53l0_stats_show_hist(struct seq_file *m, const char *name,
+				const uint32_t *hist)
+{
+	int i;
+
+	seq_printf(m, "%s:\n", name);
+	for (i = 0; i < STMVL53L0_STATS_HIST_BUCKETS; i++) {
+		if (!hist[i])
+			continue;
+		if (i == STMVL53L0_STATS_HIST_BUCKETS - 1)
+			seq_printf(m, "  >= %u us: %u\n", 1U << (i - 1),
+				hist[i]);
+		else
+			seq_printf(m, "  < %u us: %u\n", 1U << i, hist[i]);
+	}
+}
+
+static int stmvl53l0_stats_show(struct seq_file *m, void *v)
+{
+	struct stmvl53l0_data *data = m->private;
+	struct stmvl53l0_stats sum;
+	int i;
+
+	stmvl53l0_stats_sum(data, &sum);
+
+	seq_printf(m, "samples: %u\n", sum.samples);
+	for (i = 0; i < STMVL53L0_STATS_RANGE_STATUS - 1; i++)
+		seq_printf(m, "range_status_%d: %u\n", i, sum.rangeStatus[i]);
+	seq_printf(m, "range_status_other: %u\n", sum.rangeStatus[i]);
+	seq_printf(m, "range_errors: %u\n", sum.rangeErrors);
+	seq_printf(m, "i2c_errors: %u\n", sum.i2cErrors);
+	seq_printf(m, "watchdog_restarts: %u\n", sum.watchdogRestarts);
+	seq_printf(m, "enables: %u\n", sum.enables);
+	seq_printf(m, "sample_interval_us: %u\n", data->sampleIntervalUs);
+	stmvl53l0_stats_show_hist(m, "enable_latency", sum.enableLatency);
+	stmvl53l0_stats_show_hist(m, "queue_delay", sum.queueDelay);
+
+	return 0;
+}
+
+static int stmvl53l0_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, stmvl53l0_stats_show, inode->i_private);
+}
+
+static ssize_t stmvl53l0_stats_write(struct file *file,
+				const char __user *buf, size_t count,
+				loff_t *ppos)
+{
+	struct seq_file *m = file->private_data;
+	struct stmvl53l0_data *data = m->private;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(data->stats, cpu), 0,
+			sizeof(struct stmvl53l0_stats));
+
+	return count;
+}
+
+static const struct file_operations stmvl53l0_stats_fops = {
+	.owner =	THIS_MODULE,
+	.open =		stmvl53l0_stats_open,
+	.read =		seq_read,
+	.write =	stmvl53l0_stats_write,
+	.llseek =	seq_lseek,
+	.release =	single_release,
+};
+
+/*
+ * debugfs I2C capture: writing 1 clears the ring and starts recording,
+ * 0 stops it. Reading lists the records, oldest first, one per line:
+ *   <timestamp ns> <r|w> <register> <error> <length> <data in hex>
+ */
+struct stmvl53l0_i2c_snapshot {
+	uint32_t head;
+	uint32_t count;
+	struct stmvl53l0_i2c_record rec[STMVL53L0_I2C_CAPTURE_SLOTS];
+};
+
+static int stmvl53l0_i2c_capture_show(struct seq_file *m, void *v)
+{
+	struct stmvl53l0_i2c_snapshot *snap = m->private;
+	const struct stmvl53l0_i2c_record *rec;
+	uint32_t i;
+
+	seq_puts(m, "# stmvl53l0 i2c capture: ts_ns dir reg err len data\n");
+	if (snap->head > snap->count)
+		seq_printf(m, "# dropped %u\n", snap->head - snap->count);
+	for (i = 0; i < snap->count; i++) {
+		rec = &snap->rec[i];
+		seq_printf(m, "%llu %c %02x %d %u %*phN\n",
+			(unsigned long long)rec->timestamp,
+			rec->dir, rec->reg, rec->err,
+			rec->len, rec->len, rec->data);
+	}
+
+	return 0;
+}
+
+/* the ring keeps moving while capturing, list a copy of it */
+static int stmvl53l0_i2c_capture_open(struct inode *inode, struct file *file)
+{
+	struct stmvl53l0_data *data = inode->i_private;
+	struct stmvl53l0_i2c_capture *cap;
+	struct stmvl53l0_i2c_snapshot *snap;
+	uint32_t first, i;
+	int rc;
+
+	snap = vzalloc(sizeof(*snap));
+	if (!snap)
+		return -ENOMEM;
+
+	mutex_lock(&data->work_mutex);
+	cap = data->i2cCapture;
+	if (cap) {
+		spin_lock(&cap->lock);
+		snap->head = cap->head;
+		snap->count = min_t(uint32_t, cap->head,
+				STMVL53L0_I2C_CAPTURE_SLOTS);
+		first = cap->head - snap->count;
+		for (i = 0; i < snap->count; i++)
+			snap->rec[i] = cap->rec[(first + i) %
+				STMVL53L0_I2C_CAPTURE_SLOTS];
+		spin_unlock(&cap->lock);
+	}
+	mutex_unlock(&data->work_mutex);
+
+	rc = single_open(file, stmvl53l0_i2c_capture_show, snap);
+	if (rc)
+		vfree(snap);
+
+	return rc;
+}
+
+static int stmvl53l0_i2c_capture_release(struct inode *inode,
+				struct file *file)
+{
+	struct seq_file *m = file->private_data;
+
+	vfree(m->private);
+
+	return single_release(inode, file);
+}
+
+static ssize_t stmvl53l0_i2c_capture_write(struct file *file,
+				const char __user *buf, size_t count,
+				loff_t *ppos)
+{
+	struct stmvl53l0_data *data = file_inode(file)->i_private;
+	struct stmvl53l0_i2c_capture *cap;
+	unsigned int on;
+	int rc;
+
+	rc = kstrtouint_from_user(buf, count, 10, &on);
+	if (rc)
+		return rc;
+	if (on > 1)
+		return -EINVAL;
+
+	mutex_lock(&data->work_mutex);
+	if (on && !data->i2cCapture) {
+		cap = vzalloc(sizeof(*cap));
+		if (!cap) {
+			mutex_unlock(&data->work_mutex);
+			return -ENOMEM;
+		}
+		spin_lock_init(&cap->lock);
+		data->i2cCapture = cap;
+	}
+	if (on) {
+		cap = data->i2cCapture;
+		spin_lock(&cap->lock);
+		cap->head = 0;
+		spin_unlock(&cap->lock);
+	}
+	data->i2cCaptureOn = on;
+	mutex_unlock(&data->work_mutex);
+
+	return count;
+}
+
+static const struct file_operations stmvl53l0_i2c_capture_fops = {
+	.owner =	THIS_MODULE,
+	.open =		stmvl53l0_i2c_capture_open,
+	.read =		seq_read,
+	.write =	stmvl53l0_i2c_capture_write,
+	.llseek =	seq_lseek,
+	.release =	stmvl53l0_i2c_capture_release,
+};
+
+static void stmvl53l0_debugfs_init(struct stmvl53l0_data *data)
+{
+	data->stats = alloc_percpu(struct stmvl53l0_stats);
+	if (!data->stats) {
+		vl53l0_errmsg("%d, statistics not available\n", __LINE__);
+		return;
+	}
+
+	/* a missing debugfs only hides the counters */
+	data->debugfs = debugfs_create_dir(data->dev_name, NULL);
+	if (IS_ERR_OR_NULL(data->debugfs)) {
+		data->debugfs = NULL;
+		return;
+	}
+	debugfs_create_file("stats", 0600, data->debugfs, data,
+			&stmvl53l0_stats_fops);
+	debugfs_create_file("i2c_capture", 0600, data->debugfs, data,
+			&stmvl53l0_i2c_capture_fops);
+}
+
+static void stmvl53l0_debugfs_exit(struct stmvl53l0_data *data)
+{
+	debugfs_remove_recursive(data->debugfs);
+	data->debugfs = NULL;
+	free_percpu(data->stats);
+	data->stats = NULL;
+	mutex_lock(&data->work_mutex);
+	data->i2cCaptureOn = 0;
+	mutex_unlock(&data->work_mutex);
+	vfree(data->i2cCapture);
+	data->i2cCapture = NULL;
+}
 
 /*
  * I2C init/probing/exit functions
@@ -2555,12 +4404,14 @@ static const struct file_operations stmvl53l0_ranging_fops = {
 	.compat_ioctl = stmvl53l0_ioctl,
 	.open =				stmvl53l0_open,
 	.flush =			stmvl53l0_flush,
+	.mmap =				stmvl53l0_mmap,
 };
 
 
 
 int stmvl53l0_setup(struct stmvl53l0_data *data)
 {
+	ktime_t start = ktime_get();
 	int rc = 0;
 
 #ifdef USE_INT
@@ -2572,6 +4423,8 @@ int stmvl53l0_setup(struct stmvl53l0_data *data)
 	/* init mutex */
 	mutex_init(&data->update_lock);
 	mutex_init(&data->work_mutex);
+	spin_lock_init(&data->sampleLock);
+	init_waitqueue_head(&data->sampleWq);
 
 #ifdef USE_INT
 	/* init interrupt */
@@ -2601,21 +4454,13 @@ int stmvl53l0_setup(struct stmvl53l0_data *data)
 	data->irq = irq;
 	vl53l0_errmsg("interrupt is hooked\n");
 #else
-
+	/* the thread itself is started by stmvl53l0_late_init() */
 	init_waitqueue_head(&data->poll_thread_wq);
-
-	data->poll_thread = kthread_run(&stmvl53l0_poll_thread,
-							(void *)data,
-							"STM-VL53L0");
-	if (data->poll_thread == NULL) {
-		pr_err(
-	"%s(%d) - Failed to create Polling thread\n", __func__, __LINE__);
-		goto exit_free_irq;
-	}
 #endif
 
 	/* init work handler */
 	INIT_DELAYED_WORK(&data->dwork, stmvl53l0_work_handler);
+	INIT_DELAYED_WORK(&data->histo_work, stmvl53l0_histo_work_handler);
 
 	/* Register to Input Device */
 	data->input_dev_ps = input_allocate_device();
@@ -2688,6 +4533,12 @@ int stmvl53l0_setup(struct stmvl53l0_data *data)
 				 stmvl53l0_timer_fn,
 				(unsigned long)data);
 
+	stmvl53l0_debugfs_init(data);
+
+	/* IIO front end, next to the input device */
+	if (stmvl53l0_iio_init(data))
+		vl53l0_errmsg("%d, IIO device not available\n", __LINE__);
+
 	/* to register as a misc device */
 	data->miscdev.minor = MISC_DYNAMIC_MINOR;
 	data->miscdev.name = "stmvl53l0_ranging";
@@ -2718,9 +4569,21 @@ int stmvl53l0_setup(struct stmvl53l0_data *data)
 	data->preRangePulsePeriod = LONG_DISTANCE_PRE_RANGE_PULSE_PERIOD;
 	data->finalRangePulsePeriod = LONG_DISTANCE_FINAL_RANGE_PULSE_PERIOD;
 
+	/* Report every sample until a filter is configured */
+	data->filter.mode = STMVL53L0_FILTER_NONE;
+	data->filter.medianLen = 3;
+	data->filter.alpha = 128; /* 0.5 */
+	data->filter.beta = 26; /* 0.1 */
 
+	/* Timing budget stays under control of the use case by default */
+	data->governor.enable = 0;
+	data->governor.targetSigmaMm = 15;
 
 
+
+
+	pr_info("stmvl53l0: setup took %lldus\n",
+		ktime_us_delta(ktime_get(), start));
 	vl53l0_dbgmsg("support ver. %s enabled\n", DRIVER_VERSION);
 	vl53l0_dbgmsg("End");
 
@@ -2741,11 +4604,29 @@ exit_free_irq:
 
 void stmvl53l0_cleanup(struct stmvl53l0_data *data)
 {
+	/* the IIO buffer may still stop ranging */
+	stmvl53l0_iio_exit(data);
 #ifndef USE_INT
 	pr_err("%s(%d) : Stop poll_thread\n", __func__, __LINE__);
 	poll_thread_exit = 1;
-	kthread_stop(data->poll_thread);
+	if (data->poll_thread)
+		kthread_stop(data->poll_thread);
 #endif
+	/*
+	 * A work handler still running may account a sample, write the
+	 * capture or queue a CCI write: let it see ranging off and wait
+	 * for it before the stats, capture and batch buffers are freed.
+	 */
+	mutex_lock(&data->work_mutex);
+	data->enable_ps_sensor = 0;
+	mutex_unlock(&data->work_mutex);
+	cancel_delayed_work_sync(&data->dwork);
+	cancel_delayed_work_sync(&data->histo_work);
+	stmvl53l0_range_clear();
+	vfree(data->histoRing);
+	kfree(data->cciBatch);
+	data->histoRing = NULL;
+	stmvl53l0_debugfs_exit(data);
 }
 static int __init stmvl53l0_init(void)
 {
@@ -2755,12 +4636,11 @@ static int __init stmvl53l0_init(void)
 
 	/* assign function table */
 	pmodule_func_tbl = &stmvl53l0_module_func_tbl;
+#ifndef USE_MINIMAL_API
 	papi_func_tbl = &stmvl53l0_api_func_tbl;
+#endif
+	/* the reset pulse is left to stmvl53l0_late_init() */
 	gpio_request(XSHUT_GPIO, "vl53l0_xshut_gpio");
-	gpio_direction_output(XSHUT_GPIO, 0);
-	usleep_range(2950, 3000);
-	gpio_direction_output(XSHUT_GPIO, 1);
-	usleep_range(2950, 3000);
 
 
 	/* client specific init function */
@@ -0,0 +1,218 @@
+/*
+ *  stmvl53l0_trace.h - Linux kernel modules for STM VL53L0 FlightSense TOF
+ *						 sensor
+ *
+ *  Copyright (C) 2016 STMicroelectronics Imaging Division.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+/*
+ * Tracepoints for the ranging hot path. They compile to a static branch
+ * when the events are disabled, so they can stay in the per-sample code
+ * where printk would stall the work handler. Enable them with
+ *   echo 1 > /sys/kernel/debug/tracing/events/stmvl53l0/enable
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM stmvl53l0
+
+#if !defined(_STMVL53L0_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _STMVL53L0_TRACE_H
+
+#include <linux/tracepoint.h>
+#include "vl53l0_def.h"
+
+/* interrupt or poll thread noticed a new measurement */
+TRACE_EVENT(stmvl53l0_data_ready,
+	TP_PROTO(uint32_t interruptStatus, int from_irq),
+	TP_ARGS(interruptStatus, from_irq),
+	TP_STRUCT__entry(
+		__field(uint32_t, interruptStatus)
+		__field(int, from_irq)
+	),
+	TP_fast_assign(
+		__entry->interruptStatus = interruptStatus;
+		__entry->from_irq = from_irq;
+	),
+	TP_printk("status=0x%x irq=%d",
+		__entry->interruptStatus, __entry->from_irq)
+);
+
+DECLARE_EVENT_CLASS(stmvl53l0_i2c,
+	TP_PROTO(uint8_t reg, uint8_t len, int is_read, int err),
+	TP_ARGS(reg, len, is_read, err),
+	TP_STRUCT__entry(
+		__field(uint8_t, reg)
+		__field(uint8_t, len)
+		__field(int, is_read)
+		__field(int, err)
+	),
+	TP_fast_assign(
+		__entry->reg = reg;
+		__entry->len = len;
+		__entry->is_read = is_read;
+		__entry->err = err;
+	),
+	TP_printk("%s reg=0x%02x len=%u err=%d",
+		__entry->is_read ? "rd" : "wr",
+		__entry->reg, __entry->len, __entry->err)
+);
+
+DEFINE_EVENT(stmvl53l0_i2c, stmvl53l0_i2c_start,
+	TP_PROTO(uint8_t reg, uint8_t len, int is_read, int err),
+	TP_ARGS(reg, len, is_read, err)
+);
+
+DEFINE_EVENT(stmvl53l0_i2c, stmvl53l0_i2c_end,
+	TP_PROTO(uint8_t reg, uint8_t len, int is_read, int err),
+	TP_ARGS(reg, len, is_read, err)
+);
+
+/* CCI batch: a write queued, then sent with the status of the batch */
+DEFINE_EVENT(stmvl53l0_i2c, stmvl53l0_i2c_queued,
+	TP_PROTO(uint8_t reg, uint8_t len, int is_read, int err),
+	TP_ARGS(reg, len, is_read, err)
+);
+
+DEFINE_EVENT(stmvl53l0_i2c, stmvl53l0_i2c_flushed,
+	TP_PROTO(uint8_t reg, uint8_t len, int is_read, int err),
+	TP_ARGS(reg, len, is_read, err)
+);
+
+/* poll thread watchdog: no interrupt in time, ranging restarted */
+TRACE_EVENT(stmvl53l0_watchdog,
+	TP_PROTO(uint32_t elapsed_ms, uint32_t limit_ms, int status),
+	TP_ARGS(elapsed_ms, limit_ms, status),
+	TP_STRUCT__entry(
+		__field(uint32_t, elapsed_ms)
+		__field(uint32_t, limit_ms)
+		__field(int, status)
+	),
+	TP_fast_assign(
+		__entry->elapsed_ms = elapsed_ms;
+		__entry->limit_ms = limit_ms;
+		__entry->status = status;
+	),
+	TP_printk("no interrupt for %u ms (limit %u) restart status=%d",
+		__entry->elapsed_ms, __entry->limit_ms, __entry->status)
+);
+
+/* decoded result of GetRangingMeasurementData */
+TRACE_EVENT(stmvl53l0_range_result,
+	TP_PROTO(int status, const VL53L0_RangingMeasurementData_t *range),
+	TP_ARGS(status, range),
+	TP_STRUCT__entry(
+		__field(int, status)
+		__field(uint16_t, range_mm)
+		__field(uint8_t, range_status)
+		__field(uint32_t, signal_rate)
+		__field(uint32_t, ambient_rate)
+		__field(uint32_t, time_us)
+	),
+	TP_fast_assign(
+		__entry->status = status;
+		__entry->range_mm = range->RangeMilliMeter;
+		__entry->range_status = range->RangeStatus;
+		__entry->signal_rate = range->SignalRateRtnMegaCps;
+		__entry->ambient_rate = range->AmbientRateRtnMegaCps;
+		__entry->time_us = range->MeasurementTimeUsec;
+	),
+	TP_printk("status=%d range=%u err=%u signal=0x%x ambient=0x%x time=%u",
+		__entry->status, __entry->range_mm, __entry->range_status,
+		__entry->signal_rate, __entry->ambient_rate, __entry->time_us)
+);
+
+/* sample pushed to the input device, or dropped by the filter */
+TRACE_EVENT(stmvl53l0_input_report,
+	TP_PROTO(uint16_t raw, uint16_t reported, uint32_t sigma,
+		int reported_flag),
+	TP_ARGS(raw, reported, sigma, reported_flag),
+	TP_STRUCT__entry(
+		__field(uint16_t, raw)
+		__field(uint16_t, reported)
+		__field(uint32_t, sigma)
+		__field(int, reported_flag)
+	),
+	TP_fast_assign(
+		__entry->raw = raw;
+		__entry->reported = reported;
+		__entry->sigma = sigma;
+		__entry->reported_flag = reported_flag;
+	),
+	TP_printk("raw=%u range=%u sigma=0x%x %s",
+		__entry->raw, __entry->reported, __entry->sigma,
+		__entry->reported_flag ? "reported" : "suppressed")
+);
+
+TRACE_EVENT(stmvl53l0_ioctl_enter,
+	TP_PROTO(unsigned int cmd),
+	TP_ARGS(cmd),
+	TP_STRUCT__entry(
+		__field(unsigned int, cmd)
+	),
+	TP_fast_assign(
+		__entry->cmd = cmd;
+	),
+	TP_printk("cmd=0x%x", __entry->cmd)
+);
+
+TRACE_EVENT(stmvl53l0_ioctl_exit,
+	TP_PROTO(unsigned int cmd, long ret),
+	TP_ARGS(cmd, ret),
+	TP_STRUCT__entry(
+		__field(unsigned int, cmd)
+		__field(long, ret)
+	),
+	TP_fast_assign(
+		__entry->cmd = cmd;
+		__entry->ret = ret;
+	),
+	TP_printk("cmd=0x%x ret=%ld", __entry->cmd, __entry->ret)
+);
+
+/* PAL entry/exit, used by _LOG_FUNCTION_* when VL53L0_LOG_ENABLE is set */
+TRACE_EVENT(stmvl53l0_pal_enter,
+	TP_PROTO(const char *func),
+	TP_ARGS(func),
+	TP_STRUCT__entry(
+		__string(func, func)
+	),
+	TP_fast_assign(
+		__assign_str(func, func);
+	),
+	TP_printk("%s", __get_str(func))
+);
+
+TRACE_EVENT(stmvl53l0_pal_exit,
+	TP_PROTO(const char *func, int status),
+	TP_ARGS(func, status),
+	TP_STRUCT__entry(
+		__string(func, func)
+		__field(int, status)
+	),
+	TP_fast_assign(
+		__assign_str(func, func);
+		__entry->status = status;
+	),
+	TP_printk("%s status=%d", __get_str(func), __entry->status)
+);
+
+#endif /* _STMVL53L0_TRACE_H */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE stmvl53l0_trace
+#include <trace/define_trace.h>